@@ -23,7 +23,7 @@ C_FLAG = -c
 O_FLAG = -o
 F_FLAG = -f
 R_FLAG = -r
-L_FLAGS   = -Wall -I.
+L_FLAGS   = -Wall -I. -pthread
 RM_DIR = rd /s /q
 RM = rm
 
@@ -1,6 +1,7 @@
 #include "aperio-flavor-io.h"
+#include "stats-alloc.h"
 
-struct metadata_attribute *get_attribute_aperio(char *buffer, const char *attribute_name) {
+struct metadata_attribute *get_attribute_aperio(const char *buffer, const char *attribute_name) {
     const char *prefixed_delimiter = concat_str("|", attribute_name);
     char *value = get_string_between_delimiters(buffer, prefixed_delimiter, "|");
     free((void *)prefixed_delimiter);
@@ -23,43 +24,47 @@ struct metadata *get_metadata_aperio(file_handle *fp, struct tiff_file *file) {
     static const char *METADATA_ATTRIBUTES[] = {APERIO_FILENAME_TAG, APERIO_USER_TAG,       APERIO_TIME_TAG,
                                                 APERIO_DATE_TAG,     APERIO_SLIDE_TAG,      APERIO_BARCODE_TAG,
                                                 APERIO_RACK_TAG,     APERIO_SCANSCOPEID_TAG};
+    static const char *PREFIXED_METADATA_ATTRIBUTES[] = {
+        "|" APERIO_FILENAME_TAG, "|" APERIO_USER_TAG,    "|" APERIO_TIME_TAG, "|" APERIO_DATE_TAG,
+        "|" APERIO_SLIDE_TAG,    "|" APERIO_BARCODE_TAG, "|" APERIO_RACK_TAG, "|" APERIO_SCANSCOPEID_TAG};
+    static const size_t NUM_ATTRIBUTES = sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]);
 
     // initialize metadata_attribute struct
-    struct metadata_attribute **attributes =
-        malloc(sizeof(**attributes) * sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]));
+    struct metadata_attribute **attributes = malloc(sizeof(**attributes) * NUM_ATTRIBUTES);
     int8_t metadata_id = 0;
 
-    // iterate over directories in tiff file
-    for (uint32_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint32_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-
-            // entry with ImageDescription tag contains all metadata
-            if (entry.tag == TIFFTAG_IMAGEDESCRIPTION) {
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                // read content of ImageDescription into buffer
-                char buffer[entry_size * entry.count];
-                if (file_read(&buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read tag image description.\n");
-                    return NULL;
-                }
+    // all attributes are searched in a single pass over each description
+    struct pattern_scanner *scanner = create_pattern_scanner(PREFIXED_METADATA_ATTRIBUTES, NUM_ATTRIBUTES);
+    const char *matches[sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0])];
+    if (scanner == NULL) {
+        free(attributes);
+        return NULL;
+    }
 
-                // checks for all metadata
-                for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
-                    if (contains(buffer, METADATA_ATTRIBUTES[i])) {
-                        struct metadata_attribute *single_attribute =
-                            get_attribute_aperio(buffer, METADATA_ATTRIBUTES[i]);
-                        if (single_attribute != NULL) {
-                            attributes[metadata_id++] = single_attribute;
-                        }
-                    }
+    // entries with ImageDescription tag contain all metadata
+    uint64_t num_references;
+    const struct tiff_tag_reference *references = find_tag_references(file, TIFFTAG_IMAGEDESCRIPTION, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        // read content of ImageDescription from file or cache
+        const char *buffer = get_tag_value(fp, file, &references[k]);
+        if (buffer == NULL) {
+            fprintf(stderr, "Error: Could not read tag image description.\n");
+            free_pattern_scanner(scanner);
+            return NULL;
+        }
+
+        // checks for all metadata, the value is read from the first occurrence of an attribute
+        find_patterns(scanner, buffer, strlen(buffer), matches);
+        for (size_t i = 0; i < NUM_ATTRIBUTES; i++) {
+            if (matches[i] != NULL) {
+                struct metadata_attribute *single_attribute = get_attribute_aperio(matches[i], METADATA_ATTRIBUTES[i]);
+                if (single_attribute != NULL) {
+                    attributes[metadata_id++] = single_attribute;
                 }
             }
         }
     }
+    free_pattern_scanner(scanner);
 
     // add all found metadata
     struct metadata *metadata_attributes = malloc(sizeof(*metadata_attributes));
@@ -68,9 +73,39 @@ struct metadata *get_metadata_aperio(file_handle *fp, struct tiff_file *file) {
     return metadata_attributes;
 }
 
+struct wsi_data *get_wsi_data_aperio_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename) {
+    // check for valid file extension
+    const char *ext = get_filename_ext(filename);
+    if (strcmp(ext, SVS) != 0 && strcmp(ext, TIF) != 0) {
+        return NULL;
+    }
+
+    // checks the first image description in order to determine if file is actually Aperio
+    int32_t result = first_tag_value_contains(fp, file, TIFFTAG_IMAGEDESCRIPTION, "Aperio");
+
+    // checks result
+    if (result == -1) {
+        fprintf(stderr, "Error: Could not find aperio label directory.\n");
+        return NULL;
+    }
+
+    // gets all metadata, which is spread over all directories
+    if (read_remaining_tiff_directories(fp, file) != 0) {
+        return NULL;
+    }
+    struct metadata *metadata_attributes = get_metadata_aperio(fp, file);
+
+    // is Aperio
+    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
+    wsi_data->format = APERIO;
+    wsi_data->filename = filename;
+    wsi_data->metadata_attributes = metadata_attributes;
+    wsi_data->tiff_file = NULL;
+    return wsi_data;
+}
+
 struct wsi_data *get_wsi_data_aperio(const char *filename) {
     // gets file extension
-    int32_t result = 0;
     const char *ext = get_filename_ext(filename);
 
     // check for valid file extension
@@ -79,7 +114,7 @@ struct wsi_data *get_wsi_data_aperio(const char *filename) {
     }
 
     // opens file
-    file_handle *fp = file_open(filename, "rb+");
+    file_handle *fp = file_open_mapped(filename, "rb+");
 
     // checks if file was successfully opened
     if (fp == NULL) {
@@ -87,43 +122,16 @@ struct wsi_data *get_wsi_data_aperio(const char *filename) {
         return NULL;
     }
 
-    // checks file details
-    bool big_tiff = false;
-    bool big_endian = false;
-    result = check_file_header(fp, &big_endian, &big_tiff);
-
-    // checks result
-    if (result != 0) {
-        return NULL;
-    }
-
     // creates tiff file structure
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, false, big_endian);
+    struct tiff_file *file = read_tiff_file_with_header(fp, false);
 
     // checks result
     if (file == NULL) {
-        fprintf(stderr, "Error: Could not read tiff file.\n");
         file_close(fp);
         return NULL;
     }
 
-    // checks tag value in order to determine if file is actually Aperio
-    result = tag_value_contains(fp, file, TIFFTAG_IMAGEDESCRIPTION, "Aperio");
-
-    // checks result
-    if (result == -1) {
-        fprintf(stderr, "Error: Could not find aperio label directory.\n");
-        return NULL;
-    }
-
-    // gets all metadata
-    struct metadata *metadata_attributes = get_metadata_aperio(fp, file);
-
-    // is Aperio
-    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
-    wsi_data->format = APERIO;
-    wsi_data->metadata_attributes = metadata_attributes;
+    struct wsi_data *wsi_data = get_wsi_data_aperio_from_tiff(fp, file, filename);
 
     // cleanup
     free_tiff_file(file);
@@ -132,7 +140,7 @@ struct wsi_data *get_wsi_data_aperio(const char *filename) {
 }
 
 // searches for tags in image description data and replaces its values with equal amount of X's
-char *override_image_description(char *result, char *delimiter) {
+char *override_image_description(char *result, const char *delimiter) {
     const char *prefixed_delimiter = concat_str("|", delimiter);
     const char *value = get_string_between_delimiters(result, prefixed_delimiter, "|");
     // check if value is not an empty string
@@ -156,70 +164,69 @@ char *override_image_description(char *result, char *delimiter) {
 // TODO: make use of get_metadata_aperio function
 // removes all metadata
 int32_t remove_metadata_in_aperio(file_handle *fp, struct tiff_file *file) {
-    for (uint32_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint32_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            if (entry.tag == TIFFTAG_IMAGEDESCRIPTION) {
-                // get requested image tag from file
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                char buffer[entry_size * entry.count];
-                if (file_read(&buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read tag image description.\n");
-                    return -1;
-                }
+    uint64_t num_references;
+    const struct tiff_tag_reference *references = find_tag_references(file, TIFFTAG_IMAGEDESCRIPTION, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        struct tiff_entry entry = *get_entry_of_reference(file, &references[k]);
+        int32_t entry_size = get_size_of_value(entry.type, &entry.count);
+
+        // get requested image tag from file or cache
+        char *buffer = copy_tag_value(fp, file, &references[k]);
+        if (buffer == NULL) {
+            fprintf(stderr, "Error: Could not read tag image description.\n");
+            return -1;
+        }
 
-                bool rewrite = false;
-                char *result = buffer;
-
-                // all metadata that is replaced with default values
-                static char *METADATA_ATTRIBUTE_KEYS[] = {APERIO_DATE_TAG, APERIO_TIME_TAG, APERIO_SLIDE_TAG};
-
-                // default replacement values
-                static char *METADATA_REPLACEMENT_VALUES[] = {APERIO_MIN_DATE, MIN_TIME, MIN_POS};
-
-                for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTE_KEYS) / sizeof(METADATA_ATTRIBUTE_KEYS[0]); i++) {
-                    if (contains(result, METADATA_ATTRIBUTE_KEYS[i])) {
-                        const char *prefixed_delimiter = concat_str("|", METADATA_ATTRIBUTE_KEYS[i]);
-                        const char *value = get_string_between_delimiters(result, prefixed_delimiter, "|");
-                        if (value[0] != '\0') {
-                            char *new_result = replace_str(result, value, METADATA_REPLACEMENT_VALUES[i]);
-                            strcpy(result, new_result);
-                            free(new_result);
-                            rewrite = true;
-                        }
-                        free((void *)(value));
-                        free((void *)(prefixed_delimiter));
-                    }
-                }
+        bool rewrite = false;
+        char *result = buffer;
+
+        // all metadata that is replaced with default values
+        static const char *METADATA_ATTRIBUTE_KEYS[] = {APERIO_DATE_TAG, APERIO_TIME_TAG, APERIO_SLIDE_TAG};
+
+        // default replacement values
+        static const char *METADATA_REPLACEMENT_VALUES[] = {APERIO_MIN_DATE, MIN_TIME, MIN_POS};
 
-                // all metadata that can be replaced with X's
-                static char *METADATA_ATTRIBUTES[] = {APERIO_FILENAME_TAG, APERIO_USER_TAG, APERIO_BARCODE_TAG,
-                                                      APERIO_SCANSCOPEID_TAG, APERIO_RACK_TAG};
-
-                for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
-                    if (contains(result, METADATA_ATTRIBUTES[i])) {
-                        char *new_result = override_image_description(result, METADATA_ATTRIBUTES[i]);
-                        // in case the metadata exists but no value was found
-                        if (new_result != NULL) {
-                            strcpy(result, new_result);
-                            free(new_result);
-                            rewrite = true;
-                        }
-                    }
+        for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTE_KEYS) / sizeof(METADATA_ATTRIBUTE_KEYS[0]); i++) {
+            if (contains(result, METADATA_ATTRIBUTE_KEYS[i])) {
+                const char *prefixed_delimiter = concat_str("|", METADATA_ATTRIBUTE_KEYS[i]);
+                const char *value = get_string_between_delimiters(result, prefixed_delimiter, "|");
+                if (value[0] != '\0') {
+                    char *new_result = replace_str(result, value, METADATA_REPLACEMENT_VALUES[i]);
+                    strcpy(result, new_result);
+                    free(new_result);
+                    rewrite = true;
                 }
+                free((void *)(value));
+                free((void *)(prefixed_delimiter));
+            }
+        }
 
-                if (rewrite == true) {
-                    file_seek(fp, entry.offset, SEEK_SET);
-                    if (file_write(result, entry.count, entry_size, fp) != 1) {
-                        fprintf(stderr, "Error: Could not overwrite image description.\n");
-                        return -1;
-                    }
+        // all metadata that can be replaced with X's
+        static const char *METADATA_ATTRIBUTES[] = {APERIO_FILENAME_TAG, APERIO_USER_TAG, APERIO_BARCODE_TAG,
+                                                    APERIO_SCANSCOPEID_TAG, APERIO_RACK_TAG};
+
+        for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
+            if (contains(result, METADATA_ATTRIBUTES[i])) {
+                char *new_result = override_image_description(result, METADATA_ATTRIBUTES[i]);
+                // in case the metadata exists but no value was found
+                if (new_result != NULL) {
+                    strcpy(result, new_result);
+                    free(new_result);
+                    rewrite = true;
                 }
             }
         }
+
+        if (rewrite == true) {
+            file_seek(fp, entry.offset, SEEK_SET);
+            if (file_write(result, entry.count, entry_size, fp) != 1) {
+                fprintf(stderr, "Error: Could not overwrite image description.\n");
+                free(buffer);
+                return -1;
+            }
+            invalidate_tag_values(file, entry.offset, get_length_of_value(entry));
+        }
+        free(buffer);
     }
     return 1;
 }
@@ -227,29 +234,28 @@ int32_t remove_metadata_in_aperio(file_handle *fp, struct tiff_file *file) {
 // macro image for gt450 needs to be treated differently because it is JPEG encoded.
 // therefore we need to convert it to LZW compression
 int32_t change_macro_image_compression_gt450(file_handle *fp, struct tiff_file *file, int32_t directory) {
-    struct tiff_directory dir = file->directories[directory];
-    for (uint32_t i = 0; i < dir.count; i++) {
-        struct tiff_entry entry = dir.entries[i];
-        if (entry.tag == TIFFTAG_COMPRESSION) {
-            if (file_seek(fp, entry.start + 12, SEEK_SET)) {
-                fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", entry.offset);
-                continue;
-            }
-            uint64_t lzw_com = COMPRESSION_LZW;
-            if (!file_write(&lzw_com, 1, sizeof(uint64_t), fp)) {
-                fprintf(stderr, "Error: Wiping image data failed.\n");
-                return -1;
-            }
-            break;
-        }
+    struct tiff_directory *dir = &file->directories[directory];
+    int64_t index = find_entry_by_tag(dir, TIFFTAG_COMPRESSION);
+    if (index < 0) {
+        return 0;
+    }
+    struct tiff_entry entry = dir->entries[index];
+    if (file_seek(fp, entry.start + 12, SEEK_SET)) {
+        fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", entry.offset);
+        return 0;
+    }
+    uint64_t lzw_com = COMPRESSION_LZW;
+    if (!file_write(&lzw_com, 1, sizeof(uint64_t), fp)) {
+        fprintf(stderr, "Error: Wiping image data failed.\n");
+        return -1;
     }
     return 0;
 }
 
 // anonymizes aperio file
 int32_t handle_aperio(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                      bool do_inplace) {
-    fprintf(stdout, "Anonymize Aperio WSI...\n");
+                      bool do_inplace, struct tiff_file *file) {
+    fprintf(stderr, "Anonymize Aperio WSI...\n");
 
     // gets file extension
     const char *ext = get_filename_ext(*filename);
@@ -265,22 +271,20 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
 
     // open file
     file_handle *fp;
-    fp = file_open(*filename, "rb+");
+    fp = file_open_mapped(*filename, "rb+");
 
-    // checks file details
-    bool big_tiff = false;
-    bool big_endian = false;
-    int32_t result = check_file_header(fp, &big_endian, &big_tiff);
-
-    // check result
-    if (result != 0) {
-        file_close(fp);
-        return result;
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open tiff file.\n");
+        if (file != NULL) {
+            free_tiff_file(file);
+        }
+        return -1;
     }
 
-    // creates tiff file structure
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, false, big_endian);
+    // creates tiff file structure, unless it was already read during format detection
+    if (file == NULL) {
+        file = read_tiff_file_with_header(fp, false);
+    }
 
     // check result
     if (file == NULL) {
@@ -289,10 +293,16 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
         return -1;
     }
 
+    // checks file details
+    bool big_tiff = file->big_tiff;
+    bool big_endian = file->big_endian;
+    int32_t result = 0;
+
     // if the slide at hand is produced by a GT450, the compression needs to be converted
     int32_t _is_aperio_gt450 = tag_value_contains(fp, file, TIFFTAG_IMAGEDESCRIPTION, "GT450");
 
     // delete label image
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_WIPE_LABEL);
     int32_t label_dir = 0;
     if (_is_aperio_gt450 == 1) {
         label_dir = get_aperio_gt450_dir_by_name(file, LABEL);
@@ -309,6 +319,7 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
     }
 
     // get directoriy
+    stats_record_directory(label_dir);
     struct tiff_directory dir = file->directories[label_dir];
 
     // check for KFBIO value in image description, since the compression type for KFBIO produced Aperio formats differs
@@ -327,6 +338,7 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
     }
 
     // delete macro image
+    stats_enter_phase(PHASE_WIPE_MACRO);
     int32_t macro_dir = -1;
     if (!keep_macro_image) {
         if (_is_aperio_gt450 == 1) {
@@ -342,6 +354,7 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
             return -1;
         }
 
+        stats_record_directory(macro_dir);
         struct tiff_directory dir = file->directories[macro_dir];
         result = wipe_directory(fp, &dir, false, big_endian, big_tiff, NULL, NULL);
 
@@ -357,16 +370,19 @@ int32_t handle_aperio(const char **filename, const char *new_label_name, bool ke
     }
 
     // remove all metadata
+    stats_enter_phase(PHASE_METADATA);
     remove_metadata_in_aperio(fp, file);
 
     // unlink directories
+    stats_enter_phase(PHASE_UNLINK);
     if (!disable_unlinking) {
-        unlink_directory(fp, file, label_dir, false);
-        unlink_directory(fp, file, macro_dir, false);
+        // the later directory is unlinked first, so that the predecessor of the other one is still linked
+        unlink_directory(fp, file, label_dir > macro_dir ? label_dir : macro_dir, false);
+        unlink_directory(fp, file, label_dir > macro_dir ? macro_dir : label_dir, false);
     }
+    stats_leave_phase(phase);
 
     // clean up
-    free((void *)(*filename));
     free_tiff_file(file);
     file_close(fp);
     return result;
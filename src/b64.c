@@ -37,27 +37,75 @@ static const char b64_table[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J
                                  'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
                                  'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'};
 
-// The number of buffers we need
-size_t bufc = 0;
-
-unsigned char *b64_buf_malloc() {
-    unsigned char *buf = b64_malloc(B64_BUFFER_SIZE);
-    bufc = 1;
-    return buf;
+#if defined(B64_SSSE3)
+// the vectorized codecs are compiled for ssse3 and only used if the cpu supports it. the
+// cpu features are detected by libgcc at startup, so the check only reads shared state
+static bool b64_has_ssse3(void) { return __builtin_cpu_supports("ssse3"); }
+
+// encode 12 bytes into 16 characters per step, returns the number of bytes encoded
+__attribute__((target("ssse3"))) static size_t b64_encode_ssse3(const unsigned char *src, size_t len,
+                                                                unsigned char *dst) {
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t pos = 0;
+
+    // 16 bytes are loaded for 12 bytes of input
+    while (len - pos >= 16) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + pos)), shuffle);
+
+        // split each group of three bytes into four 6 bit indices
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t0, t1);
+
+        // map the indices to the offset of their range in the base64 table
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+        __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+
+        _mm_storeu_si128((__m128i *)(dst + pos / 3 * 4), chars);
+        pos += 12;
+    }
+    return pos;
 }
 
-unsigned char *b64_buf_realloc(unsigned char *ptr, size_t size) {
-    if (size > bufc * B64_BUFFER_SIZE) {
-        while (size > bufc * B64_BUFFER_SIZE)
-            bufc++;
-        unsigned char *buf = b64_realloc(ptr, B64_BUFFER_SIZE * bufc);
-        if (!buf)
-            return NULL;
-        return buf;
-    }
+// decode 16 characters into 12 bytes per step until a character is not part of the base64
+// alphabet, returns the number of characters decoded. 16 bytes are written per step
+__attribute__((target("ssse3"))) static size_t b64_decode_ssse3(const char *src, size_t len, unsigned char *dst) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a,
+                                         0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                         0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t pos = 0;
+
+    while (len - pos >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + pos));
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+        __m128i lo_nibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+
+        // characters outside of the alphabet, including '=', are left to the scalar decoder
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+            break;
+        }
 
-    return ptr;
+        // translate characters to 6 bit values and merge four of them into three bytes
+        __m128i eq_slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i values = _mm_add_epi8(in, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_slash, hi_nibbles)));
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+
+        _mm_storeu_si128((__m128i *)(dst + pos / 4 * 3), _mm_shuffle_epi8(merged, pack));
+        pos += 16;
+    }
+    return pos;
 }
+#endif
 
 // for decoding
 void bytes_to_char(unsigned char *buffer, unsigned char *tmp) {
@@ -67,114 +115,81 @@ void bytes_to_char(unsigned char *buffer, unsigned char *tmp) {
 }
 
 // for encoding
-void six_bits_to_b64_char(unsigned char *buffer, unsigned char *tmp) {
+void six_bits_to_b64_char(unsigned char *buffer, const unsigned char *tmp) {
     buffer[0] = (tmp[0] & 0xfc) >> 2;
     buffer[1] = ((tmp[0] & 0x03) << 4) + ((tmp[1] & 0xf0) >> 4);
     buffer[2] = ((tmp[1] & 0x0f) << 2) + ((tmp[2] & 0xc0) >> 6);
     buffer[3] = tmp[2] & 0x3f;
 }
 
-unsigned char *b64_decode_ex(const char *src, size_t len, size_t *decsize) {
+// index of a character in 'b64_table' or -1 if it is not a base64 character
+static int32_t b64_char_to_index(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+') {
+        return 62;
+    } else if (c == '/') {
+        return 63;
+    }
+    return -1;
+}
 
+unsigned char *b64_decode_ex(const char *src, size_t len, size_t *decsize) {
     int32_t byte_length = 0;
-    int32_t pos = 0;
-    int32_t decoded_char = 0;
+    size_t pos = 0;
     size_t size = 0;
-    int8_t num_of_chars_to_dec = 4;
-    unsigned char *decoded_buffer = NULL;
     unsigned char buffer[3];
     unsigned char tmp[4];
 
-    // alloc
-    decoded_buffer = (unsigned char *)b64_buf_malloc();
+    // alloc once, decoding stops at the first '=' or character that is not a base64 character,
+    // so the decoded data is at most three bytes for every four characters
+    unsigned char *decoded_buffer = (unsigned char *)b64_malloc(len / 4 * 3 + 4);
     if (NULL == decoded_buffer) {
         return NULL;
     }
 
+#if defined(B64_SSSE3)
+    if (b64_has_ssse3()) {
+        pos = b64_decode_ssse3(src, len, decoded_buffer);
+        size = pos / 4 * 3;
+    }
+#endif
+
     // parse until end of source
-    while (len--) {
+    for (; pos < len; pos++) {
         // break if char is '=' or not base64 char
-        if (src[pos] == '=') {
-            break;
-        }
-        if (!(isalnum(src[pos]) || src[pos] == '+' || src[pos] == '/')) {
+        int32_t index = b64_char_to_index(src[pos]);
+        if (index < 0) {
             break;
         }
 
-        // read up to 4 bytes at a time into 'tmp'
-        tmp[byte_length++] = src[pos++];
-
-        // if 4 bytes read then decode into 'buffer'
-        if (byte_length == num_of_chars_to_dec) {
-            // translate values in 'tmp' from table
-            for (byte_length = 0; byte_length < num_of_chars_to_dec; byte_length++) {
-                // find translation char in 'b64_table'
-                for (decoded_char = 0; decoded_char < 64; decoded_char++) {
-                    if (tmp[byte_length] == b64_table[decoded_char]) {
-                        tmp[byte_length] = decoded_char;
-                        break;
-                    }
-                }
-            }
-
-            // decode
-            bytes_to_char(buffer, tmp);
-
-            // write decoded buffer to 'decoded_buffer'
-            decoded_buffer = (unsigned char *)b64_buf_realloc(decoded_buffer, size + 3);
-            if (decoded_buffer != NULL) {
-                for (byte_length = 0; byte_length < 3; byte_length++) {
-                    decoded_buffer[size++] = buffer[byte_length];
-                }
-            } else {
-                return NULL;
-            }
-
-            // reset
+        // read up to 4 bytes at a time into 'tmp' and decode them into 'decoded_buffer'
+        tmp[byte_length++] = (unsigned char)index;
+        if (byte_length == 4) {
+            bytes_to_char(decoded_buffer + size, tmp);
+            size += 3;
             byte_length = 0;
         }
     }
 
     // remainder
     if (byte_length > 0) {
-
         // fill 'tmp' with '\0' at most 4 times
-        for (pos = byte_length; pos < 4; pos++) {
-            tmp[pos] = '\0';
-        }
-
-        // translate remainder
-        for (pos = 0; pos < 4; pos++) {
-            // find translation char in 'b64_table'
-            for (decoded_char = 0; decoded_char < 64; decoded_char++) {
-                if (tmp[pos] == b64_table[decoded_char]) {
-                    tmp[pos] = decoded_char;
-                    break;
-                }
-            }
+        for (int32_t i = byte_length; i < 4; i++) {
+            tmp[i] = 0;
         }
 
-        // decode
+        // decode and write remainder to 'decoded_buffer'
         bytes_to_char(buffer, tmp);
-
-        // write remainer decoded buffer to 'decoded_buffer'
-        decoded_buffer = (unsigned char *)b64_buf_realloc(decoded_buffer, size + (byte_length - 1));
-        if (decoded_buffer != NULL) {
-            for (pos = 0; (pos < byte_length - 1); pos++) {
-                decoded_buffer[size++] = buffer[pos];
-            }
-        } else {
-            return NULL;
+        for (int32_t i = 0; i < byte_length - 1; i++) {
+            decoded_buffer[size++] = buffer[i];
         }
     }
-
-    // Make sure we have enough space to add '\0' character at end.
-    decoded_buffer = (unsigned char *)b64_buf_realloc(decoded_buffer, size + 1);
-    if (decoded_buffer != NULL) {
-        decoded_buffer[size] = '\0';
-    } else {
-        return NULL;
-    }
+    decoded_buffer[size] = '\0';
 
     // set new size of decoded buffer
     if (decsize != NULL) {
@@ -185,70 +200,46 @@ unsigned char *b64_decode_ex(const char *src, size_t len, size_t *decsize) {
 }
 
 unsigned char *b64_encode(const unsigned char *src, size_t len) {
-    int8_t byte_length = 0;
-    unsigned char *encoded_buffer = NULL;
-    int8_t num_of_chars_to_enc = 3;
-    int8_t sections = 4;
+    size_t pos = 0;
     size_t size = 0;
-    unsigned char buffer[sections];
-    unsigned char tmp[num_of_chars_to_enc];
+    unsigned char buffer[4];
+    unsigned char tmp[3];
 
-    // alloc
-    encoded_buffer = (unsigned char *)b64_buf_malloc();
+    // alloc once with four characters for every started group of three bytes
+    unsigned char *encoded_buffer = (unsigned char *)b64_malloc((len + 2) / 3 * 4 + 1);
     if (NULL == encoded_buffer) {
         return NULL;
     }
 
-    // parse until end of source
-    while (len--) {
-        // read up to 3 bytes at a time into 'tmp'
-        tmp[byte_length++] = *(src++);
-
-        // if 3 bytes read then encode into 'buffer'
-        if (byte_length == num_of_chars_to_enc) {
-            six_bits_to_b64_char(buffer, tmp);
-
-            // allocate 4 new byts for 'encoded_buffer` and
-            // then translate each encoded buffer
-            // part by index from the base 64 index table
-            // into 'encoded_buffer' unsigned char array
-            encoded_buffer = (unsigned char *)b64_buf_realloc(encoded_buffer, size + sections);
-            for (byte_length = 0; byte_length < sections; byte_length++) {
-                encoded_buffer[size++] = b64_table[buffer[byte_length]];
-            }
-
-            // reset index
-            byte_length = 0;
+#if defined(B64_SSSE3)
+    if (b64_has_ssse3()) {
+        pos = b64_encode_ssse3(src, len, encoded_buffer);
+        size = pos / 3 * 4;
+    }
+#endif
+
+    // encode 3 bytes at a time and translate each part by index from the base 64 index table
+    for (; len - pos >= 3; pos += 3) {
+        six_bits_to_b64_char(buffer, src + pos);
+        for (int32_t i = 0; i < 4; i++) {
+            encoded_buffer[size++] = b64_table[buffer[i]];
         }
     }
 
     // remainder
+    size_t byte_length = len - pos;
     if (byte_length > 0) {
         // fill 'tmp' with '\0' at most 3 times
-        for (int32_t i = byte_length; i < num_of_chars_to_enc; i++) {
-            tmp[i] = '\0';
-        }
+        memset(tmp, 0, sizeof(tmp));
+        memcpy(tmp, src + pos, byte_length);
 
-        // encode
+        // encode and append '=' for the missing bytes
         six_bits_to_b64_char(buffer, tmp);
-
-        // perform same write to `encoded_buffer` with new allocation
-        for (int32_t i = 0; (i < byte_length + 1); i++) {
-            encoded_buffer = (unsigned char *)b64_buf_realloc(encoded_buffer, size + 1);
-            encoded_buffer[size++] = b64_table[buffer[i]];
-        }
-
-        // while there is still a remainder
-        // append '=' to 'encoded_buffer'
-        while ((byte_length++ < num_of_chars_to_enc)) {
-            encoded_buffer = (unsigned char *)b64_buf_realloc(encoded_buffer, size + 1);
-            encoded_buffer[size++] = '=';
+        for (size_t i = 0; i < 4; i++) {
+            encoded_buffer[size++] = i <= byte_length ? b64_table[buffer[i]] : '=';
         }
     }
-
-    // Make sure we have enough space to add '\0' character at end.
-    encoded_buffer = (unsigned char *)b64_buf_realloc(encoded_buffer, size + 1);
     encoded_buffer[size] = '\0';
 
     return encoded_buffer;
-}
\ No newline at end of file
+}
@@ -33,6 +33,7 @@
 #define HEADER_B64_H
 
 #include <ctype.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,6 +42,12 @@
 // #ifndef B64_H
 #define B64_H 1
 
+// the vectorized codecs need gcc or clang on x86, the cpu support is checked at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define B64_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
 /**
  *  Memory allocation functions to use. You can define b64_malloc and
  * b64_realloc to custom functions if you want.
@@ -53,21 +60,6 @@
 #define b64_realloc(ptr, size) realloc(ptr, size)
 #endif
 
-// How much memory to allocate per buffer
-#define B64_BUFFER_SIZE (1024 * 64) // 64K
-
-// Start buffered memory
-unsigned char *b64_buf_malloc();
-
-// Update memory size. Returns the same pointer if we
-// have enough space in the buffer. Otherwise, we add
-// additional buffers.
-unsigned char *b64_buf_realloc(unsigned char *ptr, size_t size);
-
-/**
- * Decode `char *' source with `size_t' size.
- * Returns a `unsigned char *' base64 decoded string + size of decoded string.
- */
 unsigned char *b64_decode_ex(const char *, size_t, size_t *);
 
 /**
@@ -1,5 +1,39 @@
 #include "wsi-anonymizer.h"
 
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+#include <dirent.h>
+#include <glob.h>
+#include <unistd.h>
+#elif defined(_WIN32) || defined(_WIN64)
+#include <dirent.h>
+#include <windows.h>
+#endif
+
+#define BATCH_MAX_PATH_LENGTH 4096
+
+// result of a single file in batch mode
+enum batch_result { BATCH_ANONYMIZED = 0, BATCH_FAILED = 1, BATCH_UNSUPPORTED = 2 };
+
+static const char *BATCH_RESULT_STRINGS[] = {"OK", "FAILED", "UNSUPPORTED"};
+
+struct batch_job {
+    char **filenames;
+    size_t count;
+    // index of the next file to be picked up by a worker
+    size_t next;
+    size_t results[3];
+    const char *label_suffix;
+    bool keep_macro_image;
+    bool disable_unlinking;
+    bool do_inplace;
+    bool json_output;
+    pthread_mutex_t mutex;
+};
+
 char *get_app_name() {
 #ifdef __linux__
     return "bin/wsi-anon.out";
@@ -11,14 +45,28 @@ char *get_app_name() {
 }
 
 void print_help_message() {
-    fprintf(stderr, "Usage: %s [FILE] [-OPTIONS]\n\n", get_app_name());
+    fprintf(stderr, "Usage: %s [FILE] [-OPTIONS]\n", get_app_name());
+    fprintf(stderr, "FILE \"-\" reads a tiff based slide from stdin and writes the anonymized slide to stdout\n\n");
     fprintf(stderr, "OPTIONS:\n");
     fprintf(stderr, "-c     Only check file for vendor format and metadata\n");
     fprintf(stderr, "-n     Specify pseudo label name (e.g. -n \"labelname\")\n");
     fprintf(stderr, "-m     If flag is set, macro image will NOT be deleted\n");
     fprintf(stderr, "-i     If flag is set, anonymization will be done in-place\n");
-    fprintf(stderr, "-u     If flag is set, tiff directory will NOT be unlinked\n\n");
-    fprintf(stderr, "       Note: For file formats using JPEG compression this does not work currently.\n\n");
+    fprintf(stderr, "-u     If flag is set, tiff directory will NOT be unlinked\n");
+    fprintf(stderr, "       Note: For file formats using JPEG compression this does not work currently.\n");
+    fprintf(stderr, "-d     Write changes into the given delta file instead of modifying or copying the file\n");
+    fprintf(stderr, "       (e.g. -d \"wsi.delta\")\n");
+    fprintf(stderr, "-a     Apply the given delta file to the file (e.g. -a \"wsi.delta\")\n");
+    fprintf(stderr, "-o     Output file for applied delta, \"-\" writes to stdout (default: in-place)\n");
+    fprintf(stderr, "-b     Batch mode, FILE is a directory, a glob pattern (e.g. \"slides/*.svs\") or \"-\"\n");
+    fprintf(stderr, "       to read a newline-delimited list of files from stdin. Copies are named after the file\n");
+    fprintf(stderr, "       followed by the pseudo label name (default: \"_anonymized_wsi\")\n");
+    fprintf(stderr, "-j     Number of worker threads in batch mode (default: number of processors)\n");
+    fprintf(stderr, "-v     Print file operations, allocations and time per phase of the anonymization\n");
+    fprintf(stderr, "-q     Read and write slides with io_uring instead of a memory mapping (Linux only)\n");
+    fprintf(stderr, "-f     Output format, \"text\" or \"json\" to print one JSON object per file (default: text)\n");
+    fprintf(stderr, "-e     Extension of the slide read from stdin, e.g. \"ndpi\" (default: svs)\n");
+    fprintf(stderr, "-l     Lookahead in MiB for the file structure of the slide read from stdin (default: 256)\n\n");
 }
 
 void print_metadata(struct wsi_data *wsi_data) {
@@ -34,13 +82,397 @@ void print_metadata(struct wsi_data *wsi_data) {
     }
 }
 
+void print_stats(const struct anonymization_stats *stats) {
+    fprintf(stdout, "Statistics:\n");
+    fprintf(stdout, "%20s %" PRIu64 " (%" PRIu64 " bytes)\n", "reads", stats->reads, stats->bytes_read);
+    fprintf(stdout, "%20s %" PRIu64 " (%" PRIu64 " bytes)\n", "writes", stats->writes, stats->bytes_written);
+    fprintf(stdout, "%20s %" PRIu64 "\n", "seeks", stats->seeks);
+    fprintf(stdout, "%20s %" PRIu64 "\n", "allocations", stats->allocations);
+    if (stats->copy_method != NULL) {
+        fprintf(stdout, "%20s %" PRIu64 " bytes (%s)\n", "copied", stats->bytes_copied, stats->copy_method);
+    }
+    for (int32_t phase = 0; phase < PHASE_NONE; phase++) {
+        fprintf(stdout, "%20s %.3f ms\n", PHASE_STRINGS[phase], stats->phase_seconds[phase] * 1000);
+    }
+    fprintf(stdout, "%20s %.3f ms\n", "total", stats->total_seconds * 1000);
+}
+
+// get the length of the utf-8 sequence starting with a byte of 0x80 or above, 0 if it is invalid
+size_t get_utf8_sequence_length(const unsigned char *c) {
+    size_t length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xbf;
+    if (*c >= 0xc2 && *c <= 0xdf) {
+        length = 2;
+    } else if (*c >= 0xe0 && *c <= 0xef) {
+        // overlong encodings and surrogates are invalid
+        length = 3;
+        min = *c == 0xe0 ? 0xa0 : min;
+        max = *c == 0xed ? 0x9f : max;
+    } else if (*c >= 0xf0 && *c <= 0xf4) {
+        // overlong encodings and code points above U+10FFFF are invalid
+        length = 4;
+        min = *c == 0xf0 ? 0x90 : min;
+        max = *c == 0xf4 ? 0x8f : max;
+    } else {
+        return 0;
+    }
+    if (c[1] < min || c[1] > max) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (c[i] < 0x80 || c[i] > 0xbf) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// print a string as json string, control characters are escaped. bytes that are not
+// valid utf-8, e.g. latin-1 values of tiff tags, are escaped as the code point of the byte
+void print_json_string(FILE *out, const char *value) {
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)value; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c == '\n') {
+            fputs("\\n", out);
+        } else if (*c == '\r') {
+            fputs("\\r", out);
+        } else if (*c == '\t') {
+            fputs("\\t", out);
+        } else if (*c < 0x20 || *c == 0x7f) {
+            fprintf(out, "\\u%04x", *c);
+        } else if (*c < 0x80) {
+            fputc(*c, out);
+        } else {
+            size_t length = get_utf8_sequence_length(c);
+            if (length == 0) {
+                fprintf(out, "\\u%04x", *c);
+            } else {
+                fwrite(c, 1, length, out);
+                c += length - 1;
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+// print the metadata attributes as json array of key value pairs
+void print_metadata_attributes_json(const struct metadata *metadata) {
+    fputc('[', stdout);
+    if (metadata != NULL) {
+        for (size_t metadata_id = 0; metadata_id < metadata->length; metadata_id++) {
+            fprintf(stdout, metadata_id == 0 ? "{\"key\":" : ",{\"key\":");
+            print_json_string(stdout, metadata->attributes[metadata_id]->key);
+            fprintf(stdout, ",\"value\":");
+            print_json_string(stdout, metadata->attributes[metadata_id]->value);
+            fputc('}', stdout);
+        }
+    }
+    fputc(']', stdout);
+}
+
+void print_metadata_json(const char *filename, struct wsi_data *wsi_data) {
+    fprintf(stdout, "{\"file\":");
+    print_json_string(stdout, filename);
+    fprintf(stdout, ",\"format\":\"%s\",\"metadata\":", VENDOR_AND_FORMAT_STRINGS[wsi_data->format]);
+    print_metadata_attributes_json(wsi_data->metadata_attributes);
+    fprintf(stdout, "}\n");
+}
+
+// files that could not be read fail, files of other formats are unsupported
+enum batch_result get_batch_result(int32_t result, FILE_FORMAT format) {
+    if (format == UNKNOWN) {
+        return BATCH_UNSUPPORTED;
+    }
+    return result == 0 ? BATCH_ANONYMIZED : BATCH_FAILED;
+}
+
+// print the result of an anonymization and the metadata found before as a single line json object
+void print_result_json(const char *filename, int32_t result, const struct anonymization_stats *stats,
+                       const struct metadata *metadata) {
+    fprintf(stdout, "{\"file\":");
+    print_json_string(stdout, filename);
+    fprintf(stdout, ",\"format\":\"%s\",\"status\":\"%s\",\"metadata\":", VENDOR_AND_FORMAT_STRINGS[stats->format],
+            BATCH_RESULT_STRINGS[get_batch_result(result, stats->format)]);
+    print_metadata_attributes_json(metadata);
+    fprintf(stdout, ",\"label_directory\":%" PRId64 ",\"macro_directory\":%" PRId64 ",\"bytes_wiped\":%" PRIu64,
+            stats->label_directory, stats->macro_directory, stats->bytes_wiped);
+    fprintf(stdout, ",\"reads\":%" PRIu64 ",\"bytes_read\":%" PRIu64, stats->reads, stats->bytes_read);
+    fprintf(stdout, ",\"writes\":%" PRIu64 ",\"bytes_written\":%" PRIu64, stats->writes, stats->bytes_written);
+    fprintf(stdout, ",\"seeks\":%" PRIu64 ",\"allocations\":%" PRIu64, stats->seeks, stats->allocations);
+    fprintf(stdout, ",\"bytes_copied\":%" PRIu64 ",\"copy_method\":", stats->bytes_copied);
+    if (stats->copy_method != NULL) {
+        fprintf(stdout, "\"%s\"", stats->copy_method);
+    } else {
+        fprintf(stdout, "null");
+    }
+    fprintf(stdout, ",\"phases_ms\":{");
+    for (int32_t phase = 0; phase < PHASE_NONE; phase++) {
+        fprintf(stdout, "%s\"%s\":%.3f", phase == 0 ? "" : ",", PHASE_STRINGS[phase],
+                stats->phase_seconds[phase] * 1000);
+    }
+    fprintf(stdout, "},\"total_ms\":%.3f}\n", stats->total_seconds * 1000);
+}
+
+int32_t get_number_of_processors() {
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int32_t)count : 1;
+#elif defined(_WIN32) || defined(_WIN64)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int32_t)info.dwNumberOfProcessors : 1;
+#else
+    return 1;
+#endif
+}
+
+bool add_batch_file(struct batch_job *job, size_t *capacity, const char *filename) {
+    if (job->count == *capacity) {
+        *capacity = *capacity == 0 ? 64 : *capacity * 2;
+        char **filenames = (char **)realloc(job->filenames, *capacity * sizeof(char *));
+        if (filenames == NULL) {
+            fprintf(stderr, "Error: Could not allocate memory for file list.\n");
+            return false;
+        }
+        job->filenames = filenames;
+    }
+    job->filenames[job->count++] = strdup(filename);
+    return true;
+}
+
+int32_t compare_filenames(const void *a, const void *b) { return strcmp(*(char **)a, *(char **)b); }
+
+// collect all regular files of a directory (not recursive), mirax
+// data directories are picked up by the handler of the .mrxs file
+int32_t collect_directory(struct batch_job *job, size_t *capacity, const char *path) {
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__)) || defined(_WIN32) || defined(_WIN64)
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Error: Could not open directory %s.\n", path);
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *entry_filename = concat_path_filename(path, entry->d_name);
+        struct stat st;
+        if (stat(entry_filename, &st) == 0 && S_ISREG(st.st_mode) && !add_batch_file(job, capacity, entry_filename)) {
+            free((void *)entry_filename);
+            closedir(dir);
+            return -1;
+        }
+        free((void *)entry_filename);
+    }
+    closedir(dir);
+    qsort(job->filenames, job->count, sizeof(char *), compare_filenames);
+    return 0;
+#else
+    UNUSED(job);
+    UNUSED(capacity);
+    fprintf(stderr, "Error: Directories are not supported in batch mode on this platform.\n");
+    return -1;
+#endif
+}
+
+int32_t collect_glob(struct batch_job *job, size_t *capacity, const char *pattern) {
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    glob_t matches;
+    int32_t result = glob(pattern, 0, NULL, &matches);
+    if (result == GLOB_NOMATCH) {
+        fprintf(stderr, "Error: No files match %s.\n", pattern);
+        return -1;
+    } else if (result != 0) {
+        fprintf(stderr, "Error: Could not expand %s.\n", pattern);
+        return -1;
+    }
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        if (!add_batch_file(job, capacity, matches.gl_pathv[i])) {
+            globfree(&matches);
+            return -1;
+        }
+    }
+    globfree(&matches);
+    return 0;
+#else
+    UNUSED(job);
+    UNUSED(capacity);
+    fprintf(stderr, "Error: Glob patterns are not supported on this platform (%s).\n", pattern);
+    return -1;
+#endif
+}
+
+// read a newline-delimited list of files, empty lines are ignored
+int32_t collect_manifest(struct batch_job *job, size_t *capacity, FILE *manifest) {
+    char line[BATCH_MAX_PATH_LENGTH];
+    while (fgets(line, sizeof(line), manifest) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' && !feof(manifest)) {
+            fprintf(stderr, "Error: Path in file list exceeds %d characters.\n", BATCH_MAX_PATH_LENGTH - 1);
+            return -1;
+        }
+        line[length] = '\0';
+        if (length > 0 && !add_batch_file(job, capacity, line)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int32_t collect_batch_files(struct batch_job *job, const char *input) {
+    size_t capacity = 0;
+    struct stat st;
+    if (strcmp(input, "-") == 0) {
+        return collect_manifest(job, &capacity, stdin);
+    } else if (stat(input, &st) == 0 && S_ISDIR(st.st_mode)) {
+        return collect_directory(job, &capacity, input);
+    } else if (strpbrk(input, "*?[") != NULL) {
+        return collect_glob(job, &capacity, input);
+    }
+    return add_batch_file(job, &capacity, input) ? 0 : -1;
+}
+
+// the copy of each file is named after the file followed by the label suffix
+char *get_batch_label_name(const char *filename, const char *label_suffix) {
+    const char *name = get_filename_from_path(filename);
+    const char *dot = strrchr(name, '.');
+    size_t length = dot != NULL && dot != name ? (size_t)(dot - name) : strlen(name);
+    char *label_name = (char *)malloc(length + strlen(label_suffix) + 1);
+    memcpy(label_name, name, length);
+    strcpy(label_name + length, label_suffix);
+    return label_name;
+}
+
+// anonymize a file and collect its stats, the metadata found during format detection
+// is handed over to the caller, since the handlers only rewrite the file
+int32_t anonymize_file_with_metadata(const char *filename, const char *label_name, bool keep_macro_image,
+                                     bool disable_unlinking, bool do_inplace, struct anonymization_stats *stats,
+                                     struct metadata **metadata) {
+    stats_start_recording(stats);
+    int32_t result = -1;
+    struct wsi_data *wsi_data = get_wsi_data(filename);
+    *metadata = wsi_data->metadata_attributes;
+    wsi_data->metadata_attributes = NULL;
+    if (wsi_data->format == UNKNOWN || wsi_data->format == INVALID) {
+        // missing or unreadable files fail, files of other formats are skipped
+        free_wsi_data(wsi_data);
+    } else {
+        result = anonymize_wsi_data(wsi_data, &filename, label_name, keep_macro_image, disable_unlinking, do_inplace);
+    }
+    stats_stop_recording();
+    return result;
+}
+
+int32_t anonymize_batch_file(struct batch_job *job, const char *filename, struct anonymization_stats *stats,
+                             struct metadata **metadata) {
+    char *label_name = get_batch_label_name(filename, job->label_suffix);
+    int32_t result = anonymize_file_with_metadata(filename, label_name, job->keep_macro_image, job->disable_unlinking,
+                                                  job->do_inplace, stats, metadata);
+    free(label_name);
+    return result;
+}
+
+void *batch_worker(void *arg) {
+    struct batch_job *job = (struct batch_job *)arg;
+    while (true) {
+        pthread_mutex_lock(&job->mutex);
+        size_t index = job->next++;
+        pthread_mutex_unlock(&job->mutex);
+        if (index >= job->count) {
+            return NULL;
+        }
+
+        struct anonymization_stats stats;
+        struct metadata *metadata;
+        int32_t result = anonymize_batch_file(job, job->filenames[index], &stats, &metadata);
+
+        pthread_mutex_lock(&job->mutex);
+        job->results[get_batch_result(result, stats.format)]++;
+        if (job->json_output) {
+            print_result_json(job->filenames[index], result, &stats, metadata);
+        } else {
+            fprintf(stdout, "%-11s %s\n", BATCH_RESULT_STRINGS[get_batch_result(result, stats.format)],
+                    job->filenames[index]);
+        }
+        fflush(stdout);
+        pthread_mutex_unlock(&job->mutex);
+        free_metadata(metadata);
+    }
+}
+
+// anonymize all files of the input on a pool of worker threads
+int32_t anonymize_batch(const char *input, int32_t num_of_threads, const char *label_suffix, bool keep_macro_image,
+                        bool disable_unlinking, bool do_inplace, bool json_output) {
+    struct batch_job job = {.filenames = NULL,
+                            .count = 0,
+                            .next = 0,
+                            .results = {0, 0, 0},
+                            .label_suffix = label_suffix,
+                            .keep_macro_image = keep_macro_image,
+                            .disable_unlinking = disable_unlinking,
+                            .do_inplace = do_inplace,
+                            .json_output = json_output};
+    int32_t result = collect_batch_files(&job, input);
+
+    if (result == 0) {
+        if ((size_t)num_of_threads > job.count) {
+            num_of_threads = job.count > 0 ? (int32_t)job.count : 1;
+        }
+        pthread_mutex_init(&job.mutex, NULL);
+        pthread_t *threads = (pthread_t *)malloc(num_of_threads * sizeof(pthread_t));
+        int32_t num_of_started_threads = 0;
+        for (; num_of_started_threads < num_of_threads; num_of_started_threads++) {
+            if (pthread_create(&threads[num_of_started_threads], NULL, batch_worker, &job) != 0) {
+                break;
+            }
+        }
+        if (num_of_started_threads == 0) {
+            fprintf(stderr, "Error: Could not start worker threads.\n");
+            result = -1;
+        }
+        for (int32_t i = 0; i < num_of_started_threads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        pthread_mutex_destroy(&job.mutex);
+
+        if (json_output) {
+            fprintf(stdout, "{\"files\":%zu,\"anonymized\":%zu,\"failed\":%zu,\"unsupported\":%zu}\n", job.count,
+                    job.results[BATCH_ANONYMIZED], job.results[BATCH_FAILED], job.results[BATCH_UNSUPPORTED]);
+        } else {
+            fprintf(stdout, "Anonymized %zu of %zu files (%zu failed, %zu unsupported).\n",
+                    job.results[BATCH_ANONYMIZED], job.count, job.results[BATCH_FAILED],
+                    job.results[BATCH_UNSUPPORTED]);
+        }
+        if (job.results[BATCH_FAILED] > 0) {
+            result = -1;
+        }
+    }
+
+    for (size_t i = 0; i < job.count; i++) {
+        free(job.filenames[i]);
+    }
+    free(job.filenames);
+    return result;
+}
+
 int32_t main(int32_t argc, char *argv[]) {
     bool only_check = false;
     bool keep_macro_image = false;
     bool disable_unlinking = false;
     bool do_inplace = false;
+    bool batch_mode = false;
+    bool verbose = false;
+    bool json_output = false;
+    int32_t num_of_threads = 0;
+    uint64_t lookahead_size = STREAM_LOOKAHEAD_SIZE;
+    const char *stream_extension = SVS;
     const char *filename = NULL;
     const char *new_label_name = NULL;
+    const char *delta_filename = NULL;
+    const char *apply_delta_filename = NULL;
+    const char *output_filename = NULL;
 
     if (argv[1] == NULL) {
         fprintf(stderr, "No filename specified.\n\n");
@@ -78,6 +510,64 @@ int32_t main(int32_t argc, char *argv[]) {
                 keep_macro_image = true;
                 break;
             }
+            case 'd': {
+                delta_filename = argv[++optind];
+                break;
+            }
+            case 'a': {
+                apply_delta_filename = argv[++optind];
+                break;
+            }
+            case 'o': {
+                output_filename = argv[++optind];
+                break;
+            }
+            case 'b': {
+                batch_mode = true;
+                break;
+            }
+            case 'v': {
+                verbose = true;
+                break;
+            }
+            case 'q': {
+                if (file_use_io_uring(true) != 0) {
+                    fprintf(stderr, "io_uring is not supported on this system.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'f': {
+                const char *output_format = argv[optind + 1] != NULL ? argv[++optind] : "";
+                if (strcmp(output_format, "json") == 0) {
+                    json_output = true;
+                } else if (strcmp(output_format, "text") != 0) {
+                    fprintf(stderr, "Invalid output format.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
+            case 'e': {
+                stream_extension = argv[optind + 1] != NULL ? argv[++optind] : "";
+                break;
+            }
+            case 'l': {
+                int32_t lookahead_mib = argv[optind + 1] != NULL ? atoi(argv[++optind]) : 0;
+                if (lookahead_mib <= 0) {
+                    fprintf(stderr, "Invalid lookahead size.\n");
+                    exit(EXIT_FAILURE);
+                }
+                lookahead_size = (uint64_t)lookahead_mib * 1048576;
+                break;
+            }
+            case 'j': {
+                num_of_threads = argv[optind + 1] != NULL ? atoi(argv[++optind]) : 0;
+                if (num_of_threads <= 0) {
+                    fprintf(stderr, "Invalid number of worker threads.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            }
             case 'h': {
                 print_help_message();
                 exit(EXIT_FAILURE);
@@ -91,9 +581,53 @@ int32_t main(int32_t argc, char *argv[]) {
         }
     }
 
+    if (batch_mode) {
+        if (num_of_threads == 0) {
+            num_of_threads = get_number_of_processors();
+        }
+        int32_t result =
+            anonymize_batch(filename, num_of_threads, new_label_name != NULL ? new_label_name : "_anonymized_wsi",
+                            keep_macro_image, disable_unlinking, do_inplace, json_output);
+        exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (apply_delta_filename != NULL) {
+        int32_t result;
+        if (output_filename != NULL && strcmp(output_filename, "-") == 0) {
+            result = stream_delta(filename, apply_delta_filename, stdout);
+        } else {
+            result = apply_delta(filename, apply_delta_filename, output_filename);
+            if (result == 0) {
+                fprintf(stdout, "Done.\n");
+            }
+        }
+        exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (strcmp(filename, "-") == 0) {
+        // stdout only carries the anonymized slide
+        int32_t result =
+            anonymize_wsi_stream(stdin, stdout, stream_extension, lookahead_size, keep_macro_image, disable_unlinking);
+        exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    if (delta_filename != NULL) {
+        if (anonymize_wsi_to_delta(filename, delta_filename, keep_macro_image, disable_unlinking) != 0) {
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stdout, "Done.\n");
+        exit(EXIT_SUCCESS);
+    }
+
     if (only_check) {
         if (filename != NULL) {
             struct wsi_data *wsi_data = get_wsi_data(filename);
+            if (json_output) {
+                print_metadata_json(filename, wsi_data);
+                int32_t result = wsi_data->metadata_attributes != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+                free_wsi_data(wsi_data);
+                exit(result);
+            }
             // if format is supported and valid
             if (wsi_data->metadata_attributes != NULL) {
                 // TODO: print out the rest of information (label and macro dims if available)
@@ -112,14 +646,27 @@ int32_t main(int32_t argc, char *argv[]) {
         }
     } else {
         if (filename != NULL) {
-            if (new_label_name != NULL) {
-                anonymize_wsi(filename, new_label_name, keep_macro_image, disable_unlinking, do_inplace);
+            // TODO: new file name (old_filename + tag)
+            struct anonymization_context context = {new_label_name != NULL ? new_label_name : "_anonymized_wsi",
+                                                    keep_macro_image, disable_unlinking, do_inplace, 0};
+            struct anonymization_stats stats;
+            int32_t result;
+            if (json_output) {
+                struct metadata *metadata;
+                result = anonymize_file_with_metadata(filename, context.new_label_name, keep_macro_image,
+                                                      disable_unlinking, do_inplace, &stats, &metadata);
+                print_result_json(filename, result, &stats, metadata);
+                free_metadata(metadata);
             } else {
-                // TODO: new file name (old_filename + tag)
-                anonymize_wsi(filename, "_anonymized_wsi", keep_macro_image, disable_unlinking, do_inplace);
+                result = anonymize_wsi_ex(filename, &context, &stats);
+                if (result == 0) {
+                    fprintf(stdout, "Done.\n");
+                }
+                if (verbose) {
+                    print_stats(&stats);
+                }
             }
-            fprintf(stdout, "Done.\n");
-            exit(EXIT_SUCCESS);
+            exit(result == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
         } else {
             fprintf(stderr, "No file for anonymization selected.\n");
             exit(EXIT_FAILURE);
@@ -11,6 +11,23 @@
 
 #define UNUSED(x) (void)(x)
 
+// file copy and delta
+#define COPY_CHUNK_SIZE 1048576
+#define DELTA_MAGIC "WSIDELTA"
+#define DELTA_VERSION 1
+#define COPY_KERNEL_CHUNK_SIZE 1073741824
+#define STREAM_LOOKAHEAD_SIZE 268435456
+
+// wiping of image data
+#define WIPE_CHUNK_SIZE 1048576
+
+// searching values in files
+#define SEARCH_CHUNK_SIZE 1048576
+
+// arena of parsed file structures
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+
 // mirax
 #define MAX_CHAR_IN_LINE 100
 #define MRXS_ROOT_OFFSET_NONHIER 41
@@ -73,12 +90,15 @@
 #define PHILIPS_DELIMITER_INT "\"IUInt16\""
 #define PHILIPS_ATT_END "</Attribute"
 #define PHILIPS_ATT_OPEN "<Attribute"
+#define PHILIPS_ATT_NAME " Name=\""
 #define PHILIPS_CLOSING_SYMBOL ">"
 #define PHILIPS_ATT_PMSVR "PMSVR="
 #define PHILIPS_DATETIME_ATT "DICOM_ACQUISITION_DATETIME"
 #define PHILIPS_SERIAL_ATT "DICOM_DEVICE_SERIAL_NUMBER"
 #define PHILIPS_SLOT_ATT "<Attribute Name=\"PIIM_DP_SCANNER_SLOT_NUMBER"
 #define PHILIPS_RACK_ATT "<Attribute Name=\"PIIM_DP_SCANNER_RACK_NUMBER"
+#define PHILIPS_SLOT_NAME "PIIM_DP_SCANNER_SLOT_NUMBER"
+#define PHILIPS_RACK_NAME "PIIM_DP_SCANNER_RACK_NUMBER"
 #define PHILIPS_OPERID_ATT "PIIM_DP_SCANNER_OPERATOR_ID"
 #define PHILIPS_BARCODE_ATT "PIM_DP_UFS_BARCODE"
 #define PHILIPS_SOURCE_FILE_ATT "PIM_DP_SOURCE_FILE"
@@ -87,13 +107,12 @@
 #define PHILIPS_MACROIMAGE "MACROIMAGE"
 #define PHILIPS_OBJECT "Object>"
 #define PHILIPS_IMAGE_DATA "PIM_DP_IMAGE_DATA"
+#define PHILIPS_IMAGE_TYPE "PIM_DP_IMAGE_TYPE"
 
 // iSyntax
 #define ISYNTAX_ROOTNODE "DPUfsImport"
 #define ISYNTAX_EOT "\r\n\004"
 #define ISYNTAX_DATA "</Data"
-#define ISYNTAX_APPROX_HEADER_SIZE 80
-#define ISYNTAX_APPROX_EOT_SIZE 5000000
 
 // hamamatsu
 #define NDPI_FORMAT_FLAG 65420
@@ -135,6 +154,17 @@ typedef enum {
     INVALID = 7
 } FILE_FORMAT;
 
+typedef enum {
+    PHASE_PROBE = 0,
+    PHASE_PARSE = 1,
+    PHASE_WIPE_LABEL = 2,
+    PHASE_WIPE_MACRO = 3,
+    PHASE_METADATA = 4,
+    PHASE_UNLINK = 5,
+    PHASE_COPY = 6,
+    PHASE_NONE = 7
+} ANONYMIZATION_PHASE;
+
 #define ASCII 2
 #define SHORT 3
 #define LONG 4
@@ -198,6 +228,8 @@ struct tiff_entry {
 
 struct tiff_directory {
     struct tiff_entry *entries;
+    // tags of the entries in a contiguous array for scanning
+    uint16_t *tags;
     uint32_t count;
     uint64_t in_pointer_offset;
     uint64_t out_pointer_offset;
@@ -205,10 +237,148 @@ struct tiff_directory {
     uint32_t ndpi_high_bits;
 };
 
+// block of an arena, the allocated bytes follow the header
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+};
+
+// bump allocator, all allocations are released at once with the arena
+struct arena {
+    struct arena_block *blocks;
+};
+
+// node of the trie of a pattern scanner. the fail link points to the node of the longest
+// proper suffix in the trie, the output link to the next node on the fail chain ending a pattern
+struct pattern_scanner_node {
+    int32_t first_child;
+    int32_t next_sibling;
+    int32_t fail;
+    int32_t output;
+    int32_t pattern;
+    uint32_t depth;
+    uint8_t symbol;
+};
+
+// aho-corasick automaton finding several patterns in a single pass
+struct pattern_scanner {
+    struct pattern_scanner_node *nodes;
+    size_t num_nodes;
+    size_t num_patterns;
+    int32_t root_children[256];
+};
+
+// position of an entry in the tag index of a tiff file
+struct tiff_tag_reference {
+    uint16_t tag;
+    uint32_t dir;
+    uint32_t entry;
+    // value of the entry, cached when it is read for the first time
+    char *value;
+};
+
+// values of a directory entry, requested by tag and read with read_values_by_tags
+struct tag_values {
+    int32_t tag;
+    // values of the entry, NULL if the entry is missing or could not be read
+    void *values;
+    int32_t length;
+};
+
 struct tiff_file {
     uint32_t used;
     uint32_t size;
     struct tiff_directory *directories;
+    bool big_tiff;
+    bool big_endian;
+    bool ndpi;
+    // position of the next directory in the chain that is not read yet, 0 when all are read
+    uint64_t next_dir_offset;
+    uint64_t next_in_pointer_offset;
+    // holds the directories and entries
+    struct arena arena;
+    // all entries sorted by tag, directory and entry, built on first use
+    struct tiff_tag_reference *tag_index;
+    uint64_t tag_index_size;
+    // directories were read after the index was built, cached values are kept on rebuilding it
+    bool tag_index_outdated;
+};
+
+// options of a single anonymization call. all state of the call is local to it,
+// so that several files can be anonymized concurrently on different threads
+struct anonymization_context {
+    const char *new_label_name;
+    bool keep_macro_image;
+    bool disable_unlinking;
+    bool do_inplace;
+    // seed for pseudonymized values, 0 continues the generator of the calling thread
+    uint64_t random_seed;
+};
+
+// statistics of a single anonymization call. the time of a phase does not
+// include the time of phases nested into it, e.g. parsing during probing
+struct anonymization_stats {
+    uint64_t reads;
+    uint64_t seeks;
+    uint64_t writes;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t allocations;
+    double phase_seconds[PHASE_NONE];
+    double total_seconds;
+    // detected format, INVALID if the file could not be probed
+    FILE_FORMAT format;
+    // tiff directories of the wiped label and macro image, -1 if none was wiped
+    int64_t label_directory;
+    int64_t macro_directory;
+    // bytes written while wiping label and macro image
+    uint64_t bytes_wiped;
+    // bytes of the copies of the input and the method of the last copy, NULL if nothing was copied
+    uint64_t bytes_copied;
+    const char *copy_method;
+};
+
+struct data_range {
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct copy_stats {
+    uint64_t bytes_copied;
+    double seconds;
+    // copy method used, e.g. reflink, copy_file_range, sendfile or chunked
+    const char *method;
+};
+
+struct file_patch {
+    uint64_t offset;
+    uint64_t length;
+    // allocated size of the data, patches grow in place when writes are appended
+    uint64_t capacity;
+    uint8_t *data;
+};
+
+// sorted and non-overlapping patches on top of an unmodified file
+struct file_delta {
+    struct file_patch *patches;
+    size_t count;
+    size_t capacity;
+    uint64_t original_size;
+};
+
+// input of a streamed anonymization. the beginning of the input is kept in a
+// lookahead buffer, which is filled on demand up to the limit
+struct stream_source {
+    FILE *input;
+    uint8_t *buffer;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t limit;
+    // set when the end of the input was read into the buffer
+    bool eof;
+    // set when bytes behind the limit were needed
+    bool exceeded;
 };
 
 struct metadata_attribute {
@@ -216,6 +386,25 @@ struct metadata_attribute {
     char *value;
 };
 
+// attribute element of a philips xml header. the value is the text behind the opening
+// tag, the length covers the element up to its closing tag and is 0 for nested elements
+struct xml_attribute {
+    char *start;
+    size_t length;
+    const char *name;
+    size_t name_length;
+    char *value;
+    size_t value_length;
+};
+
+// ranges of a buffer that were changed in place and have to be written back
+struct xml_patches {
+    uint64_t *offsets;
+    uint64_t *lengths;
+    int32_t count;
+    int32_t capacity;
+};
+
 struct metadata {
     struct metadata_attribute **attributes;
     size_t length;
@@ -228,6 +417,8 @@ struct wsi_data {
     // struct associated_image_data **label;
     // struct associated_image_data **macro;
     struct metadata *metadata_attributes;
+    // file structure of tiff based formats read during format detection
+    struct tiff_file *tiff_file;
 };
 
 #endif
\ No newline at end of file
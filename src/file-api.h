@@ -1,13 +1,37 @@
 #ifndef HEADER_FILE_API_H
 #define HEADER_FILE_API_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 typedef struct file_s file_handle;
 
+struct file_delta;
+
+struct stream_source;
+
+// a positioned read or write of a batch
+struct file_io_request {
+    uint64_t offset;
+    void *buffer;
+    size_t length;
+    bool write;
+    // number of bytes transferred, set when the batch is completed
+    size_t result;
+};
+
 file_handle *file_open(const char *filename, const char *mode);
 
+// opens an existing file as memory mapping if supported by the platform,
+// otherwise behaves like file_open. with the io_uring backend enabled, the
+// file is opened for positioned reads and writes through a ring instead
+file_handle *file_open_mapped(const char *filename, const char *mode);
+
+// enables the io_uring backend for files opened by file_open_mapped afterwards,
+// returns -1 if io_uring is not supported by the platform or the kernel
+int32_t file_use_io_uring(bool enabled);
+
 size_t file_read(void *buffer, size_t element_size, size_t element_count, file_handle *stream);
 
 char *file_gets(char *buffer, int32_t max_count, file_handle *stream);
@@ -26,4 +50,26 @@ uint64_t file_tell(file_handle *stream);
 
 int32_t file_close(file_handle *stream);
 
+// starts the requests as positioned reads and writes without waiting for them, the
+// stream position is not changed. the requests and their buffers have to stay valid
+// and untouched until file_reap_requests is called. returns -1 if they could not be queued
+int32_t file_submit_requests(file_handle *stream, struct file_io_request *requests, size_t count);
+
+// waits for all requests submitted since the last reap. returns 0 if all of them
+// transferred their full length, otherwise -1
+int32_t file_reap_requests(file_handle *stream);
+
+// submits the requests and waits for them like file_submit_requests and file_reap_requests
+int32_t file_submit_batch(file_handle *stream, struct file_io_request *requests, size_t count);
+
+// while recording, the given file is opened read-only by this thread and all
+// writes to it are recorded into the delta instead
+int32_t file_start_delta_recording(const char *filename, struct file_delta *delta);
+
+// like file_start_delta_recording, but the original bytes of the file are read
+// from the lookahead buffer of the source, the file does not need to exist
+int32_t file_start_stream_recording(const char *filename, struct stream_source *source, struct file_delta *delta);
+
+void file_stop_delta_recording();
+
 #endif
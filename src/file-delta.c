@@ -0,0 +1,403 @@
+#include "file-delta.h"
+#include "stats-alloc.h"
+
+struct file_delta *init_file_delta() {
+    struct file_delta *delta = (struct file_delta *)malloc(sizeof(struct file_delta));
+    delta->patches = NULL;
+    delta->count = 0;
+    delta->capacity = 0;
+    delta->original_size = 0;
+    return delta;
+}
+
+void free_file_delta(struct file_delta *delta) {
+    for (size_t i = 0; i < delta->count; i++) {
+        free(delta->patches[i].data);
+    }
+    free(delta->patches);
+    free(delta);
+}
+
+// binary search for the first patch ending at or behind the given offset
+static size_t find_first_patch(const struct file_delta *delta, uint64_t offset) {
+    size_t lower = 0;
+    size_t upper = delta->count;
+    while (lower < upper) {
+        size_t middle = lower + (upper - lower) / 2;
+        if (delta->patches[middle].offset + delta->patches[middle].length < offset) {
+            lower = middle + 1;
+        } else {
+            upper = middle;
+        }
+    }
+    return lower;
+}
+
+// add a written byte range to the delta. overlapping and adjacent patches are merged,
+// so that the patches stay sorted and bytes written later replace earlier ones
+int32_t add_patch_to_delta(struct file_delta *delta, uint64_t offset, const void *data, uint64_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    uint64_t end = offset + length;
+
+    // find the patches overlapping or touching the new range
+    size_t first = find_first_patch(delta, offset);
+    size_t last = first;
+    while (last < delta->count && delta->patches[last].offset <= end) {
+        last++;
+    }
+
+    // a range starting within or right behind a single patch, e.g. the next chunk
+    // of a wiped strip, is written into that patch, which grows in place
+    if (last - first == 1 && delta->patches[first].offset <= offset) {
+        struct file_patch *patch = &delta->patches[first];
+        uint64_t patch_length = end - patch->offset;
+        if (patch_length > patch->capacity) {
+            uint64_t capacity = patch->capacity * 2 > patch_length ? patch->capacity * 2 : patch_length;
+            uint8_t *patch_data = (uint8_t *)realloc(patch->data, capacity);
+            if (patch_data == NULL) {
+                fprintf(stderr, "Error: Could not allocate memory for patch.\n");
+                return -1;
+            }
+            patch->data = patch_data;
+            patch->capacity = capacity;
+        }
+        if (patch_length > patch->length) {
+            patch->length = patch_length;
+        }
+        memcpy(patch->data + (offset - patch->offset), data, length);
+        return 0;
+    }
+
+    uint64_t merged_offset = offset;
+    uint64_t merged_end = end;
+    if (last > first) {
+        struct file_patch *last_patch = &delta->patches[last - 1];
+        if (delta->patches[first].offset < merged_offset) {
+            merged_offset = delta->patches[first].offset;
+        }
+        if (last_patch->offset + last_patch->length > merged_end) {
+            merged_end = last_patch->offset + last_patch->length;
+        }
+    }
+
+    uint8_t *merged_data = (uint8_t *)malloc(merged_end - merged_offset);
+    if (merged_data == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for patch.\n");
+        return -1;
+    }
+    for (size_t i = first; i < last; i++) {
+        memcpy(merged_data + (delta->patches[i].offset - merged_offset), delta->patches[i].data,
+               delta->patches[i].length);
+        free(delta->patches[i].data);
+    }
+    memcpy(merged_data + (offset - merged_offset), data, length);
+
+    // replace the merged patches by a single one
+    if (last == first) {
+        if (delta->count == delta->capacity) {
+            size_t capacity = delta->capacity == 0 ? 16 : delta->capacity * 2;
+            struct file_patch *patches =
+                (struct file_patch *)realloc(delta->patches, capacity * sizeof(struct file_patch));
+            if (patches == NULL) {
+                fprintf(stderr, "Error: Could not allocate memory for patch.\n");
+                free(merged_data);
+                return -1;
+            }
+            delta->patches = patches;
+            delta->capacity = capacity;
+        }
+        memmove(&delta->patches[first + 1], &delta->patches[first],
+                (delta->count - first) * sizeof(struct file_patch));
+        delta->count++;
+    } else if (last - first > 1) {
+        memmove(&delta->patches[first + 1], &delta->patches[last], (delta->count - last) * sizeof(struct file_patch));
+        delta->count -= last - first - 1;
+    }
+    delta->patches[first].offset = merged_offset;
+    delta->patches[first].length = merged_end - merged_offset;
+    delta->patches[first].capacity = merged_end - merged_offset;
+    delta->patches[first].data = merged_data;
+    return 0;
+}
+
+// overlay the patched bytes onto a buffer holding the original bytes at the given offset
+void apply_delta_to_buffer(const struct file_delta *delta, uint64_t offset, void *buffer, uint64_t length) {
+    uint64_t end = offset + length;
+    for (size_t i = find_first_patch(delta, offset); i < delta->count; i++) {
+        struct file_patch *patch = &delta->patches[i];
+        uint64_t patch_end = patch->offset + patch->length;
+        if (patch->offset >= end) {
+            break;
+        }
+        if (patch_end <= offset) {
+            continue;
+        }
+        uint64_t from = patch->offset > offset ? patch->offset : offset;
+        uint64_t to = patch_end < end ? patch_end : end;
+        memcpy((uint8_t *)buffer + (from - offset), patch->data + (from - patch->offset), to - from);
+    }
+}
+
+// size of the patched file, patches may extend the original file
+uint64_t get_size_of_delta_file(const struct file_delta *delta) {
+    uint64_t size = delta->original_size;
+    if (delta->count > 0) {
+        struct file_patch *last_patch = &delta->patches[delta->count - 1];
+        if (last_patch->offset + last_patch->length > size) {
+            size = last_patch->offset + last_patch->length;
+        }
+    }
+    return size;
+}
+
+// integers in the delta file are always stored in little endian
+bool write_uint64_le(file_handle *fp, uint64_t value) {
+    uint8_t buffer[8];
+    for (int32_t i = 0; i < 8; i++) {
+        buffer[i] = (value >> (8 * i)) & 0xff;
+    }
+    return file_write(buffer, sizeof(buffer), 1, fp) == 1;
+}
+
+bool read_uint64_le(file_handle *fp, uint64_t *value) {
+    uint8_t buffer[8];
+    if (file_read(buffer, sizeof(buffer), 1, fp) != 1) {
+        return false;
+    }
+    *value = 0;
+    for (int32_t i = 0; i < 8; i++) {
+        *value |= (uint64_t)buffer[i] << (8 * i);
+    }
+    return true;
+}
+
+// write the delta as sidecar file. the file consists of a header (magic, version, size of
+// the original file, number of patches) followed by offset, length and bytes of each patch
+int32_t write_delta_file(const struct file_delta *delta, const char *delta_filename) {
+    file_handle *fp = file_open(delta_filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not create delta file.\n");
+        return -1;
+    }
+
+    bool success = file_write(DELTA_MAGIC, strlen(DELTA_MAGIC), 1, fp) == 1 && write_uint64_le(fp, DELTA_VERSION) &&
+                   write_uint64_le(fp, delta->original_size) && write_uint64_le(fp, delta->count);
+    for (size_t i = 0; success && i < delta->count; i++) {
+        struct file_patch *patch = &delta->patches[i];
+        success = write_uint64_le(fp, patch->offset) && write_uint64_le(fp, patch->length) &&
+                  file_write(patch->data, patch->length, 1, fp) == 1;
+    }
+
+    if (file_close(fp) != 0 || !success) {
+        fprintf(stderr, "Error: Could not write delta file.\n");
+        return -1;
+    }
+    return 0;
+}
+
+struct file_delta *read_delta_file(const char *delta_filename) {
+    file_handle *fp = file_open(delta_filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open delta file.\n");
+        return NULL;
+    }
+
+    char magic[sizeof(DELTA_MAGIC)] = {0};
+    uint64_t version = 0;
+    uint64_t count = 0;
+    struct file_delta *delta = init_file_delta();
+    if (file_read(magic, strlen(DELTA_MAGIC), 1, fp) != 1 || strcmp(magic, DELTA_MAGIC) != 0 ||
+        !read_uint64_le(fp, &version) || version != DELTA_VERSION || !read_uint64_le(fp, &delta->original_size) ||
+        !read_uint64_le(fp, &count)) {
+        fprintf(stderr, "Error: Not a valid delta file.\n");
+        free_file_delta(delta);
+        file_close(fp);
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t offset, length;
+        if (!read_uint64_le(fp, &offset) || !read_uint64_le(fp, &length) || length > SIZE_MAX ||
+            offset > UINT64_MAX - length) {
+            fprintf(stderr, "Error: Invalid patch in delta file.\n");
+            free_file_delta(delta);
+            file_close(fp);
+            return NULL;
+        }
+        uint8_t *data = (uint8_t *)malloc(length);
+        if (data == NULL || file_read(data, length, 1, fp) != 1 ||
+            add_patch_to_delta(delta, offset, data, length) != 0) {
+            fprintf(stderr, "Error: Invalid patch in delta file.\n");
+            free(data);
+            free_file_delta(delta);
+            file_close(fp);
+            return NULL;
+        }
+        free(data);
+    }
+
+    file_close(fp);
+    return delta;
+}
+
+// open the original file of a delta and check that it matches the recorded size
+file_handle *open_original_of_delta(const char *filename, const struct file_delta *delta, const char *mode) {
+    file_handle *fp = file_open(filename, mode);
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open file.\n");
+        return NULL;
+    }
+    if (file_seek(fp, 0, SEEK_END) != 0 || file_tell(fp) != delta->original_size) {
+        fprintf(stderr, "Error: Delta file does not belong to file.\n");
+        file_close(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// write the patches of a delta file into a copy of the file, or into
+// the file itself if no output filename is given
+int32_t apply_delta(const char *filename, const char *delta_filename, const char *output_filename) {
+    struct file_delta *delta = read_delta_file(delta_filename);
+    if (delta == NULL) {
+        return -1;
+    }
+
+    file_handle *fp = open_original_of_delta(filename, delta, "rb");
+    if (fp == NULL) {
+        free_file_delta(delta);
+        return -1;
+    }
+    file_close(fp);
+
+    if (output_filename != NULL) {
+        if (copy_file_v2(filename, output_filename) != 0) {
+            free_file_delta(delta);
+            return -1;
+        }
+        filename = output_filename;
+    }
+
+    fp = file_open(filename, "rb+");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open file.\n");
+        free_file_delta(delta);
+        return -1;
+    }
+
+    // the patches do not overlap, so they are all written in one batch
+    int32_t result = 0;
+    struct file_io_request *requests =
+        (struct file_io_request *)malloc((delta->count + 1) * sizeof(struct file_io_request));
+    if (requests == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for write requests.\n");
+        result = -1;
+    }
+    for (size_t i = 0; i < delta->count && result == 0; i++) {
+        requests[i].offset = delta->patches[i].offset;
+        requests[i].buffer = delta->patches[i].data;
+        requests[i].length = delta->patches[i].length;
+        requests[i].write = true;
+    }
+    if (result == 0 && file_submit_batch(fp, requests, delta->count) != 0) {
+        fprintf(stderr, "Error: Could not write patch to file.\n");
+        result = -1;
+    }
+    free(requests);
+
+    if (file_close(fp) != 0) {
+        result = -1;
+    }
+    free_file_delta(delta);
+    return result;
+}
+
+// write the patched file to an output stream without modifying the file
+int32_t stream_delta(const char *filename, const char *delta_filename, FILE *output) {
+    struct file_delta *delta = read_delta_file(delta_filename);
+    if (delta == NULL) {
+        return -1;
+    }
+
+    file_handle *fp = open_original_of_delta(filename, delta, "rb");
+    if (fp == NULL) {
+        free_file_delta(delta);
+        return -1;
+    }
+
+    char *buffer = (char *)malloc(COPY_CHUNK_SIZE);
+    uint64_t size = get_size_of_delta_file(delta);
+    int32_t result = file_seek(fp, 0, SEEK_SET);
+    for (uint64_t offset = 0; offset < size && result == 0;) {
+        size_t chunk_size = (size - offset) < COPY_CHUNK_SIZE ? (size - offset) : COPY_CHUNK_SIZE;
+
+        // bytes behind the end of the original file are only defined by patches
+        size_t bytes_read = 0;
+        if (offset < delta->original_size) {
+            bytes_read = file_read(buffer, 1, chunk_size, fp);
+        }
+        memset(buffer + bytes_read, 0, chunk_size - bytes_read);
+
+        apply_delta_to_buffer(delta, offset, buffer, chunk_size);
+        if (fwrite(buffer, 1, chunk_size, output) != chunk_size) {
+            fprintf(stderr, "Error: Could not write to output.\n");
+            result = -1;
+        }
+        offset += chunk_size;
+    }
+
+    free(buffer);
+    file_close(fp);
+    free_file_delta(delta);
+    return result;
+}
+
+// write the streamed input with the patches of the delta applied to an output stream. the
+// lookahead is patched in place, the rest of the input is passed through chunk by chunk
+int32_t stream_with_delta(struct stream_source *source, struct file_delta *delta, FILE *output) {
+    apply_delta_to_buffer(delta, 0, source->buffer, source->size);
+    if (fwrite(source->buffer, 1, source->size, output) != source->size) {
+        fprintf(stderr, "Error: Could not write to output.\n");
+        return -1;
+    }
+
+    char *buffer = (char *)malloc(COPY_CHUNK_SIZE);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for streaming.\n");
+        return -1;
+    }
+    int32_t result = 0;
+    uint64_t offset = source->size;
+    while (!source->eof && result == 0) {
+        size_t bytes_read = fread(buffer, 1, COPY_CHUNK_SIZE, source->input);
+        source->eof = bytes_read < COPY_CHUNK_SIZE;
+        apply_delta_to_buffer(delta, offset, buffer, bytes_read);
+        if (fwrite(buffer, 1, bytes_read, output) != bytes_read) {
+            fprintf(stderr, "Error: Could not write to output.\n");
+            result = -1;
+        }
+        offset += bytes_read;
+    }
+    if (result == 0 && ferror(source->input)) {
+        fprintf(stderr, "Error: Could not read input.\n");
+        result = -1;
+    }
+
+    // patches behind the end of the input extend the file
+    delta->original_size = offset;
+    uint64_t size = get_size_of_delta_file(delta);
+    while (offset < size && result == 0) {
+        size_t chunk_size = (size - offset) < COPY_CHUNK_SIZE ? (size - offset) : COPY_CHUNK_SIZE;
+        memset(buffer, 0, chunk_size);
+        apply_delta_to_buffer(delta, offset, buffer, chunk_size);
+        if (fwrite(buffer, 1, chunk_size, output) != chunk_size) {
+            fprintf(stderr, "Error: Could not write to output.\n");
+            result = -1;
+        }
+        offset += chunk_size;
+    }
+    free(buffer);
+    return result;
+}
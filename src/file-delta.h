@@ -0,0 +1,27 @@
+#ifndef HEADER_FILE_DELTA_H
+#define HEADER_FILE_DELTA_H
+
+#include "defines.h"
+#include "utils.h"
+
+struct file_delta *init_file_delta();
+
+void free_file_delta(struct file_delta *delta);
+
+int32_t add_patch_to_delta(struct file_delta *delta, uint64_t offset, const void *data, uint64_t length);
+
+void apply_delta_to_buffer(const struct file_delta *delta, uint64_t offset, void *buffer, uint64_t length);
+
+uint64_t get_size_of_delta_file(const struct file_delta *delta);
+
+int32_t write_delta_file(const struct file_delta *delta, const char *delta_filename);
+
+struct file_delta *read_delta_file(const char *delta_filename);
+
+int32_t apply_delta(const char *filename, const char *delta_filename, const char *output_filename);
+
+int32_t stream_delta(const char *filename, const char *delta_filename, FILE *output);
+
+int32_t stream_with_delta(struct stream_source *source, struct file_delta *delta, FILE *output);
+
+#endif
@@ -1,4 +1,5 @@
 #include "hamamatsu-io.h"
+#include "stats-alloc.h"
 
 struct metadata *get_metadata_hamamatsu(file_handle *fp, struct tiff_file *file) {
     // initialize metadata_attribute struct
@@ -13,7 +14,8 @@ struct metadata *get_metadata_hamamatsu(file_handle *fp, struct tiff_file *file)
             struct tiff_entry entry = dir.entries[j];
 
             // all metadata
-            static uint16_t METADATA_ATTRIBUTES[] = {TIFFTAG_DATETIME, NDPI_REFERENCE, NDPI_SCANNER_SERIAL_NUMBER};
+            static const uint16_t METADATA_ATTRIBUTES[] = {TIFFTAG_DATETIME, NDPI_REFERENCE,
+                                                           NDPI_SCANNER_SERIAL_NUMBER};
 
             // iterate through every metadata attribute
             for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
@@ -54,9 +56,30 @@ struct metadata *get_metadata_hamamatsu(file_handle *fp, struct tiff_file *file)
     return metadata_attributes;
 }
 
+struct wsi_data *get_wsi_data_hamamatsu_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename) {
+    // check for valid file extension
+    const char *ext = get_filename_ext(filename);
+    if (strcmp(ext, NDPI) != 0) {
+        return NULL;
+    }
+
+    // gets all metadata
+    if (read_remaining_tiff_directories(fp, file) != 0) {
+        return NULL;
+    }
+    struct metadata *metadata_attributes = get_metadata_hamamatsu(fp, file);
+
+    // is Hamamatsu
+    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
+    wsi_data->format = HAMAMATSU;
+    wsi_data->filename = filename;
+    wsi_data->metadata_attributes = metadata_attributes;
+    wsi_data->tiff_file = NULL;
+    return wsi_data;
+}
+
 struct wsi_data *get_wsi_data_hamamatsu(const char *filename) {
     // gets file extension
-    int32_t result = 0;
     const char *ext = get_filename_ext(filename);
 
     // check for valid file extension
@@ -65,7 +88,7 @@ struct wsi_data *get_wsi_data_hamamatsu(const char *filename) {
     }
 
     // opens file
-    file_handle *fp = file_open(filename, "rb+");
+    file_handle *fp = file_open_mapped(filename, "rb+");
 
     // checks if file was successfully opened
     if (fp == NULL) {
@@ -73,35 +96,16 @@ struct wsi_data *get_wsi_data_hamamatsu(const char *filename) {
         return NULL;
     }
 
-    // checks file details
-    bool big_tiff = false;
-    bool big_endian = false;
-    result = check_file_header(fp, &big_endian, &big_tiff);
-
-    // checks result
-    if (result != 0) {
-        return NULL;
-    }
-
     // creates tiff file structure
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, true, big_endian);
+    struct tiff_file *file = read_tiff_file_with_header(fp, true);
 
     // checks result
     if (file == NULL) {
-        fprintf(stderr, "Error: Could not read tiff file.\n");
         file_close(fp);
         return NULL;
     }
 
-    // gets all metadata
-    struct metadata *metadata_attributes = get_metadata_hamamatsu(fp, file);
-
-    // is Hamamatsu
-    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
-    wsi_data->format = HAMAMATSU;
-    wsi_data->filename = filename;
-    wsi_data->metadata_attributes = metadata_attributes;
+    struct wsi_data *wsi_data = get_wsi_data_hamamatsu_from_tiff(fp, file, filename);
 
     // cleanup
     free_tiff_file(file);
@@ -111,41 +115,36 @@ struct wsi_data *get_wsi_data_hamamatsu(const char *filename) {
 
 // retrieve the macro directory in order to wipe label image from the tiff file structure
 int32_t get_hamamatsu_macro_dir(struct tiff_file *file, file_handle *fp, bool big_endian) {
-    for (uint64_t i = 0; i < file->used; i++) {
-        struct tiff_directory temp_dir = file->directories[i];
-
-        for (uint64_t j = 0; j < temp_dir.count; j++) {
-            struct tiff_entry temp_entry = temp_dir.entries[j];
-
-            if (temp_entry.tag == NDPI_SOURCELENS) {
-                int32_t entry_size = get_size_of_value(temp_entry.type, &temp_entry.count);
-
-                if (entry_size && temp_entry.type == FLOAT) {
-                    float *v_buffer = (float *)malloc(entry_size * temp_entry.count);
-
-                    // we need to step 8 bytes from start pointer
-                    // to get the expected value
-                    uint64_t new_start = temp_entry.start + 8;
-                    if (file_seek(fp, new_start, SEEK_SET)) {
-                        fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", new_start);
-                        free(v_buffer);
-                        return -1;
-                    }
-                    if (file_read(v_buffer, entry_size, temp_entry.count, fp) != 1) {
-                        fprintf(stderr, "Error: Failed to read entry value.\n");
-                        free(v_buffer);
-                        return -1;
-                    }
-                    fix_byte_order(v_buffer, sizeof(float), 1, big_endian);
+    uint64_t num_references;
+    const struct tiff_tag_reference *references = find_tag_references(file, NDPI_SOURCELENS, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        struct tiff_entry temp_entry = *get_entry_of_reference(file, &references[k]);
+        int32_t entry_size = get_size_of_value(temp_entry.type, &temp_entry.count);
+
+        if (entry_size && temp_entry.type == FLOAT) {
+            float *v_buffer = (float *)malloc(entry_size * temp_entry.count);
+
+            // we need to step 8 bytes from start pointer
+            // to get the expected value
+            uint64_t new_start = temp_entry.start + 8;
+            if (file_seek(fp, new_start, SEEK_SET)) {
+                fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", new_start);
+                free(v_buffer);
+                return -1;
+            }
+            if (file_read(v_buffer, entry_size, temp_entry.count, fp) != 1) {
+                fprintf(stderr, "Error: Failed to read entry value.\n");
+                free(v_buffer);
+                return -1;
+            }
+            fix_byte_order(v_buffer, sizeof(float), 1, big_endian);
 
-                    // SourceLens equals -1 if macro directory containing the label image was found
-                    if (*v_buffer == -1) {
-                        free(v_buffer);
-                        return i;
-                    }
-                    free(v_buffer);
-                }
+            // SourceLens equals -1 if macro directory containing the label image was found
+            if (*v_buffer == -1) {
+                free(v_buffer);
+                return references[k].dir;
             }
+            free(v_buffer);
         }
     }
     return -1;
@@ -154,56 +153,51 @@ int32_t get_hamamatsu_macro_dir(struct tiff_file *file, file_handle *fp, bool bi
 // TODO: make use of wsi_data struct
 // removes all metadata
 int32_t remove_metadata_in_hamamatsu(file_handle *fp, struct tiff_file *file) {
-    for (uint32_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint32_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-
-            // list of all metadata that is overwritten in ndpi format
-            static uint16_t METADATA_ATTRIBUTES[] = {TIFFTAG_DATETIME, NDPI_REFERENCE, NDPI_SCANNER_SERIAL_NUMBER};
+    // list of all metadata that is overwritten in ndpi format
+    static const uint16_t METADATA_ATTRIBUTES[] = {TIFFTAG_DATETIME, NDPI_REFERENCE, NDPI_SCANNER_SERIAL_NUMBER};
+
+    // overwrite value for each metadata attribute
+    for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
+        uint64_t num_references;
+        const struct tiff_tag_reference *references =
+            find_tag_references(file, METADATA_ATTRIBUTES[i], &num_references);
+        for (uint64_t k = 0; k < num_references; k++) {
+            struct tiff_entry entry = *get_entry_of_reference(file, &references[k]);
+            int32_t entry_size = get_size_of_value(entry.type, &entry.count);
+
+            // read value for tag from file or cache
+            const char *buffer = get_tag_value(fp, file, &references[k]);
+            if (buffer == NULL) {
+                fprintf(stderr, "Error: Could not read tag %" PRIu16 ".\n", METADATA_ATTRIBUTES[i]);
+                return -1;
+            }
 
-            // overwrite value for each metadata attribute
-            for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
-                if (entry.tag == METADATA_ATTRIBUTES[i]) {
+            // set predefined value for DATETIME
+            if (entry.tag == TIFFTAG_DATETIME && strlen(buffer) == strlen(NDPI_MIN_DATETIME)) {
+                file_seek(fp, entry.offset, SEEK_SET);
+                if (file_write(NDPI_MIN_DATETIME, entry.count, entry_size, fp) != 1) {
+                    fprintf(stderr, "Error: Could not overwrite value for tag %" PRIu16 ".\n", METADATA_ATTRIBUTES[i]);
+                    return -1;
+                }
+                invalidate_tag_values(file, entry.offset, get_length_of_value(entry));
+            }
+            // other metadata
+            else {
+                // create replacement with equal amount of 0's or X's depending on the datatype
+                const char replacement_char = (entry.tag == NDPI_SCANNER_SERIAL_NUMBER) ? '0' : 'X';
+                char *replacement = create_replacement_string(replacement_char, strlen(buffer));
+
+                // if the replacement for the value is NULL, no value was found for this tag
+                if (replacement != NULL) {
                     file_seek(fp, entry.offset, SEEK_SET);
-                    int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                    // read value for tag
-                    char buffer[entry_size * entry.count];
-                    if (file_read(&buffer, entry.count, entry_size, fp) != 1) {
-                        fprintf(stderr, "Error: Could not read tag %" PRIu16 ".\n", METADATA_ATTRIBUTES[i]);
+                    if (file_write(replacement, entry.count, entry_size, fp) != 1) {
+                        fprintf(stderr, "Error: Could not overwrite value for tag %" PRIu16 ".\n",
+                                METADATA_ATTRIBUTES[i]);
+                        free(replacement);
                         return -1;
                     }
-
-                    // set predefined value for DATETIME
-                    if (entry.tag == TIFFTAG_DATETIME && strlen(buffer) == strlen(NDPI_MIN_DATETIME)) {
-                        file_seek(fp, entry.offset, SEEK_SET);
-                        if (file_write(NDPI_MIN_DATETIME, entry.count, entry_size, fp) != 1) {
-                            fprintf(stderr, "Error: Could not overwrite value for tag %" PRIu16 ".\n",
-                                    METADATA_ATTRIBUTES[i]);
-                            return -1;
-                        }
-                        break;
-                    }
-                    // other metadata
-                    else {
-                        // create replacement with equal amount of 0's or X's depending on the datatype
-                        const char replacement_char = (entry.tag == NDPI_SCANNER_SERIAL_NUMBER) ? '0' : 'X';
-                        char *replacement = create_replacement_string(replacement_char, strlen(buffer));
-
-                        // if the replacement for the value is NULL, no value was found for this tag
-                        if (replacement != NULL) {
-                            file_seek(fp, entry.offset, SEEK_SET);
-                            if (file_write(replacement, entry.count, entry_size, fp) != 1) {
-                                fprintf(stderr, "Error: Could not overwrite value for tag %" PRIu16 ".\n",
-                                        METADATA_ATTRIBUTES[i]);
-                                free(replacement);
-                                return -1;
-                            }
-                            free(replacement);
-                            break;
-                        }
-                    }
+                    invalidate_tag_values(file, entry.offset, get_length_of_value(entry));
+                    free(replacement);
                 }
             }
         }
@@ -213,43 +207,45 @@ int32_t remove_metadata_in_hamamatsu(file_handle *fp, struct tiff_file *file) {
 
 // anonymizes hamamatsu file
 int32_t handle_hamamatsu(const char **filename, const char *new_label_name, bool keep_macro_image,
-                         bool disable_unlinking, bool do_inplace) {
+                         bool disable_unlinking, bool do_inplace, struct tiff_file *file) {
 
     if (keep_macro_image) {
         fprintf(stderr, "Error: Macro image will be wiped if found.\n");
     }
 
-    fprintf(stdout, "Anonymize Hamamatsu WSI...\n");
+    fprintf(stderr, "Anonymize Hamamatsu WSI...\n");
 
     if (!do_inplace) {
         *filename = duplicate_file(*filename, new_label_name, DOT_NDPI);
     }
 
     file_handle *fp;
-    fp = file_open(*filename, "rb+");
+    fp = file_open_mapped(*filename, "rb+");
 
-    bool big_tiff = false;
-    bool big_endian = false;
-    // we check the header again, so the pointer
-    // will be placed at the expected position
-    int32_t result = check_file_header(fp, &big_endian, &big_tiff);
-    if (result != 0) {
-        fprintf(stderr, "Error: Could not read header file.\n");
-        file_close(fp);
-        return result;
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open tiff file.\n");
+        if (file != NULL) {
+            free_tiff_file(file);
+        }
+        return -1;
     }
 
-    // read the file structure
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, true, big_endian);
+    // read the file structure, unless it was already read during format detection
+    if (file == NULL) {
+        file = read_tiff_file_with_header(fp, true);
+    }
     if (file == NULL) {
         fprintf(stderr, "Error: Could not read tiff file.\n");
         file_close(fp);
         return -1;
     }
 
+    bool big_tiff = file->big_tiff;
+    bool big_endian = file->big_endian;
+
     // remove metadata
-    result = remove_metadata_in_hamamatsu(fp, file);
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_METADATA);
+    int32_t result = remove_metadata_in_hamamatsu(fp, file);
     if (result != 0) {
         free_tiff_file(file);
         file_close(fp);
@@ -257,6 +253,7 @@ int32_t handle_hamamatsu(const char **filename, const char *new_label_name, bool
     }
 
     // find the macro directory
+    stats_enter_phase(PHASE_WIPE_MACRO);
     int32_t dir_count = get_hamamatsu_macro_dir(file, fp, big_endian);
     if (dir_count == -1) {
         fprintf(stderr, "Error: No macro directory.\n");
@@ -266,6 +263,7 @@ int32_t handle_hamamatsu(const char **filename, const char *new_label_name, bool
     }
 
     // get macro dir
+    stats_record_directory(dir_count);
     struct tiff_directory dir = file->directories[dir_count];
 
     // wipe macro data from directory
@@ -280,12 +278,13 @@ int32_t handle_hamamatsu(const char **filename, const char *new_label_name, bool
     }
 
     // unlink the empty macro directory from file structure
+    stats_enter_phase(PHASE_UNLINK);
     if (!disable_unlinking) {
         result = unlink_directory(fp, file, dir_count, true);
     }
+    stats_leave_phase(phase);
 
     // clean up
-    free((void *)(*filename));
     free_tiff_file(file);
     file_close(fp);
     return result;
@@ -9,10 +9,12 @@ static const char NDPI[] = "ndpi";
 // main functions
 struct metadata *get_metadata_hamamatsu(file_handle *fp, struct tiff_file *file);
 
+struct wsi_data *get_wsi_data_hamamatsu_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename);
+
 struct wsi_data *get_wsi_data_hamamatsu(const char *filename);
 
 int32_t handle_hamamatsu(const char **filename, const char *new_label_name, bool keep_macro_image,
-                         bool disable_unlinking, bool do_inplace);
+                         bool disable_unlinking, bool do_inplace, struct tiff_file *file);
 
 // additinonal functions
 int32_t get_hamamatsu_macro_dir(struct tiff_file *file, file_handle *fp, bool big_endian);
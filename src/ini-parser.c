@@ -1,4 +1,5 @@
 #include "ini-parser.h"
+#include "stats-alloc.h"
 
 // retrieve an entry value from the ini file by
 // given group and entry key
@@ -48,8 +49,8 @@ struct ini_file *read_slidedat_ini_file(const char *path, const char *ini_filena
     // initialize line buffer
     char *buffer = (char *)malloc(MAX_CHAR_IN_LINE);
 
-    // initialize ini groups
-    struct ini_group *groups = (struct ini_group *)malloc(count_groups * sizeof(struct ini_group));
+    // initialize ini groups, the additional group marks the end of the file
+    struct ini_group *groups = (struct ini_group *)malloc((count_groups + 1) * sizeof(struct ini_group));
     int32_t line = 0, group_count = 0;
 
     while (file_gets(buffer, MAX_CHAR_IN_LINE, fp) != NULL) {
@@ -130,8 +131,8 @@ struct ini_file *read_slidedat_ini_file(const char *path, const char *ini_filena
 
 struct ini_group *remove_ini_group_from_array(struct ini_group *groups, int32_t size_of_array,
                                               int32_t index_to_remove) {
-    // new array with size one less than old array
-    struct ini_group *temp = (struct ini_group *)malloc((size_of_array - 1) * sizeof(struct ini_group));
+    // new array with size one less than old array, zeroed so that an emptied array holds no stale groups
+    struct ini_group *temp = (struct ini_group *)calloc(size_of_array - 1, sizeof(struct ini_group));
 
     // copy all elements before the index
     if (index_to_remove != 0) {
@@ -1,14 +1,16 @@
 #include "isyntax-io.h"
 #include <inttypes.h>
 
-struct metadata_attribute *get_attribute_isyntax(char *buffer, char *attribute) {
+#include "stats-alloc.h"
+
+struct metadata_attribute *get_attribute_isyntax(char *buffer, const char *attribute) {
     char *value = get_value_from_attribute(buffer, attribute);
     // check if value of attribute is not an empty string
     if (value[0] != '\0') {
         // removes '=' from key and saves it with value in struct
         struct metadata_attribute *single_attribute = malloc(sizeof(*single_attribute));
         if (contains(attribute, "=")) {
-            char *pos_of_char = strchr(attribute, '=');
+            const char *pos_of_char = strchr(attribute, '=');
             attribute = pos_of_char + 2;
         }
         single_attribute->key = strdup(attribute);
@@ -22,27 +24,39 @@ struct metadata_attribute *get_attribute_isyntax(char *buffer, char *attribute)
 
 struct metadata *get_metadata_isyntax(file_handle *fp, uint64_t header_size) {
     // all metadata
-    static char *METADATA_ATTRIBUTES[] = {PHILIPS_DATETIME_ATT, PHILIPS_SERIAL_ATT, PHILIPS_SLOT_ATT,
-                                          PHILIPS_RACK_ATT,     PHILIPS_OPERID_ATT, PHILIPS_BARCODE_ATT};
-
-    // initialize metadata_attribute struct
-    struct metadata_attribute **attributes =
-        malloc(sizeof(**attributes) * sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]));
-    int8_t metadata_id = 0;
+    static const char *METADATA_ATTRIBUTES[] = {PHILIPS_DATETIME_ATT, PHILIPS_SERIAL_ATT, PHILIPS_SLOT_ATT,
+                                                PHILIPS_RACK_ATT,     PHILIPS_OPERID_ATT, PHILIPS_BARCODE_ATT};
+    static const size_t NUM_ATTRIBUTES = sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]);
 
     // read content of XML header into buffer
-    char *buffer = malloc(header_size);
+    char *buffer = malloc(header_size + 1);
     file_seek(fp, 0, SEEK_SET);
-    if (file_read(buffer, header_size, 1, fp) != 1) {
+    if (buffer == NULL || file_read(buffer, header_size, 1, fp) != 1) {
         free(buffer);
         fprintf(stderr, "Error: Could not read XML header of iSyntax file.\n");
         return NULL;
     }
+    buffer[header_size] = '\0';
+
+    // all attributes are searched in a single pass over the header
+    struct pattern_scanner *scanner = create_pattern_scanner(METADATA_ATTRIBUTES, NUM_ATTRIBUTES);
+    if (scanner == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    const char *matches[sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0])];
+    find_patterns(scanner, buffer, header_size, matches);
+    free_pattern_scanner(scanner);
 
-    // checks for all metadata
-    for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
-        if (contains(buffer, METADATA_ATTRIBUTES[i])) {
-            struct metadata_attribute *single_attribute = get_attribute_isyntax(buffer, METADATA_ATTRIBUTES[i]);
+    // initialize metadata_attribute struct
+    struct metadata_attribute **attributes = malloc(sizeof(**attributes) * NUM_ATTRIBUTES);
+    int8_t metadata_id = 0;
+
+    // checks for all metadata, the value is read from the first occurrence of an attribute
+    for (size_t i = 0; i < NUM_ATTRIBUTES; i++) {
+        if (matches[i] != NULL) {
+            struct metadata_attribute *single_attribute =
+                get_attribute_isyntax((char *)matches[i], METADATA_ATTRIBUTES[i]);
             if (single_attribute != NULL) {
                 attributes[metadata_id++] = single_attribute;
             }
@@ -59,7 +73,6 @@ struct metadata *get_metadata_isyntax(file_handle *fp, uint64_t header_size) {
 
 struct wsi_data *get_wsi_data_isyntax(const char *filename) {
     // gets file extension
-    uint64_t result = 0;
     const char *ext = get_filename_ext(filename);
 
     // check for valid file extension
@@ -68,7 +81,7 @@ struct wsi_data *get_wsi_data_isyntax(const char *filename) {
     }
 
     // opens file
-    file_handle *fp = file_open(filename, "rb+");
+    file_handle *fp = file_open_mapped(filename, "rb+");
 
     // check if file was successfully opened
     if (fp == NULL) {
@@ -77,20 +90,18 @@ struct wsi_data *get_wsi_data_isyntax(const char *filename) {
     }
 
     // checks for ISYNTAX_ROOTNODE in order to determine if file is actually iSyntax
-    result = iteratively_get_size_of_value(fp, ISYNTAX_ROOTNODE, ISYNTAX_APPROX_HEADER_SIZE);
-
-    // checks result
-    if (result == 0) {
+    uint64_t root_node_offset;
+    if (find_value_in_file(fp, ISYNTAX_ROOTNODE, &root_node_offset) != 0) {
         fprintf(stderr, "Error: Could not find root node in iSyntax file.\n");
+        file_close(fp);
         return NULL;
     }
 
     // get header size
-    uint64_t header_size = iteratively_get_size_of_value(fp, ISYNTAX_EOT, ISYNTAX_APPROX_EOT_SIZE);
-
-    // checks result
-    if (header_size == 0) {
+    uint64_t header_size;
+    if (find_value_in_file(fp, ISYNTAX_EOT, &header_size) != 0 || header_size == 0) {
         fprintf(stderr, "Error: Unable to determine XML header size.\n");
+        file_close(fp);
         return NULL;
     }
 
@@ -102,174 +113,110 @@ struct wsi_data *get_wsi_data_isyntax(const char *filename) {
     wsi_data->format = PHILIPS_ISYNTAX;
     wsi_data->filename = filename;
     wsi_data->metadata_attributes = metadata_attributes;
+    wsi_data->tiff_file = NULL;
 
     // cleanup
     file_close(fp);
     return wsi_data;
 }
 
-// TODO: make use of get_wsi_data
-// anonymizes metadata from iSyntax file
-int32_t anonymize_isyntax_metadata(file_handle *fp, int32_t header_size) {
+// anonymizes the XML header of an iSyntax file in a single pass over its attributes. values are
+// overwritten in place with values of the same length, so only the changed bytes are written back
+int32_t anonymize_isyntax_header(file_handle *fp, uint64_t header_size, bool keep_macro_image) {
 
     // gets only XML header
     char *buffer = (char *)malloc(header_size);
 
     file_seek(fp, 0, SEEK_SET);
 
-    if (file_read(buffer, header_size, 1, fp) != 1) {
+    if (buffer == NULL || file_read(buffer, header_size, 1, fp) != 1) {
         free(buffer);
         fprintf(stderr, "Error: Could not read iSyntax file.\n");
         return -1;
     }
 
-    char *result = buffer;
-    bool rewrite = false;
+    // metadata replaced by an arbitrary value
+    static const char *METADATA_ATTRIBUTES[] = {PHILIPS_SERIAL_ATT, PHILIPS_OPERID_ATT, PHILIPS_BARCODE_ATT};
 
-    // Datetime attribute is substituted with minimum possible value
-    if (contains(result, PHILIPS_DATETIME_ATT)) {
-        char *value = get_value_from_attribute(result, PHILIPS_DATETIME_ATT);
-        char *new_result = replace_str(result, value, PHILIPS_MIN_DATETIME);
-        strcpy(result, new_result);
-        free(new_result);
-        free(value);
-        rewrite = true;
-    }
-
-    // Slot and Rack Number value in metadata is replaced by blank spaces
-    static char *METADATA_NUMBER[] = {PHILIPS_SLOT_ATT, PHILIPS_RACK_ATT};
-
-    for (size_t i = 0; i < sizeof(METADATA_NUMBER) / sizeof(METADATA_NUMBER[0]); i++) {
-        if (contains(result, METADATA_NUMBER[i])) {
-            char *new_result = wipe_section_of_attribute(result, METADATA_NUMBER[i]);
-            strcpy(result, new_result);
-            free(new_result);
-            rewrite = true;
+    struct xml_patches patches = {NULL, NULL, 0, 0};
+    struct xml_attribute attribute;
+    size_t position = 0;
+    const char *scanned = buffer;
+    bool wipe_image_data = false;
+    int32_t result = 0;
+    while (result == 0 && next_xml_attribute(buffer, header_size, &position, &attribute)) {
+        // the image type only applies to the image data of its own object
+        if (find_in_buffer(scanned, attribute.start - scanned, PHILIPS_OBJECT, strlen(PHILIPS_OBJECT)) != NULL) {
+            wipe_image_data = false;
         }
-    }
-
-    // rest of metadata
-    static char *METADATA_ATTRIBUTES[] = {PHILIPS_SERIAL_ATT, PHILIPS_OPERID_ATT, PHILIPS_BARCODE_ATT};
-
-    // checks for rest of metadata and replaces it with arbitrary value
-    for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
-        if (contains(result, METADATA_ATTRIBUTES[i])) {
-            char *new_result = anonymize_value_of_attribute(result, METADATA_ATTRIBUTES[i]);
-            strcpy(result, new_result);
-            rewrite = true;
+        scanned = attribute.value + attribute.value_length;
+
+        char *patch = attribute.value;
+        size_t patch_length = attribute.value_length;
+
+        if (has_xml_attribute_name(&attribute, PHILIPS_DATETIME_ATT)) {
+            // Datetime attribute is substituted with minimum possible value
+            size_t min_length = strlen(PHILIPS_MIN_DATETIME);
+            memset(attribute.value, '0', attribute.value_length);
+            memcpy(attribute.value, PHILIPS_MIN_DATETIME,
+                   attribute.value_length < min_length ? attribute.value_length : min_length);
+        } else if (has_xml_attribute_name(&attribute, PHILIPS_SLOT_NAME) ||
+                   has_xml_attribute_name(&attribute, PHILIPS_RACK_NAME)) {
+            // Slot and Rack Number in metadata is replaced by blank spaces
+            patch = attribute.start;
+            patch_length = attribute.length;
+            memset(patch, ' ', patch_length);
+        } else if (has_xml_attribute_name(&attribute, PHILIPS_IMAGE_TYPE)) {
+            // the image data of label and macro image follows their image type
+            wipe_image_data = has_xml_attribute_value(&attribute, PHILIPS_LABELIMAGE) ||
+                              (!keep_macro_image && has_xml_attribute_value(&attribute, PHILIPS_MACROIMAGE));
+            continue;
+        } else if (has_xml_attribute_name(&attribute, PHILIPS_IMAGE_DATA) && wipe_image_data) {
+            wipe_image_data_of_attribute(&attribute);
+            wipe_image_data = false;
+        } else {
+            bool found = false;
+            for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]) && !found; i++) {
+                found = has_xml_attribute_name(&attribute, METADATA_ATTRIBUTES[i]);
+            }
+            if (!found) {
+                continue;
+            }
+            memset(attribute.value, 'X', attribute.value_length);
         }
+        result = add_xml_patch(&patches, patch - buffer, patch_length);
     }
 
     // alters iSyntax file
-    if (rewrite) {
-        strcpy(buffer, result);
-        file_seek(fp, 0, SEEK_SET);
-        if (!file_write(buffer, header_size, 1, fp)) {
-            fprintf(stderr, "Error: Changing XML Header failed.\n");
-            free(buffer);
-            return -1;
-        }
-    }
-
-    free(buffer);
-    return 1;
-}
-
-// remove label image and macro image
-int32_t wipe_isyntax_image_data(file_handle *fp, size_t header_size, char *image_type) {
-
-    // gets only the xml header
-    char *buffer = (char *)malloc(header_size);
-
-    file_seek(fp, 0, SEEK_SET);
-
-    if (file_read(buffer, header_size, 1, fp) != 1) {
-        fprintf(stderr, "Error: Could not read iSyntax file.\n");
-        return -1;
-    }
-
-    // handle bigger overhead when using malloc in WASM
-    if (strlen(buffer) > header_size) {
-        buffer[header_size - 1] = '\0';
+    if (result == 0 && patches.count > 0) {
+        result = write_xml_patches(fp, 0, buffer, &patches);
     }
 
-    char *result = buffer;
-    bool rewrite = false;
-
-    if (contains(result, image_type)) {
-
-        // get image data string
-        char *rough_image_data = get_string_between_delimiters(result, image_type, PHILIPS_OBJECT);
-        char *refined_image_data = get_string_between_delimiters(rough_image_data, PHILIPS_IMAGE_DATA, ISYNTAX_DATA);
-        const char *concatenated_str = concat_str(PHILIPS_DELIMITER_STR, PHILIPS_CLOSING_SYMBOL);
-        char *image_data = get_string_between_delimiters(refined_image_data, concatenated_str, PHILIPS_ATT_END);
-
-        // set height and width to 1
-        int32_t height = 1;
-        int32_t width = 1;
-
-        // alloc with height and width and fill with 255 for a white image
-        unsigned char *white_image = (unsigned char *)malloc((height * width) * sizeof(unsigned char));
-        memset(white_image, 255, height * width);
-
-        // create white jpg image
-        jpec_enc_t *e = jpec_enc_new(white_image, width, height);
-        int32_t len;
-        const uint8_t *jpeg = jpec_enc_run(e, &len);
-
-        // encode new image data and check if string is longer than original string, replace old
-        // base64-encoded string afterwards
-        char *new_image_data = (char *)b64_encode(jpeg, len);
-        if (strlen(new_image_data) > strlen(image_data)) {
-            new_image_data[strlen(image_data)] = '\0';
-        }
-
-        char *new_result = replace_str(result, image_data, new_image_data);
-        strcpy(result, new_result);
-        rewrite = true;
-
-        // free all memory
-        free(rough_image_data);
-        free(refined_image_data);
-        free((char *)concatenated_str);
-        free(image_data);
-        free(white_image);
-        jpec_enc_del(e);
-        free(new_image_data);
-        free(new_result);
-    }
-
-    // alter XML header
-    if (rewrite) {
-        strcpy(buffer, result);
-        file_seek(fp, 0, SEEK_SET);
-        if (!file_write(buffer, header_size, 1, fp)) {
-            fprintf(stderr, "Error: changing XML Header failed.\n");
-            result = NULL;
-            free(buffer);
-            return -1;
-        }
-    }
-    result = NULL;
+    free_xml_patches(&patches);
     free(buffer);
-    return 0;
+    return result;
 }
 
 // anonymize iSyntax file
 int32_t handle_isyntax(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                       bool do_inplace) {
+                       bool do_inplace, struct tiff_file *file) {
+
+    // isyntax is not tiff based, a file structure is never read during format detection
+    if (file != NULL) {
+        free_tiff_file(file);
+    }
 
     if (disable_unlinking) {
         fprintf(stderr, "Error: Cannot disable unlinking in iSyntax file.\n");
     }
 
-    fprintf(stdout, "Anonymize iSyntax WSI...\n");
+    fprintf(stderr, "Anonymize iSyntax WSI...\n");
 
     if (!do_inplace) {
         *filename = duplicate_file(*filename, new_label_name, DOT_ISYNTAX);
     }
 
-    file_handle *fp = file_open(*filename, "rb+");
+    file_handle *fp = file_open_mapped(*filename, "rb+");
 
     // if file could not be opened
     if (fp == NULL) {
@@ -277,30 +224,26 @@ int32_t handle_isyntax(const char **filename, const char *new_label_name, bool k
         return -1;
     }
 
-    uint64_t header_size = iteratively_get_size_of_value(fp, ISYNTAX_EOT, ISYNTAX_APPROX_EOT_SIZE);
-
-    // remove label image
-    int32_t result = wipe_isyntax_image_data(fp, header_size, PHILIPS_LABELIMAGE);
-
-    if (result == -1) {
-        fprintf(stderr, "Error: Could not wipe label image from file.\n");
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_PARSE);
+    uint64_t header_size;
+    if (find_value_in_file(fp, ISYNTAX_EOT, &header_size) != 0 || header_size == 0) {
+        fprintf(stderr, "Error: Unable to determine XML header size.\n");
+        stats_leave_phase(phase);
         file_close(fp);
-        return result;
+        return -1;
     }
 
-    // remove macro image
-    if (!keep_macro_image) {
-        result = wipe_isyntax_image_data(fp, header_size, PHILIPS_MACROIMAGE);
+    // remove label image, macro image and metadata, all of them are
+    // removed in a single pass over the header counted as metadata
+    stats_enter_phase(PHASE_METADATA);
+    int32_t result = anonymize_isyntax_header(fp, header_size, keep_macro_image);
+    stats_leave_phase(phase);
 
-        if (result == -1) {
-            fprintf(stderr, "Error: Could not wipe macro image from file.\n");
-        }
+    if (result == -1) {
+        fprintf(stderr, "Error: Could not anonymize XML header of iSyntax file.\n");
     }
 
-    anonymize_isyntax_metadata(fp, header_size);
-
     // clean up
-    free((char *)(*filename));
     file_close(fp);
     return result;
 }
\ No newline at end of file
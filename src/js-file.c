@@ -1,15 +1,20 @@
 #include "file-api.h"
+#include "stats.h"
 
 #include <emscripten.h>
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "stats-alloc.h"
+
 struct file_s {
     char *filename;
     char *mode;
     int64_t offset;
     int64_t size;
+    // set if a request submitted since the last reap did not transfer its full length
+    bool failed_requests;
 };
 
 EM_ASYNC_JS(size_t, get_chunk, (void *buffer, size_t size, const char *filename, int64_t offset), {
@@ -52,6 +57,7 @@ file_handle *file_open(const char *filename, const char *mode) {
     if (file_present_in_form(filename)) {
         stream = (file_handle *)malloc(sizeof(file_handle));
         stream->offset = 0;
+        stream->failed_requests = false;
         stream->filename = (char *)malloc(strlen(filename) + 1);
         stream->mode = (char *)malloc(strlen(mode) + 1);
         strcpy(stream->filename, filename);
@@ -67,12 +73,17 @@ file_handle *file_open(const char *filename, const char *mode) {
     return stream;
 }
 
+file_handle *file_open_mapped(const char *filename, const char *mode) { return file_open(filename, mode); }
+
+int32_t file_use_io_uring(bool enabled) { return enabled ? -1 : 0; }
+
 size_t file_read(void *buffer, size_t element_size, size_t element_count, file_handle *stream) {
     // check if size that is read at once does not exceed limit for array
     size_t size = element_size * element_count;
     if (size < INT_MAX) {
         uint32_t bytes_read = get_chunk(buffer, size, stream->filename, stream->offset);
         stream->offset += bytes_read * element_count;
+        stats_count_read(size);
         return element_count;
     }
     return 0;
@@ -97,6 +108,7 @@ char *file_gets(char *buffer, int32_t max_count, file_handle *stream) {
         *(nl + 1) = '\0';
         stream->offset = stream->offset + (nl - buffer) + 1;
     }
+    stats_count_read(strlen(buffer));
     return buffer;
 }
 
@@ -107,10 +119,12 @@ int32_t file_getc(file_handle *stream) {
     }
     get_chunk(&c, 1, stream->filename, stream->offset);
     stream->offset += 1;
+    stats_count_read(1);
     return c;
 }
 
 int64_t file_seek(file_handle *stream, int64_t offset, int32_t origin) {
+    stats_count_seek();
     uint64_t new_offset = 0;
     if (origin == SEEK_SET) {
         new_offset = offset;
@@ -130,6 +144,7 @@ int64_t file_seek(file_handle *stream, int64_t offset, int32_t origin) {
 size_t file_write(const void *buffer, size_t size, size_t count, file_handle *stream) {
     // TODO: if file not writable, return 0 immediately
     set_chunk(buffer, size * count, stream->filename, stream->offset);
+    stats_count_write(size * count);
     // TODO: how many bytes were really written -> adapt offset accordingly
     stream->offset += (size * count);
     // TODO: check under which conditions offset is updated for writing (could
@@ -141,6 +156,7 @@ int32_t file_putc(int32_t character, file_handle *stream) {
     // TODO: if file not writable, return 0 immediately
     char c = (char)character; // to be sure to avoid endianess problems
     set_chunk(&c, 1, stream->filename, stream->offset);
+    stats_count_write(1);
     // TODO: check offset update conditions (see comment in file_write)
     stream->offset += 1;
     // TODO: handle failures
@@ -152,6 +168,7 @@ int32_t file_printf(file_handle *stream, const char *format, const char *value)
     char *buffer = (char *)malloc(buffer_size + 1);
     sprintf(buffer, format, value);
     set_chunk(buffer, buffer_size, stream->filename, stream->offset);
+    stats_count_write(buffer_size);
     free(buffer);
     stream->offset += buffer_size;
     // TODO: handle edge cases (partial writes, errors, etc.)
@@ -160,6 +177,53 @@ int32_t file_printf(file_handle *stream, const char *format, const char *value)
 
 uint64_t file_tell(file_handle *stream) { return stream->offset; }
 
+int32_t file_submit_requests(file_handle *stream, struct file_io_request *requests, size_t count) {
+    // chunks are requested one after another from the anonymized stream, so the
+    // requests are already completed when they are reaped
+    for (size_t i = 0; i < count; i++) {
+        struct file_io_request *request = &requests[i];
+        if (request->length >= INT_MAX) {
+            request->result = 0;
+            stream->failed_requests = true;
+        } else if (request->write) {
+            set_chunk(request->buffer, request->length, stream->filename, request->offset);
+            request->result = request->length;
+            stats_count_write(request->result);
+        } else {
+            request->result = get_chunk(request->buffer, request->length, stream->filename, request->offset);
+            stats_count_read(request->result);
+            if (request->result != request->length) {
+                stream->failed_requests = true;
+            }
+        }
+    }
+    return 0;
+}
+
+int32_t file_reap_requests(file_handle *stream) {
+    int32_t result = stream->failed_requests ? -1 : 0;
+    stream->failed_requests = false;
+    return result;
+}
+
+int32_t file_submit_batch(file_handle *stream, struct file_io_request *requests, size_t count) {
+    file_submit_requests(stream, requests, count);
+    return file_reap_requests(stream);
+}
+
+int32_t file_start_delta_recording(const char *filename, struct file_delta *delta) {
+    // changes are already kept separately by the anonymized stream
+    fprintf(stderr, "Error: Delta recording is not supported for %s.\n", filename);
+    return -1;
+}
+
+int32_t file_start_stream_recording(const char *filename, struct stream_source *source, struct file_delta *delta) {
+    fprintf(stderr, "Error: Streaming is not supported for %s.\n", filename);
+    return -1;
+}
+
+void file_stop_delta_recording() {}
+
 int32_t file_close(file_handle *stream) {
     free(stream->mode);
     free(stream->filename);
@@ -1,4 +1,5 @@
 #include "mirax-io.h"
+#include "stats-alloc.h"
 
 static const char MRXS_EXT[] = "mrxs";
 static const char DOT_MRXS_EXT[] = ".mrxs";
@@ -183,6 +184,7 @@ struct wsi_data *get_wsi_data_mirax(const char *filename) {
     wsi_data->format = MIRAX;
     wsi_data->filename = filename;
     wsi_data->metadata_attributes = metadata_attributes;
+    wsi_data->tiff_file = NULL;
 
     // cleanup
     free(path);
@@ -253,10 +255,9 @@ struct mirax_file *get_mirax_file_structure(struct ini_file *ini, int32_t l_coun
 
 // retrive mirax level from file structure by
 // layer and level name
-struct mirax_level *get_level_by_name(struct mirax_layer **layers, const char *layer_name, const char *level_name) {
-    int32_t length = sizeof(**layers) / sizeof(layers[0]);
-    for (int32_t i = 0; i < length; i++) {
-        struct mirax_layer *layer = layers[i];
+struct mirax_level *get_level_by_name(struct mirax_file *mirax_file, const char *layer_name, const char *level_name) {
+    for (int32_t i = 0; i < mirax_file->count_layers; i++) {
+        struct mirax_layer *layer = mirax_file->layers[i];
         // printf("layer name %s\n", layer->layer_name);
         if (strcmp(layer->layer_name, layer_name) == 0) {
             for (int32_t j = 0; j < layer->level_count; j++) {
@@ -359,20 +360,23 @@ int32_t wipe_level_data(const char *filename, int32_t **offset, int32_t **length
     }
 
     // write empty jpeg image to file
-    char *empty_buffer = create_pre_suffixed_char_array('0', **length, prefix, suffix);
+    size_t buffer_size;
+    char *fill_buffer = create_fill_buffer('0', **length, &buffer_size);
     file_seek(fp, **offset, SEEK_SET);
-    file_write(empty_buffer, **length, 1, fp);
+    if (fill_buffer != NULL) {
+        write_wiped_data(fp, fill_buffer, buffer_size, **length, prefix, suffix);
+    }
 
-    free(empty_buffer);
+    free(fill_buffer);
     free(buffer);
     file_close(fp);
     return 0;
 }
 
 // remove label level
-int32_t delete_level(const char *path, const char *index_file, const char **data_files, struct mirax_layer **layers,
+int32_t delete_level(const char *path, const char *index_file, const char **data_files, struct mirax_file *mirax_file,
                      const char *layer_name, const char *level_name) {
-    struct mirax_level *level_to_delete = get_level_by_name(layers, layer_name, level_name);
+    struct mirax_level *level_to_delete = get_level_by_name(mirax_file, layer_name, level_name);
 
     if (level_to_delete == NULL) {
         fprintf(stderr, "Warning: Could not find expected level with name %s. Unable to delete non-existing level.\n",
@@ -684,7 +688,7 @@ int32_t wipe_data_in_index_file(const char *path, const char *index_filename, st
 int32_t wipe_delete_unlink(const char *path, struct ini_file *ini, const char *index_filename,
                            struct mirax_file *mirax_file, const char *layer, const char *level_to_delete) {
 
-    struct mirax_level *level = get_level_by_name(mirax_file->layers, layer, level_to_delete);
+    struct mirax_level *level = get_level_by_name(mirax_file, layer, level_to_delete);
 
     if (level != NULL) {
         if (wipe_data_in_index_file(path, index_filename, level, mirax_file) != 0) {
@@ -710,8 +714,13 @@ char *strndup(const char *s1, size_t n) {
 }
 
 int32_t handle_mirax(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                     bool do_inplace) {
-    fprintf(stdout, "Anonymize Mirax WSI...\n");
+                     bool do_inplace, struct tiff_file *file) {
+    fprintf(stderr, "Anonymize Mirax WSI...\n");
+
+    // mirax is not tiff based, a file structure is never read during format detection
+    if (file != NULL) {
+        free_tiff_file(file);
+    }
 
     const char *path = strndup(*filename, strlen(*filename) - strlen(DOT_MRXS_EXT));
 
@@ -753,8 +762,9 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
 
     // wipe the image data in the data file
     // slide label
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_WIPE_LABEL);
     int32_t result =
-        delete_level(path, index_filename, data_filenames, mirax_file->layers, SCAN_DATA_LAYER, SLIDE_BARCODE);
+        delete_level(path, index_filename, data_filenames, mirax_file, SCAN_DATA_LAYER, SLIDE_BARCODE);
 
     // check for result
     if (result == -1) {
@@ -763,9 +773,10 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
     }
 
     // delete macro image
+    stats_enter_phase(PHASE_WIPE_MACRO);
     if (!keep_macro_image) {
         result =
-            delete_level(path, index_filename, data_filenames, mirax_file->layers, SCAN_DATA_LAYER, SLIDE_THUMBNAIL);
+            delete_level(path, index_filename, data_filenames, mirax_file, SCAN_DATA_LAYER, SLIDE_THUMBNAIL);
 
         // check for result
         if (result == -1) {
@@ -775,7 +786,7 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
     }
 
     // delete whole slide image
-    result = delete_level(path, index_filename, data_filenames, mirax_file->layers, SCAN_DATA_LAYER, SLIDE_WSI);
+    result = delete_level(path, index_filename, data_filenames, mirax_file, SCAN_DATA_LAYER, SLIDE_WSI);
 
     // check for result
     if (result == -1) {
@@ -784,18 +795,19 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
     }
 
     // unlink directory
+    stats_enter_phase(PHASE_UNLINK);
     if (!disable_unlinking) {
         // THIS IS A QUICKFIX!
         // The order of label/macro images etc. actually matters in the file structure of the
         // Slidedat.ini
         // TODO: investigate why the barcode/wsi level is not removed when order in Slidedat.ini is
         // different
-        struct mirax_level *barcode_layer = get_level_by_name(mirax_file->layers, SCAN_DATA_LAYER, SLIDE_BARCODE);
+        struct mirax_level *barcode_layer = get_level_by_name(mirax_file, SCAN_DATA_LAYER, SLIDE_BARCODE);
         int32_t barcode_group_index = -1;
         if (barcode_layer != NULL) {
             barcode_group_index = get_group_index_of_ini_file(ini, barcode_layer->section);
         }
-        struct mirax_level *wsi_layer = get_level_by_name(mirax_file->layers, SCAN_DATA_LAYER, SLIDE_WSI);
+        struct mirax_level *wsi_layer = get_level_by_name(mirax_file, SCAN_DATA_LAYER, SLIDE_WSI);
         int32_t wsi_group_index = -1;
         if (wsi_layer != NULL) {
             wsi_group_index = get_group_index_of_ini_file(ini, wsi_layer->section);
@@ -818,7 +830,8 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
     }
 
     // remove metadata in slidedata ini
-    printf("Removing metadata in Slidedat.ini...\n");
+    stats_enter_phase(PHASE_METADATA);
+    fprintf(stderr, "Removing metadata in Slidedat.ini...\n");
     anonymize_value_for_group_and_key(ini, GENERAL, SLIDE_NAME, 'X');
     anonymize_value_for_group_and_key(ini, GENERAL, PROJECT_NAME, 'X');
     anonymize_value_for_group_and_key(ini, GENERAL, SLIDE_UTC_CREATIONDATETIME, 'X');
@@ -843,6 +856,7 @@ int32_t handle_mirax(const char **filename, const char *new_label_name, bool kee
     if (write_ini_file(ini, path, SLIDEDAT) == -1) {
         return -1;
     }
+    stats_leave_phase(phase);
 
     free(data_filenames);
     free(mirax_file);
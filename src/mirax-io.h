@@ -15,21 +15,21 @@ struct metadata *get_metadata_mirax(const char *path, struct ini_file *ini_file,
 struct wsi_data *get_wsi_data_mirax(const char *filename);
 
 int32_t handle_mirax(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                     bool do_inplace);
+                     bool do_inplace, struct tiff_file *file);
 
 // additional functions
 void free_slidedata_ini_file(struct ini_file *ini);
 
 struct mirax_file *get_mirax_file_structure(struct ini_file *ini, int32_t l_count);
 
-struct mirax_level *get_level_by_name(struct mirax_layer **layers, const char *layer_name, const char *level_name);
+struct mirax_level *get_level_by_name(struct mirax_file *mirax_file, const char *layer_name, const char *level_name);
 
 int32_t *read_data_location(const char *filename, int32_t record, int32_t **position, int32_t **size);
 
 int32_t wipe_level_data(const char *filename, int32_t **offset, int32_t **length, const char *prefix,
                         const char *suffix);
 
-int32_t delete_level(const char *path, const char *index_file, const char **data_files, struct mirax_layer **layers,
+int32_t delete_level(const char *path, const char *index_file, const char **data_files, struct mirax_file *mirax_file,
                      const char *layer_name, const char *level_name);
 
 int32_t delete_record_from_index_file(const char *filename, int32_t record, int32_t all_records);
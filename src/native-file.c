@@ -1,73 +1,883 @@
 #include "file-api.h"
+#include "file-delta.h"
+#include "stats.h"
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HAS_MMAP
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAS_IO_URING
+// maximum number of requests in flight at once per handle
+#define IO_URING_ENTRIES 64
+// largest transfer of a single submission, the rest of a request is transferred synchronously
+#define IO_URING_MAX_LENGTH (1u << 30)
+#endif
+#endif
+#endif
+
+#include "stats-alloc.h"
+
+struct io_ring;
 
 struct file_s {
     FILE *fp;
+    // memory-mapped backend, only used if map is not NULL
+    uint8_t *map;
+    uint64_t map_size;
+    uint64_t size;
+    uint64_t offset;
+    int32_t fd;
+    // writes are recorded into the delta instead of the file, if set
+    struct file_delta *delta;
+    // original bytes are read from the lookahead of a streamed input instead of the file, if set
+    struct stream_source *source;
+    // requests submitted by file_submit_requests that are not reaped yet,
+    // the first queued of them are already passed to the ring
+    struct file_io_request **pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    size_t queued;
+    // ring of the io_uring backend, set up by the first submission and reused until the handle is closed
+    struct io_ring *ring;
+    bool ring_failed;
 };
 
+// files opened by file_open_mapped are read and written with io_uring instead of a mapping, if set
+static bool io_uring_enabled = false;
+
+// file whose writes are currently recorded into a delta by this thread
+static _Thread_local const char *recorded_filename = NULL;
+static _Thread_local struct file_delta *recorded_delta = NULL;
+static _Thread_local struct stream_source *recorded_source = NULL;
+
+static int64_t raw_seek(FILE *fp, int64_t offset, int32_t origin) {
+#ifdef __linux__
+    return fseeko(fp, offset, origin);
+#elif defined(__APPLE__) && defined(__MACH__)
+    return fseeko(fp, offset, origin);
+#elif _WIN32
+    return _fseeki64(fp, offset, origin);
+#elif _WIN64
+    return _fseeki64(fp, offset, origin);
+#else
+    return -1;
+#endif
+}
+
+static uint64_t raw_tell(FILE *fp) {
+#ifdef __linux__
+    return ftello(fp);
+#elif defined(__APPLE__) && defined(__MACH__)
+    return ftello(fp);
+#elif _WIN32
+    return _ftelli64(fp);
+#elif _WIN64
+    return _ftelli64(fp);
+#else
+    return -1;
+#endif
+}
+
+static size_t min_size(size_t a, uint64_t b) { return a < b ? a : (size_t)b; }
+
+// the stream position is tracked by the handle for mapped files, files on
+// the io_uring backend and recorded deltas
+static bool has_own_offset(file_handle *stream) { return stream->fd >= 0 || stream->delta != NULL; }
+
+static file_handle *create_handle() {
+    file_handle *stream = (file_handle *)malloc(sizeof(file_handle));
+    if (stream != NULL) {
+        memset(stream, 0, sizeof(file_handle));
+        stream->fd = -1;
+    }
+    return stream;
+}
+
+#ifdef HAS_MMAP
+// copy bytes at the current offset from the mapping, bytes beyond the mapping (e.g. appended
+// after opening, or all bytes of files on the io_uring backend) are read from the descriptor
+static size_t mapped_read(void *buffer, size_t size, file_handle *stream) {
+    size_t done = 0;
+    if (stream->offset < stream->map_size) {
+        done = min_size(size, stream->map_size - stream->offset);
+        memcpy(buffer, stream->map + stream->offset, done);
+    }
+    if (done < size && stream->offset + done < stream->size) {
+        ssize_t result = pread(stream->fd, (uint8_t *)buffer + done, size - done, stream->offset + done);
+        if (result > 0) {
+            done += result;
+        }
+    }
+    stream->offset += done;
+    return done;
+}
+
+static size_t mapped_write(const void *buffer, size_t size, file_handle *stream) {
+    size_t done = 0;
+    if (stream->offset < stream->map_size) {
+        done = min_size(size, stream->map_size - stream->offset);
+        memcpy(stream->map + stream->offset, buffer, done);
+    }
+    if (done < size) {
+        ssize_t result = pwrite(stream->fd, (const uint8_t *)buffer + done, size - done, stream->offset + done);
+        if (result > 0) {
+            done += result;
+        }
+    }
+    stream->offset += done;
+    if (stream->offset > stream->size) {
+        stream->size = stream->offset;
+    }
+    return done;
+}
+#endif
+
+// read the input into the lookahead buffer until it reaches the given end offset or the
+// limit of the lookahead. once the whole input is read, the size of the file is known
+static void fill_lookahead(file_handle *stream, uint64_t end) {
+    struct stream_source *source = stream->source;
+    while (source->size < end && !source->eof) {
+        if (source->size == source->capacity) {
+            if (source->capacity == source->limit) {
+                if (!source->exceeded) {
+                    fprintf(stderr, "Error: File structure exceeds the lookahead of %" PRIu64 " bytes.\n",
+                            source->limit);
+                }
+                source->exceeded = true;
+                return;
+            }
+            uint64_t capacity = source->capacity == 0 ? COPY_CHUNK_SIZE : source->capacity * 2;
+            capacity = capacity < source->limit ? capacity : source->limit;
+            uint8_t *buffer = (uint8_t *)realloc(source->buffer, capacity);
+            if (buffer == NULL) {
+                fprintf(stderr, "Error: Could not allocate memory for lookahead.\n");
+                return;
+            }
+            source->buffer = buffer;
+            source->capacity = capacity;
+        }
+        size_t chunk_size = min_size(COPY_CHUNK_SIZE, source->capacity - source->size);
+        size_t bytes_read = fread(source->buffer + source->size, 1, chunk_size, source->input);
+        source->size += bytes_read;
+        if (bytes_read < chunk_size) {
+            if (ferror(source->input)) {
+                fprintf(stderr, "Error: Could not read input.\n");
+            }
+            source->eof = true;
+        }
+    }
+    if (source->eof) {
+        stream->size = source->size;
+        stream->delta->original_size = source->size;
+    }
+}
+
+// read bytes of the original file at a given offset
+static size_t read_original_at(file_handle *stream, void *buffer, size_t size, uint64_t offset) {
+    if (offset >= stream->size) {
+        return 0;
+    }
+    size = min_size(size, stream->size - offset);
+    if (stream->source != NULL) {
+        fill_lookahead(stream, offset + size);
+        if (offset >= stream->source->size) {
+            return 0;
+        }
+        size = min_size(size, stream->source->size - offset);
+        memcpy(buffer, stream->source->buffer + offset, size);
+        return size;
+    }
+#ifdef HAS_MMAP
+    if (stream->fd >= 0) {
+        uint64_t current_offset = stream->offset;
+        stream->offset = offset;
+        size_t bytes_read = mapped_read(buffer, size, stream);
+        stream->offset = current_offset;
+        return bytes_read;
+    }
+#endif
+    if (raw_seek(stream->fp, offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    return fread(buffer, 1, size, stream->fp);
+}
+
+// read bytes at the current offset with the recorded patches applied
+static size_t delta_read(void *buffer, size_t size, file_handle *stream) {
+    uint64_t file_size = get_size_of_delta_file(stream->delta);
+    if (stream->offset >= file_size) {
+        return 0;
+    }
+    size = min_size(size, file_size - stream->offset);
+    size_t bytes_read = read_original_at(stream, buffer, size, stream->offset);
+    if (stream->source != NULL) {
+        // the size of a streamed file is known once the input is read to its end,
+        // until then bytes beyond the lookahead are not available
+        file_size = get_size_of_delta_file(stream->delta);
+        if (!stream->source->eof) {
+            size = bytes_read;
+        } else if (stream->offset + size > file_size) {
+            size = stream->offset < file_size ? file_size - stream->offset : 0;
+        }
+    }
+    memset((uint8_t *)buffer + bytes_read, 0, size - bytes_read);
+    apply_delta_to_buffer(stream->delta, stream->offset, buffer, size);
+    stream->offset += size;
+    return size;
+}
+
+static size_t delta_write(const void *buffer, size_t size, file_handle *stream) {
+    if (add_patch_to_delta(stream->delta, stream->offset, buffer, size) != 0) {
+        return 0;
+    }
+    stream->offset += size;
+    return size;
+}
+
+// read from the handle that tracks its own offset
+static size_t own_offset_read(void *buffer, size_t size, file_handle *stream) {
+    if (stream->delta != NULL) {
+        return delta_read(buffer, size, stream);
+    }
+#ifdef HAS_MMAP
+    return mapped_read(buffer, size, stream);
+#else
+    return 0;
+#endif
+}
+
+static size_t own_offset_write(const void *buffer, size_t size, file_handle *stream) {
+    if (stream->delta != NULL) {
+        return delta_write(buffer, size, stream);
+    }
+#ifdef HAS_MMAP
+    return mapped_write(buffer, size, stream);
+#else
+    return 0;
+#endif
+}
+
+int32_t file_start_delta_recording(const char *filename, struct file_delta *delta) {
+    if (recorded_filename != NULL) {
+        fprintf(stderr, "Error: Already recording a delta.\n");
+        return -1;
+    }
+    recorded_filename = filename;
+    recorded_delta = delta;
+    return 0;
+}
+
+int32_t file_start_stream_recording(const char *filename, struct stream_source *source, struct file_delta *delta) {
+    if (file_start_delta_recording(filename, delta) != 0) {
+        return -1;
+    }
+    recorded_source = source;
+    return 0;
+}
+
+void file_stop_delta_recording() {
+    recorded_filename = NULL;
+    recorded_delta = NULL;
+    recorded_source = NULL;
+}
+
+static bool is_recorded(const char *filename) {
+    return recorded_filename != NULL && strcmp(filename, recorded_filename) == 0;
+}
+
+static file_handle *open_recorded_file(const char *filename);
+
 file_handle *file_open(const char *filename, const char *mode) {
+    if (is_recorded(filename)) {
+        return open_recorded_file(filename);
+    }
+
     file_handle *stream = NULL;
 
     FILE *fp = fopen(filename, mode);
 
     if (fp != NULL) {
-        stream = (file_handle *)malloc(sizeof(file_handle));
+        stream = create_handle();
         stream->fp = fp;
     }
 
     return stream;
 }
 
+file_handle *file_open_mapped(const char *filename, const char *mode) {
+    if (is_recorded(filename)) {
+        return open_recorded_file(filename);
+    }
+#ifdef HAS_MMAP
+    // only existing files are mapped, creating or truncating
+    // modes are served by the stdio backend
+    if (strchr(mode, 'r') == NULL) {
+        return file_open(filename, mode);
+    }
+    bool writable = strchr(mode, '+') != NULL;
+
+    int32_t fd = open(filename, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return file_open(filename, mode);
+    }
+
+    file_handle *stream = create_handle();
+    stream->size = st.st_size;
+    stream->fd = fd;
+
+#ifdef HAS_IO_URING
+    // files on the io_uring backend are accessed with positioned reads and writes only
+    if (io_uring_enabled) {
+        return stream;
+    }
+#endif
+
+    int32_t prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *map = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        // fall back to stdio, e.g. for files on filesystems without mmap support
+        close(fd);
+        free(stream);
+        return file_open(filename, mode);
+    }
+
+    stream->map = (uint8_t *)map;
+    stream->map_size = st.st_size;
+    return stream;
+#else
+    return file_open(filename, mode);
+#endif
+}
+
+// open a handle on the lookahead of the streamed input, its size is unknown
+// until the end of the input is read
+static file_handle *open_recorded_stream() {
+    file_handle *stream = create_handle();
+    stream->size = recorded_source->eof ? recorded_source->size : UINT64_MAX;
+    stream->delta = recorded_delta;
+    stream->source = recorded_source;
+    stream->delta->original_size = stream->size;
+    return stream;
+}
+
+// open the original file read-only and attach the recorded delta
+static file_handle *open_recorded_file(const char *filename) {
+    if (recorded_source != NULL) {
+        return open_recorded_stream();
+    }
+    const char *current_filename = recorded_filename;
+    recorded_filename = NULL;
+    file_handle *stream = file_open_mapped(filename, "rb");
+    recorded_filename = current_filename;
+
+    if (stream == NULL) {
+        return NULL;
+    }
+    if (stream->fp != NULL) {
+        raw_seek(stream->fp, 0, SEEK_END);
+        stream->size = raw_tell(stream->fp);
+        stream->offset = 0;
+    }
+    stream->delta = recorded_delta;
+    stream->delta->original_size = stream->size;
+    return stream;
+}
+
 size_t file_read(void *buffer, size_t element_size, size_t element_count, file_handle *stream) {
-    return fread(buffer, element_size, element_count, stream->fp);
+    size_t elements_read = 0;
+    if (!has_own_offset(stream)) {
+        elements_read = fread(buffer, element_size, element_count, stream->fp);
+    } else if (element_size != 0) {
+        // like fread, only whole elements are reported as read
+        elements_read = own_offset_read(buffer, element_size * element_count, stream) / element_size;
+    }
+    stats_count_read(elements_read * element_size);
+    return elements_read;
 }
 
-char *file_gets(char *buffer, int32_t max_count, file_handle *stream) { return fgets(buffer, max_count, stream->fp); }
+static int32_t read_char(file_handle *stream) {
+    if (has_own_offset(stream)) {
+#ifdef HAS_MMAP
+        if (stream->delta == NULL && stream->offset < stream->map_size) {
+            return stream->map[stream->offset++];
+        }
+#endif
+        uint8_t c;
+        return own_offset_read(&c, 1, stream) == 1 ? c : EOF;
+    }
+    return fgetc(stream->fp);
+}
 
-int32_t file_getc(file_handle *stream) { return fgetc(stream->fp); }
+static char *read_line(char *buffer, int32_t max_count, file_handle *stream) {
+    if (has_own_offset(stream)) {
+        if (max_count <= 0) {
+            return NULL;
+        }
+        int32_t i = 0;
+        while (i < max_count - 1) {
+            int32_t c = read_char(stream);
+            if (c == EOF) {
+                break;
+            }
+            buffer[i++] = (char)c;
+            if (c == '\n') {
+                break;
+            }
+        }
+        if (i == 0 && max_count > 1) {
+            return NULL;
+        }
+        buffer[i] = '\0';
+        return buffer;
+    }
+    return fgets(buffer, max_count, stream->fp);
+}
+
+char *file_gets(char *buffer, int32_t max_count, file_handle *stream) {
+    char *line = read_line(buffer, max_count, stream);
+    stats_count_read(line != NULL ? strlen(line) : 0);
+    return line;
+}
+
+int32_t file_getc(file_handle *stream) {
+    int32_t c = read_char(stream);
+    stats_count_read(c != EOF ? 1 : 0);
+    return c;
+}
 
 int64_t file_seek(file_handle *stream, int64_t offset, int32_t origin) {
-#ifdef __linux__
-    return fseeko(stream->fp, offset, origin);
-#elif defined(__APPLE__) && defined(__MACH__)
-    return fseeko(stream->fp, offset, origin);
-#elif _WIN32
-    return _fseeki64(stream->fp, offset, origin);
-#elif _WIN64
-    return _fseeki64(stream->fp, offset, origin);
-#else
-    return -1;
-#endif
+    stats_count_seek();
+    if (has_own_offset(stream)) {
+        int64_t new_offset = offset;
+        if (origin == SEEK_CUR) {
+            new_offset += stream->offset;
+        } else if (origin == SEEK_END) {
+            if (stream->source != NULL) {
+                fill_lookahead(stream, UINT64_MAX);
+                if (!stream->source->eof) {
+                    return -1;
+                }
+            }
+            new_offset += stream->delta != NULL ? get_size_of_delta_file(stream->delta) : stream->size;
+        }
+        if (new_offset < 0) {
+            return -1;
+        }
+        stream->offset = new_offset;
+        return 0;
+    }
+    return raw_seek(stream->fp, offset, origin);
 }
 
 size_t file_write(const void *buffer, size_t size, size_t count, file_handle *stream) {
-    return fwrite(buffer, size, count, stream->fp);
+    size_t elements_written = 0;
+    if (!has_own_offset(stream)) {
+        elements_written = fwrite(buffer, size, count, stream->fp);
+    } else if (size != 0) {
+        elements_written = own_offset_write(buffer, size * count, stream) / size;
+    }
+    stats_count_write(elements_written * size);
+    return elements_written;
 }
 
-int32_t file_putc(int32_t character, file_handle *stream) { return fputc(character, stream->fp); }
+int32_t file_putc(int32_t character, file_handle *stream) {
+    stats_count_write(1);
+    if (has_own_offset(stream)) {
+        uint8_t c = (uint8_t)character;
+        return own_offset_write(&c, 1, stream) == 1 ? c : EOF;
+    }
+    return fputc(character, stream->fp);
+}
 
 int32_t file_printf(file_handle *stream, const char *format, const char *value) {
+    stats_count_write(snprintf(NULL, 0, format, value));
+    if (has_own_offset(stream)) {
+        int32_t buffer_size = snprintf(NULL, 0, format, value);
+        char *buffer = (char *)malloc(buffer_size + 1);
+        sprintf(buffer, format, value);
+        size_t bytes_written = own_offset_write(buffer, buffer_size, stream);
+        free(buffer);
+        return (int32_t)bytes_written;
+    }
     return fprintf(stream->fp, format, value);
 }
 
 uint64_t file_tell(file_handle *stream) {
-#ifdef __linux__
-    return ftello(stream->fp);
-#elif defined(__APPLE__) && defined(__MACH__)
-    return ftello(stream->fp);
-#elif _WIN32
-    return _ftelli64(stream->fp);
-#elif _WIN64
-    return _ftelli64(stream->fp);
+    if (has_own_offset(stream)) {
+        return stream->offset;
+    }
+    return raw_tell(stream->fp);
+}
+
+// transfer the remaining bytes of a request synchronously at its offset
+static void transfer_remaining(file_handle *stream, struct file_io_request *request) {
+    uint8_t *buffer = (uint8_t *)request->buffer;
+#ifdef HAS_MMAP
+    int32_t fd = stream->fd >= 0 ? stream->fd : fileno(stream->fp);
+    while (request->result < request->length) {
+        size_t size = request->length - request->result;
+        uint64_t offset = request->offset + request->result;
+        ssize_t bytes = request->write ? pwrite(fd, buffer + request->result, size, offset)
+                                       : pread(fd, buffer + request->result, size, offset);
+        if (bytes <= 0) {
+            return;
+        }
+        request->result += bytes;
+    }
 #else
-    return -1;
+    if (request->result < request->length && raw_seek(stream->fp, request->offset + request->result, SEEK_SET) == 0) {
+        size_t size = request->length - request->result;
+        request->result += request->write ? fwrite(buffer + request->result, 1, size, stream->fp)
+                                          : fread(buffer + request->result, 1, size, stream->fp);
+    }
 #endif
 }
 
+#ifdef HAS_IO_URING
+struct io_ring {
+    int32_t fd;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint32_t entries;
+    // entries in the submission queue that the kernel did not consume yet
+    uint32_t unsubmitted;
+    // entries consumed by the kernel whose completion was not reaped yet
+    uint32_t in_flight;
+};
+
+static void exit_io_ring(struct io_ring *ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr != NULL) {
+        munmap(ring->sq_ptr, ring->sq_size);
+    }
+    close(ring->fd);
+}
+
+// set up a ring without liburing, fails e.g. on old kernels or if io_uring is disabled
+static int32_t init_io_ring(struct io_ring *ring, uint32_t entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_size > ring->sq_size) {
+        ring->sq_size = ring->cq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        exit_io_ring(ring);
+        return -1;
+    }
+    ring->cq_ptr = single_mmap ? ring->sq_ptr
+                               : mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) {
+        ring->cq_ptr = NULL;
+        exit_io_ring(ring);
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                             ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        exit_io_ring(ring);
+        return -1;
+    }
+
+    uint8_t *sq_ptr = (uint8_t *)ring->sq_ptr;
+    uint8_t *cq_ptr = (uint8_t *)ring->cq_ptr;
+    ring->sq_tail = (uint32_t *)(sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (uint32_t *)(sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *)(sq_ptr + params.sq_off.array);
+    ring->cq_head = (uint32_t *)(cq_ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t *)(cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (uint32_t *)(cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+    ring->entries = params.sq_entries;
+    return 0;
+}
+
+static void close_io_ring(file_handle *stream) {
+    exit_io_ring(stream->ring);
+    free(stream->ring);
+    stream->ring = NULL;
+}
+
+// the ring is only used for plain files on the io_uring backend, it is set up by the first
+// submission. if that fails, the handle keeps using synchronous positioned I/O
+static bool uses_io_ring(file_handle *stream) {
+    if (!io_uring_enabled || stream->map != NULL || stream->fd < 0 || stream->delta != NULL) {
+        return stream->ring != NULL;
+    }
+    if (stream->ring == NULL && !stream->ring_failed) {
+        stream->ring = (struct io_ring *)malloc(sizeof(struct io_ring));
+        if (stream->ring == NULL || init_io_ring(stream->ring, IO_URING_ENTRIES) != 0) {
+            free(stream->ring);
+            stream->ring = NULL;
+            stream->ring_failed = true;
+        }
+    }
+    return stream->ring != NULL;
+}
+
+// move pending requests into the submission queue while the ring has room and pass the
+// queue to the kernel without waiting. the kernel may consume only a part of the queue,
+// the rest stays in the queue and is passed again by the next call
+static void submit_to_io_ring(file_handle *stream) {
+    struct io_ring *ring = stream->ring;
+    uint32_t tail = *ring->sq_tail;
+    while (stream->queued < stream->pending_count && ring->unsubmitted + ring->in_flight < ring->entries) {
+        struct file_io_request *request = stream->pending[stream->queued++];
+        uint32_t index = tail & *ring->sq_mask;
+        struct io_uring_sqe *sqe = &ring->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = stream->fd;
+        sqe->off = request->offset;
+        sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+        sqe->len = request->length < IO_URING_MAX_LENGTH ? request->length : IO_URING_MAX_LENGTH;
+        sqe->user_data = (uint64_t)(uintptr_t)request;
+        ring->sq_array[index] = index;
+        tail++;
+        ring->unsubmitted++;
+    }
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    while (ring->unsubmitted > 0) {
+        int32_t submitted = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, 0, 0, NULL, 0);
+        if (submitted < 0 && errno == EINTR) {
+            continue;
+        }
+        if (submitted > 0) {
+            ring->unsubmitted -= submitted;
+            ring->in_flight += submitted;
+        }
+        // the rest is passed again once completions free up resources of the kernel
+        break;
+    }
+}
+
+// read the completions of the ring into the results of their requests
+static void reap_completions(struct io_ring *ring) {
+    uint32_t head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        struct file_io_request *request = (struct file_io_request *)(uintptr_t)cqe->user_data;
+        if (cqe->res > 0) {
+            request->result = cqe->res;
+        }
+        head++;
+        ring->in_flight--;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// wait until all pending requests passed through the ring. requests the kernel does not
+// accept are removed from the queue again and left for the synchronous fallback
+static void wait_for_io_ring(file_handle *stream) {
+    struct io_ring *ring = stream->ring;
+    while (true) {
+        submit_to_io_ring(stream);
+        if (ring->in_flight == 0) {
+            break;
+        }
+        if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+            // the ring is unusable, closing it cancels the requests in flight
+            close_io_ring(stream);
+            stream->ring_failed = true;
+            return;
+        }
+        reap_completions(ring);
+    }
+    if (ring->unsubmitted > 0) {
+        // nothing is in flight and the kernel still rejects the queue, the entries were
+        // not consumed by the kernel, so they can be taken back from the tail
+        __atomic_store_n(ring->sq_tail, *ring->sq_tail - ring->unsubmitted, __ATOMIC_RELEASE);
+        ring->unsubmitted = 0;
+    }
+}
+#endif
+
+int32_t file_use_io_uring(bool enabled) {
+#ifdef HAS_IO_URING
+    if (enabled) {
+        // the kernel may not support io_uring or it may be disabled, e.g. by a seccomp filter
+        struct io_ring ring;
+        if (init_io_ring(&ring, 1) != 0) {
+            return -1;
+        }
+        exit_io_ring(&ring);
+    }
+    io_uring_enabled = enabled;
+    return 0;
+#else
+    return enabled ? -1 : 0;
+#endif
+}
+
+int32_t file_submit_requests(file_handle *stream, struct file_io_request *requests, size_t count) {
+    if (stream->pending_count + count > stream->pending_capacity) {
+        size_t capacity = stream->pending_capacity == 0 ? 64 : stream->pending_capacity * 2;
+        while (capacity < stream->pending_count + count) {
+            capacity *= 2;
+        }
+        struct file_io_request **pending =
+            (struct file_io_request **)realloc(stream->pending, capacity * sizeof(struct file_io_request *));
+        if (pending == NULL) {
+            fprintf(stderr, "Error: Could not allocate memory for I/O requests.\n");
+            return -1;
+        }
+        stream->pending = pending;
+        stream->pending_capacity = capacity;
+    }
+    for (size_t i = 0; i < count; i++) {
+        requests[i].result = 0;
+        stream->pending[stream->pending_count++] = &requests[i];
+    }
+
+#ifdef HAS_IO_URING
+    if (uses_io_ring(stream)) {
+        submit_to_io_ring(stream);
+        return 0;
+    }
+#endif
+
+    // without a ring the requests are completed right away
+    if (has_own_offset(stream)) {
+        // mapped files and recorded deltas are served from memory
+        uint64_t current_offset = stream->offset;
+        for (size_t i = 0; i < count; i++) {
+            stream->offset = requests[i].offset;
+            requests[i].result = requests[i].write ? own_offset_write(requests[i].buffer, requests[i].length, stream)
+                                                   : own_offset_read(requests[i].buffer, requests[i].length, stream);
+        }
+        stream->offset = current_offset;
+    } else {
+        // pending buffered writes have to reach the file first
+        fflush(stream->fp);
+        uint64_t current_offset = raw_tell(stream->fp);
+        for (size_t i = 0; i < count; i++) {
+            transfer_remaining(stream, &requests[i]);
+        }
+        // drop data buffered by stdio that may be outdated by the writes
+        raw_seek(stream->fp, current_offset, SEEK_SET);
+    }
+    stream->queued = stream->pending_count;
+    return 0;
+}
+
+int32_t file_reap_requests(file_handle *stream) {
+#ifdef HAS_IO_URING
+    if (stream->ring != NULL) {
+        wait_for_io_ring(stream);
+        // short transfers, failed requests and requests the ring did not take are completed synchronously
+        for (size_t i = 0; i < stream->pending_count; i++) {
+            transfer_remaining(stream, stream->pending[i]);
+        }
+    }
+#endif
+
+    int32_t result = 0;
+    for (size_t i = 0; i < stream->pending_count; i++) {
+        struct file_io_request *request = stream->pending[i];
+        if (request->write) {
+            stats_count_write(request->result);
+        } else {
+            stats_count_read(request->result);
+        }
+        if (request->result != request->length) {
+            result = -1;
+        }
+    }
+    stream->pending_count = 0;
+    stream->queued = 0;
+    return result;
+}
+
+int32_t file_submit_batch(file_handle *stream, struct file_io_request *requests, size_t count) {
+    if (file_submit_requests(stream, requests, count) != 0) {
+        return -1;
+    }
+    return file_reap_requests(stream);
+}
+
 int32_t file_close(file_handle *stream) {
-    int32_t result = fclose(stream->fp);
+    int32_t result = 0;
+    if (stream->pending_count > 0) {
+        // buffers of requests in flight must not be released before they are completed
+        file_reap_requests(stream);
+    }
+    free(stream->pending);
+#ifdef HAS_IO_URING
+    if (stream->ring != NULL) {
+        close_io_ring(stream);
+    }
+#endif
+    if (stream->source != NULL) {
+        // the lookahead is owned by the source
+        free(stream);
+        return result;
+    }
+#ifdef HAS_MMAP
+    if (stream->fd >= 0) {
+        if (stream->map != NULL) {
+            result = munmap(stream->map, stream->map_size);
+        }
+        if (close(stream->fd) != 0) {
+            result = EOF;
+        }
+        free(stream);
+        return result;
+    }
+#endif
+    result = fclose(stream->fp);
     free(stream);
     return result;
 }
@@ -1,7 +1,17 @@
 #include "philips-based-io.h"
+#include "stats-alloc.h"
+
+// base64 encoding of the 1x1 white jpeg created by the jpec encoder. the jpeg is a multiple
+// of three bytes long, so zero bytes appended to it continue the encoding with 'A'
+static const char BLANK_JPEG_BASE64[] =
+    "/9j/4AAQSkZJRgABAQAAAQABAAD/2wBDAAICAgICAQICAgIDAgIDAwYEAwMDAwcFBQQGCAcJCAgHCAgJCg0LCQoMCggICw8LDA0O"
+    "Dg8OCQsQERAOEQ0ODg7/wAALCAABAAEBAREA/8QAHwAAAQUBAQEBAQEAAAAAAAAAAAECAwQFBgcICQoL/8QAtRAAAgEDAwIEAwUF"
+    "BAQAAAF9AQIDAAQRBRIhMUEGE1FhByJxFDKBkaEII0KxwRVS0fAkM2JyggkKFhcYGRolJicoKSo0NTY3ODk6Q0RFRkdISUpTVFVW"
+    "V1hZWmNkZWZnaGlqc3R1dnd4eXqDhIWGh4iJipKTlJWWl5iZmqKjpKWmp6ipqrKztLW2t7i5usLDxMXGx8jJytLT1NXW19jZ2uHi"
+    "4+Tl5ufo6erx8vP09fb3+Pn6/9oACAEBAAA/AP37r//Z";
 
 // replaces section of passed attribute with empty string
-char *wipe_section_of_attribute(char *buffer, char *attribute) {
+char *wipe_section_of_attribute(char *buffer, const char *attribute) {
     const char *concatenated_str = concat_str(PHILIPS_ATT_END, PHILIPS_CLOSING_SYMBOL);
     char *rough_section = get_string_between_delimiters(buffer, attribute, concatenated_str);
 
@@ -22,7 +32,7 @@ char *wipe_section_of_attribute(char *buffer, char *attribute) {
 }
 
 // returns value for an attribute
-char *get_value_from_attribute(char *buffer, char *attribute) {
+char *get_value_from_attribute(const char *buffer, const char *attribute) {
     char *value = get_string_between_delimiters(buffer, attribute, PHILIPS_ATT_OPEN);
     char *delimiter = get_string_between_delimiters(value, PHILIPS_ATT_PMSVR, PHILIPS_CLOSING_SYMBOL);
 
@@ -50,7 +60,7 @@ char *get_value_from_attribute(char *buffer, char *attribute) {
 }
 
 // searches for attribute and replaces its value with equal amount of X's
-char *anonymize_value_of_attribute(char *buffer, char *attribute) {
+char *anonymize_value_of_attribute(char *buffer, const char *attribute) {
     char *rough_value = get_string_between_delimiters(buffer, attribute, PHILIPS_ATT_OPEN);
     const char *concatenated_str = concat_str(PHILIPS_DELIMITER_STR, PHILIPS_CLOSING_SYMBOL);
     char *value = get_string_between_delimiters(rough_value, concatenated_str, PHILIPS_ATT_END);
@@ -165,4 +175,141 @@ int32_t *get_height_and_width(const char *image_data) {
     free(decoded_data);
 
     return h_and_w;
-}
\ No newline at end of file
+}
+// get the next attribute element of an xml header behind the given position. nested
+// attributes are returned in document order, so the header is tokenized in a single pass
+bool next_xml_attribute(char *buffer, size_t length, size_t *position, struct xml_attribute *attribute) {
+    static const char CLOSING_TAG[] = PHILIPS_ATT_END PHILIPS_CLOSING_SYMBOL;
+    const size_t open_length = strlen(PHILIPS_ATT_OPEN);
+    const size_t name_length = strlen(PHILIPS_ATT_NAME);
+    char *end = buffer + length;
+
+    while (*position < length) {
+        char *start = (char *)find_in_buffer(buffer + *position, length - *position, PHILIPS_ATT_OPEN, open_length);
+        char *tag_end = start != NULL ? (char *)memchr(start, '>', end - start) : NULL;
+        if (tag_end == NULL) {
+            *position = length;
+            return false;
+        }
+        *position = tag_end + 1 - buffer;
+
+        // skip other elements sharing the prefix and attributes without name
+        const char *name = start[open_length] == ' '
+                               ? find_in_buffer(start, tag_end - start, PHILIPS_ATT_NAME, name_length)
+                               : NULL;
+        const char *name_end = name != NULL ? (const char *)memchr(name + name_length, '"', tag_end - name) : NULL;
+        if (name_end == NULL) {
+            continue;
+        }
+
+        attribute->start = start;
+        attribute->name = name + name_length;
+        attribute->name_length = name_end - attribute->name;
+        attribute->value = tag_end + 1;
+        char *value_end = attribute->value;
+        if (tag_end[-1] != '/') {
+            value_end = (char *)memchr(attribute->value, '<', end - attribute->value);
+        }
+        if (value_end == NULL) {
+            value_end = end;
+        }
+        attribute->value_length = value_end - attribute->value;
+
+        // the element of a plain value ends with the closing tag behind the value
+        attribute->length = 0;
+        size_t closing_length = strlen(CLOSING_TAG);
+        if ((size_t)(end - value_end) >= closing_length && memcmp(value_end, CLOSING_TAG, closing_length) == 0) {
+            attribute->length = value_end + closing_length - start;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool has_xml_attribute_name(const struct xml_attribute *attribute, const char *name) {
+    return attribute->name_length == strlen(name) && memcmp(attribute->name, name, attribute->name_length) == 0;
+}
+
+bool has_xml_attribute_value(const struct xml_attribute *attribute, const char *value) {
+    return attribute->value_length == strlen(value) && memcmp(attribute->value, value, attribute->value_length) == 0;
+}
+
+// record a range of the buffer that was changed in place
+int32_t add_xml_patch(struct xml_patches *patches, uint64_t offset, uint64_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (patches->count == patches->capacity) {
+        int32_t capacity = patches->capacity == 0 ? 16 : patches->capacity * 2;
+        uint64_t *offsets = (uint64_t *)realloc(patches->offsets, capacity * sizeof(uint64_t));
+        if (offsets != NULL) {
+            patches->offsets = offsets;
+        }
+        uint64_t *lengths = (uint64_t *)realloc(patches->lengths, capacity * sizeof(uint64_t));
+        if (lengths != NULL) {
+            patches->lengths = lengths;
+        }
+        if (offsets == NULL || lengths == NULL) {
+            fprintf(stderr, "Error: Could not allocate memory for patch.\n");
+            return -1;
+        }
+        patches->capacity = capacity;
+    }
+    patches->offsets[patches->count] = offset;
+    patches->lengths[patches->count] = length;
+    patches->count++;
+    return 0;
+}
+
+// write the changed ranges of a buffer, that was read from the given file offset, back
+// to the file. adjacent ranges are merged and all ranges are written in one batch
+int32_t write_xml_patches(file_handle *fp, uint64_t offset, char *buffer, struct xml_patches *patches) {
+    int32_t count = merge_ranges(patches->offsets, patches->lengths, patches->count);
+    struct file_io_request *requests = (struct file_io_request *)malloc((count + 1) * sizeof(struct file_io_request));
+    if (requests == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for write requests.\n");
+        return -1;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        requests[i].offset = offset + patches->offsets[i];
+        requests[i].buffer = buffer + patches->offsets[i];
+        requests[i].length = patches->lengths[i];
+        requests[i].write = true;
+    }
+
+    int32_t result = file_submit_batch(fp, requests, count);
+    if (result != 0) {
+        fprintf(stderr, "Error: Changing XML header failed.\n");
+    }
+    free(requests);
+    return result;
+}
+
+void free_xml_patches(struct xml_patches *patches) {
+    free(patches->offsets);
+    free(patches->lengths);
+    patches->offsets = NULL;
+    patches->lengths = NULL;
+    patches->count = 0;
+    patches->capacity = 0;
+}
+
+// get a copy of the base64 encoded 1x1 white jpeg
+char *create_blank_jpeg_base64() { return strdup(BLANK_JPEG_BASE64); }
+
+// overwrite base64 encoded image data with a blank image of the same length. the jpeg
+// is padded with zeros behind its end marker and the remaining characters with spaces
+void wipe_image_data_of_attribute(struct xml_attribute *attribute) {
+    size_t blank_len = sizeof(BLANK_JPEG_BASE64) - 1;
+    if (attribute->value_length < blank_len) {
+        // the blank image does not fit, the image data is removed nevertheless
+        memset(attribute->value, 'A', attribute->value_length);
+        return;
+    }
+
+    // the zero padding fills whole groups of four characters
+    size_t encoded_len = (attribute->value_length / 4) * 4;
+    memcpy(attribute->value, BLANK_JPEG_BASE64, blank_len);
+    memset(attribute->value + blank_len, 'A', encoded_len - blank_len);
+    memset(attribute->value + encoded_len, ' ', attribute->value_length - encoded_len);
+}
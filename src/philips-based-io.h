@@ -3,15 +3,30 @@
 
 #include "b64.h"
 #include "defines.h"
-#include "jpec.h"
 #include "utils.h"
 
-char *wipe_section_of_attribute(char *buffer, char *attribute);
+char *wipe_section_of_attribute(char *buffer, const char *attribute);
 
-char *get_value_from_attribute(char *buffer, char *attribute);
+char *get_value_from_attribute(const char *buffer, const char *attribute);
 
-char *anonymize_value_of_attribute(char *buffer, char *attribute);
+char *anonymize_value_of_attribute(char *buffer, const char *attribute);
 
 int32_t *get_height_and_width(const char *image_data);
 
+bool next_xml_attribute(char *buffer, size_t length, size_t *position, struct xml_attribute *attribute);
+
+bool has_xml_attribute_name(const struct xml_attribute *attribute, const char *name);
+
+bool has_xml_attribute_value(const struct xml_attribute *attribute, const char *value);
+
+int32_t add_xml_patch(struct xml_patches *patches, uint64_t offset, uint64_t length);
+
+int32_t write_xml_patches(file_handle *fp, uint64_t offset, char *buffer, struct xml_patches *patches);
+
+void free_xml_patches(struct xml_patches *patches);
+
+char *create_blank_jpeg_base64();
+
+void wipe_image_data_of_attribute(struct xml_attribute *attribute);
+
 #endif
\ No newline at end of file
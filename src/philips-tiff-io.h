@@ -8,14 +8,16 @@ static const char DOT_TIFF[] = ".tiff";
 static const char TIFF[] = "tiff";
 
 // main functions
-struct metadata_attribute *get_attribute_philips_tiff(char *buffer, char *attribute);
+struct metadata_attribute *get_attribute_philips_tiff(const char *buffer, const char *attribute);
 
 struct metadata *get_metadata_philips_tiff(file_handle *fp, struct tiff_file *file);
 
+struct wsi_data *get_wsi_data_philips_tiff_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename);
+
 struct wsi_data *get_wsi_data_philips_tiff(const char *filename);
 
 int32_t handle_philips_tiff(const char **filename, const char *new_label_name, bool keep_macro_image,
-                            bool disable_unlinking, bool do_inplace);
+                            bool disable_unlinking, bool do_inplace, struct tiff_file *file);
 
 // additional functions
 int32_t wipe_philips_image_data(file_handle *fp, struct tiff_file *file, char *image_type);
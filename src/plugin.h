@@ -10,19 +10,28 @@
  * (or &get_wsi_data_<YOUR_FORMAT>() and &handle_<YOUR_FORMAT>()) to the *get_wsi_data_functions[] and
  * *handle_format_functions[] arrays in wsi-anonymizer.c.
  *
+ * If your format is TIFF based, additionally implement get_wsi_data_format_from_tiff() and add it to the
+ * *get_wsi_data_from_tiff_functions[] array (otherwise add NULL). The file structure is then read only once during
+ * format detection and passed to handle_format(). handle_format() takes ownership of the passed file structure and
+ * has to free it; if NULL is passed, the file structure has to be read by handle_format() itself.
+ *
  */
 
 #ifndef HEADER_PLUGIN_H
 #define HEADER_PLUGIN_H
 
+#include "file-api.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 // returns a struct containing all necessary information (label and macro image and metadata) regarding the WSI
 struct wsi_data *get_wsi_data_format(const char *filename);
 
+// same as above for TIFF based formats, but works on an already opened file and read file structure
+struct wsi_data *get_wsi_data_format_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename);
+
 // implements the anonymization for the added format
 int32_t handle_format(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                      bool do_inplace);
+                      bool do_inplace, struct tiff_file *file);
 
 #endif
@@ -0,0 +1,16 @@
+#ifndef HEADER_STATS_ALLOC_H
+#define HEADER_STATS_ALLOC_H
+
+#include <stdlib.h>
+
+// counts the allocations of the library into the statistics of the calling thread while
+// they are recorded. only included by the source files of the library after all other
+// headers, so that programs using the library keep the allocator of the c library
+void *stats_malloc(size_t size);
+void *stats_calloc(size_t count, size_t size);
+void *stats_realloc(void *ptr, size_t size);
+#define malloc(size) stats_malloc(size)
+#define calloc(count, size) stats_calloc(count, size)
+#define realloc(ptr, size) stats_realloc(ptr, size)
+
+#endif
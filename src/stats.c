@@ -0,0 +1,130 @@
+#include "stats.h"
+#include "stats-alloc.h"
+#include "utils.h"
+
+// the counted allocation functions use the allocator of the c library
+#undef malloc
+#undef calloc
+#undef realloc
+
+// statistics recorded by this thread and the phase the thread is currently in
+static _Thread_local struct anonymization_stats *recorded_stats = NULL;
+static _Thread_local ANONYMIZATION_PHASE current_phase = PHASE_NONE;
+static _Thread_local double phase_start = 0;
+static _Thread_local double recording_start = 0;
+
+void stats_start_recording(struct anonymization_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->format = INVALID;
+    stats->label_directory = -1;
+    stats->macro_directory = -1;
+    recorded_stats = stats;
+    current_phase = PHASE_NONE;
+    recording_start = get_time_in_seconds();
+    phase_start = recording_start;
+}
+
+void stats_stop_recording() {
+    if (recorded_stats == NULL) {
+        return;
+    }
+    double now = get_time_in_seconds();
+    if (current_phase != PHASE_NONE) {
+        recorded_stats->phase_seconds[current_phase] += now - phase_start;
+    }
+    recorded_stats->total_seconds = now - recording_start;
+    recorded_stats = NULL;
+    current_phase = PHASE_NONE;
+}
+
+// count the time since the last change of phase for the current phase and switch to the next one
+static void switch_phase(ANONYMIZATION_PHASE phase) {
+    double now = get_time_in_seconds();
+    if (current_phase != PHASE_NONE) {
+        recorded_stats->phase_seconds[current_phase] += now - phase_start;
+    }
+    current_phase = phase;
+    phase_start = now;
+}
+
+ANONYMIZATION_PHASE stats_enter_phase(ANONYMIZATION_PHASE phase) {
+    ANONYMIZATION_PHASE previous_phase = current_phase;
+    if (recorded_stats != NULL && phase != current_phase) {
+        switch_phase(phase);
+    }
+    return previous_phase;
+}
+
+void stats_leave_phase(ANONYMIZATION_PHASE previous_phase) {
+    if (recorded_stats != NULL && previous_phase != current_phase) {
+        switch_phase(previous_phase);
+    }
+}
+
+void stats_record_format(FILE_FORMAT format) {
+    if (recorded_stats != NULL) {
+        recorded_stats->format = format;
+    }
+}
+
+void stats_record_directory(int64_t directory) {
+    if (recorded_stats == NULL) {
+        return;
+    }
+    if (current_phase == PHASE_WIPE_LABEL) {
+        recorded_stats->label_directory = directory;
+    } else if (current_phase == PHASE_WIPE_MACRO) {
+        recorded_stats->macro_directory = directory;
+    }
+}
+
+void stats_record_copy(const struct copy_stats *copy) {
+    if (recorded_stats != NULL) {
+        recorded_stats->bytes_copied += copy->bytes_copied;
+        recorded_stats->copy_method = copy->method;
+    }
+}
+
+void stats_count_read(size_t bytes) {
+    if (recorded_stats != NULL) {
+        recorded_stats->reads++;
+        recorded_stats->bytes_read += bytes;
+    }
+}
+
+void stats_count_write(size_t bytes) {
+    if (recorded_stats != NULL) {
+        recorded_stats->writes++;
+        recorded_stats->bytes_written += bytes;
+        if (current_phase == PHASE_WIPE_LABEL || current_phase == PHASE_WIPE_MACRO) {
+            recorded_stats->bytes_wiped += bytes;
+        }
+    }
+}
+
+void stats_count_seek() {
+    if (recorded_stats != NULL) {
+        recorded_stats->seeks++;
+    }
+}
+
+void *stats_malloc(size_t size) {
+    if (recorded_stats != NULL) {
+        recorded_stats->allocations++;
+    }
+    return malloc(size);
+}
+
+void *stats_calloc(size_t count, size_t size) {
+    if (recorded_stats != NULL) {
+        recorded_stats->allocations++;
+    }
+    return calloc(count, size);
+}
+
+void *stats_realloc(void *ptr, size_t size) {
+    if (recorded_stats != NULL) {
+        recorded_stats->allocations++;
+    }
+    return realloc(ptr, size);
+}
@@ -0,0 +1,34 @@
+#ifndef HEADER_STATS_H
+#define HEADER_STATS_H
+
+#include "defines.h"
+
+static const char *const PHASE_STRINGS[] = {"probe", "parse", "wipe label", "wipe macro", "metadata", "unlink", "copy"};
+
+// while recording, file operations, allocations and the time spent in each phase
+// on this thread are counted into the given statistics
+void stats_start_recording(struct anonymization_stats *stats);
+
+void stats_stop_recording();
+
+// the time until the phase is left is counted for the given phase. returns the
+// current phase, which is continued when the phase is left
+ANONYMIZATION_PHASE stats_enter_phase(ANONYMIZATION_PHASE phase);
+
+void stats_leave_phase(ANONYMIZATION_PHASE previous_phase);
+
+void stats_record_format(FILE_FORMAT format);
+
+// records the directory of the associated image that is wiped in the current phase
+void stats_record_directory(int64_t directory);
+
+// adds the bytes of a completed copy and records its method
+void stats_record_copy(const struct copy_stats *copy);
+
+void stats_count_read(size_t bytes);
+
+void stats_count_write(size_t bytes);
+
+void stats_count_seek();
+
+#endif
@@ -1,98 +1,296 @@
 #include "tiff-based-io.h"
+#include "stats-alloc.h"
 
-// initialize directory array for a given tiff file
+// initialize directory array for a given tiff file. directories and entries
+// of the file are allocated from its arena
 void init_tiff_file(struct tiff_file *file, size_t init_size) {
+    file->arena.blocks = NULL;
     size_t alloc_size = init_size * sizeof(struct tiff_directory);
-    file->directories = (struct tiff_directory *)malloc(alloc_size);
+    file->directories = (struct tiff_directory *)arena_alloc(&file->arena, alloc_size);
     memset(file->directories, 0, alloc_size);
     file->used = 0;
     file->size = init_size;
+    file->next_dir_offset = 0;
+    file->next_in_pointer_offset = 0;
+    file->tag_index = NULL;
+    file->tag_index_size = 0;
+    file->tag_index_outdated = false;
 }
 
-// add directory to a given tiff file and resize array if necessary
+// add a copy of the directory to a given tiff file and resize array if necessary
 void insert_dir_into_tiff_file(struct tiff_file *file, struct tiff_directory *dir) {
-    // reallocate directories array dynamically
+    // the array grows within the arena, the previous array is released with it
     if (file->used == file->size) {
+        size_t alloc_size = file->size * 2 * sizeof(struct tiff_directory);
+        struct tiff_directory *directories = (struct tiff_directory *)arena_alloc(&file->arena, alloc_size);
+        memset(directories, 0, alloc_size);
+        memcpy(directories, file->directories, file->used * sizeof(struct tiff_directory));
+        file->directories = directories;
         file->size *= 2;
-        size_t realloc_size = file->size * sizeof(struct tiff_directory);
-        file->directories = (struct tiff_directory *)realloc(file->directories, realloc_size);
-        memset(&(file->directories[file->size / 2]), 0, realloc_size / 2);
+    }
+    // copy the tags into an array of their own for searching
+    dir->tags = (uint16_t *)arena_alloc(&file->arena, dir->count * sizeof(uint16_t));
+    for (uint32_t i = 0; i < dir->count; i++) {
+        dir->tags[i] = dir->entries[i].tag;
     }
     file->directories[file->used++] = *dir;
-    free(dir);
+
+    // the tag index is rebuilt with the new directory on the next lookup
+    file->tag_index_outdated = true;
 }
 
 // free tiff_file with all directories and entries
 void free_tiff_file(struct tiff_file *file) {
-    free(file->directories);
+    free_tag_index(file);
+    free_arena(&file->arena);
     free(file);
 }
 
-// fix the byte order for data array depending on the endianess
-// of the operating system and the tiff file
-void fix_byte_order(void *data, int32_t size, int64_t count, bool big_endian) {
-    // we only need to swap data, if system endianness
-    // and tiff endianness are unequal
-    if (is_system_big_endian() != big_endian) {
-        switch (size) {
-        case 1:
-            break;
-        case 2: {
-            uint16_t *arr = (uint16_t *)data;
-            for (int64_t i = 0; i < count; i++) {
-                _swap_uint16(arr[i]);
-            }
-            break;
+// free the tag index with all cached values
+void free_tag_index(struct tiff_file *file) {
+    for (uint64_t i = 0; file->tag_index != NULL && i < file->tag_index_size; i++) {
+        free(file->tag_index[i].value);
+    }
+    free(file->tag_index);
+    file->tag_index = NULL;
+    file->tag_index_size = 0;
+    file->tag_index_outdated = false;
+}
+
+int32_t compare_tag_references(const void *a, const void *b) {
+    const struct tiff_tag_reference *ref_a = (const struct tiff_tag_reference *)a;
+    const struct tiff_tag_reference *ref_b = (const struct tiff_tag_reference *)b;
+    if (ref_a->tag != ref_b->tag) {
+        return ref_a->tag < ref_b->tag ? -1 : 1;
+    }
+    if (ref_a->dir != ref_b->dir) {
+        return ref_a->dir < ref_b->dir ? -1 : 1;
+    }
+    return ref_a->entry < ref_b->entry ? -1 : ref_a->entry > ref_b->entry;
+}
+
+// index all entries of the tiff file by tag, so that a tag is found
+// without iterating over all entries of all directories
+int32_t build_tag_index(struct tiff_file *file) {
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < file->used; i++) {
+        size += file->directories[i].count;
+    }
+
+    struct tiff_tag_reference *tag_index =
+        (struct tiff_tag_reference *)malloc((size + 1) * sizeof(struct tiff_tag_reference));
+    if (tag_index == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for tag index.\n");
+        return -1;
+    }
+
+    uint64_t k = 0;
+    for (uint32_t i = 0; i < file->used; i++) {
+        for (uint32_t j = 0; j < file->directories[i].count; j++) {
+            tag_index[k].tag = file->directories[i].entries[j].tag;
+            tag_index[k].dir = i;
+            tag_index[k].entry = j;
+            tag_index[k].value = NULL;
+            k++;
         }
-        case 4: {
-            uint32_t *arr = (uint32_t *)data;
-            for (int64_t i = 0; i < count; i++) {
-                _swap_uint32(arr[i]);
-            }
-            break;
+    }
+    qsort(tag_index, size, sizeof(struct tiff_tag_reference), compare_tag_references);
+
+    // values cached by a previous index are taken over, its references are a subset of the new ones
+    for (uint64_t i = 0, j = 0; file->tag_index != NULL && i < file->tag_index_size; i++) {
+        while (j < size && compare_tag_references(&tag_index[j], &file->tag_index[i]) < 0) {
+            j++;
         }
-        case 8: {
-            uint64_t *arr = (uint64_t *)data;
-            for (int64_t i = 0; i < count; i++) {
-                _swap_uint64(arr[i]);
-            }
-            break;
+        if (j < size && compare_tag_references(&tag_index[j], &file->tag_index[i]) == 0) {
+            tag_index[j].value = file->tag_index[i].value;
+            file->tag_index[i].value = NULL;
         }
-        default:
-            break;
+    }
+
+    free_tag_index(file);
+    file->tag_index = tag_index;
+    file->tag_index_size = size;
+    return 0;
+}
+
+// get all entries with the given tag in the order of directories and entries. returns the
+// first reference in the tag index and sets count to the number of references with the tag
+const struct tiff_tag_reference *find_tag_references(struct tiff_file *file, uint16_t tag, uint64_t *count) {
+    *count = 0;
+    if ((file->tag_index == NULL || file->tag_index_outdated) && build_tag_index(file) != 0) {
+        return NULL;
+    }
+
+    // binary search for the first reference with the tag
+    uint64_t low = 0;
+    uint64_t high = file->tag_index_size;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (file->tag_index[middle].tag < tag) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
     }
+
+    uint64_t end = low;
+    while (end < file->tag_index_size && file->tag_index[end].tag == tag) {
+        end++;
+    }
+    *count = end - low;
+    return &file->tag_index[low];
 }
 
-// read an unsigned integer from a filestream at current position
-uint64_t read_uint(file_handle *fp, int32_t size, bool big_endian) {
-    uint8_t buffer[size];
-    if (file_read(buffer, size, 1, fp) != 1) {
-        return 0;
+// get the first entry with the given tag in a directory that is already read, NULL if there is none
+const struct tiff_tag_reference *find_tag_reference_in_directory(struct tiff_file *file, uint32_t dir, uint16_t tag) {
+    uint64_t count;
+    const struct tiff_tag_reference *references = find_tag_references(file, tag, &count);
+    for (uint64_t k = 0; k < count && references[k].dir <= dir; k++) {
+        if (references[k].dir == dir) {
+            return &references[k];
+        }
     }
+    return NULL;
+}
 
-    fix_byte_order(buffer, sizeof(buffer), 1, big_endian);
+// get the entry a reference of the tag index points to
+struct tiff_entry *get_entry_of_reference(struct tiff_file *file, const struct tiff_tag_reference *reference) {
+    return &file->directories[reference->dir].entries[reference->entry];
+}
+
+// number of bytes of the value of an entry
+uint64_t get_length_of_value(struct tiff_entry entry) {
+    uint32_t count = entry.count;
+    return (uint64_t)get_size_of_value(entry.type, &count) * count;
+}
+
+// get the value of an entry, e.g. the image description. the value is read from the file once and
+// served from the tag index afterwards, it is owned by the tiff file and always null-terminated
+const char *get_tag_value(file_handle *fp, struct tiff_file *file, const struct tiff_tag_reference *reference) {
+    struct tiff_tag_reference *cached = &file->tag_index[reference - file->tag_index];
+    if (cached->value != NULL) {
+        return cached->value;
+    }
+
+    struct tiff_entry entry = *get_entry_of_reference(file, reference);
+    size_t length = get_length_of_value(entry);
+    char *value = (char *)malloc(length + 1);
+    if (value == NULL || length == 0 || file_seek(fp, entry.offset, SEEK_SET) != 0 ||
+        file_read(value, length, 1, fp) != 1) {
+        free(value);
+        return NULL;
+    }
+    value[length] = '\0';
+    cached->value = value;
+    return value;
+}
+
+// read the uncached values of all entries with the tag in the directories read so far in one batch,
+// e.g. before they are searched one after another. values that can not be read are left to get_tag_value
+void read_tag_values(file_handle *fp, struct tiff_file *file, uint16_t tag) {
+    uint64_t count;
+    const struct tiff_tag_reference *references = find_tag_references(file, tag, &count);
+    if (count < 2) {
+        return;
+    }
+    struct file_io_request *requests = (struct file_io_request *)malloc(count * sizeof(struct file_io_request));
+    struct tiff_tag_reference **targets =
+        (struct tiff_tag_reference **)malloc(count * sizeof(struct tiff_tag_reference *));
+    if (requests == NULL || targets == NULL) {
+        free(requests);
+        free(targets);
+        return;
+    }
+
+    uint64_t num_requests = 0;
+    for (uint64_t k = 0; k < count; k++) {
+        struct tiff_tag_reference *cached = &file->tag_index[&references[k] - file->tag_index];
+        struct tiff_entry entry = *get_entry_of_reference(file, cached);
+        size_t length = get_length_of_value(entry);
+        char *value = cached->value == NULL && length > 0 ? (char *)malloc(length + 1) : NULL;
+        if (value == NULL) {
+            continue;
+        }
+        value[length] = '\0';
+        struct file_io_request request = {entry.offset, value, length, false, 0};
+        requests[num_requests] = request;
+        targets[num_requests++] = cached;
+    }
+
+    file_submit_batch(fp, requests, num_requests);
+    for (uint64_t k = 0; k < num_requests; k++) {
+        if (requests[k].result == requests[k].length) {
+            targets[k]->value = (char *)requests[k].buffer;
+        } else {
+            free(requests[k].buffer);
+        }
+    }
+    free(requests);
+    free(targets);
+}
+
+// get a copy of the value of an entry that may be modified, the copy has to be freed
+char *copy_tag_value(file_handle *fp, struct tiff_file *file, const struct tiff_tag_reference *reference) {
+    const char *value = get_tag_value(fp, file, reference);
+    if (value == NULL) {
+        return NULL;
+    }
+    size_t length = get_length_of_value(*get_entry_of_reference(file, reference));
+    char *copy = (char *)malloc(length + 1);
+    if (copy != NULL) {
+        memcpy(copy, value, length + 1);
+    }
+    return copy;
+}
 
+// drop the cached values overlapping a rewritten range of the file,
+// so that they are read again on their next use
+void invalidate_tag_values(struct tiff_file *file, uint64_t offset, uint64_t length) {
+    for (uint64_t i = 0; file->tag_index != NULL && i < file->tag_index_size; i++) {
+        struct tiff_tag_reference *reference = &file->tag_index[i];
+        if (reference->value == NULL) {
+            continue;
+        }
+        struct tiff_entry entry = *get_entry_of_reference(file, reference);
+        if (entry.offset < offset + length && offset < entry.offset + get_length_of_value(entry)) {
+            free(reference->value);
+            reference->value = NULL;
+        }
+    }
+}
+
+// fix the byte order for data array depending on the endianess
+// of the operating system and the tiff file
+void fix_byte_order(void *data, int32_t size, int64_t count, bool big_endian) {
+    // we only need to swap data, if system endianness
+    // and tiff endianness are unequal
+    if (is_system_big_endian() != big_endian) {
+        swap_byte_order(data, size, count);
+    }
+}
+
+// decode an unsigned integer from a byte buffer. single values are swapped
+// directly, without the dispatch of swap_byte_order for arrays
+uint64_t decode_uint(const uint8_t *buffer, int32_t size, bool big_endian) {
+    bool swap = is_system_big_endian() != big_endian;
     switch (size) {
     case 1: {
-        uint8_t result;
-        memcpy(&result, buffer, sizeof(result));
-        return result;
+        return buffer[0];
     }
     case 2: {
         uint16_t result;
         memcpy(&result, buffer, sizeof(result));
-        return result;
+        return swap ? _swap_uint16(result) : result;
     }
     case 4: {
         uint32_t result;
         memcpy(&result, buffer, sizeof(result));
-        return result;
+        return swap ? _swap_uint32(result) : result;
     }
     case 8: {
         uint64_t result;
         memcpy(&result, buffer, sizeof(result));
-        return result;
+        return swap ? _swap_uint64(result) : result;
     }
     default: {
         return 0;
@@ -100,6 +298,15 @@ uint64_t read_uint(file_handle *fp, int32_t size, bool big_endian) {
     }
 }
 
+// read an unsigned integer from a filestream at current position
+uint64_t read_uint(file_handle *fp, int32_t size, bool big_endian) {
+    uint8_t buffer[size];
+    if (file_read(buffer, size, 1, fp) != 1) {
+        return 0;
+    }
+    return decode_uint(buffer, size, big_endian);
+}
+
 // get the type size needed to readout the value
 uint32_t get_size_of_value(uint16_t type, uint32_t *count) {
     if (type == TIFF_BYTE || type == TIFF_ASCII || type == TIFF_SBYTE || type == TIFF_UNDEFINED) {
@@ -127,15 +334,12 @@ uint64_t fix_ndpi_offset(uint64_t directory_offset, uint64_t offset) {
     return new_offset;
 }
 
-void free_tiff_dir_and_entries(struct tiff_directory *tiff_dir, struct tiff_entry *entries, struct tiff_entry *entry) {
-    free(tiff_dir);
-    free(entries);
-    free(entry);
-}
-
-// read a tiff directory at a certain offset
-struct tiff_directory *read_tiff_directory(file_handle *fp, uint64_t *dir_offset, uint64_t *in_pointer_offset,
-                                           bool big_tiff, bool ndpi, bool big_endian) {
+// read a tiff directory at a certain offset. the entries, the offset of
+// the successor and, for ndpi, the extension block with the high bits of
+// the values are read at once and decoded from the buffer. the directory
+// and its entries are allocated from the given arena
+struct tiff_directory *read_tiff_directory(file_handle *fp, struct arena *arena, uint64_t *dir_offset,
+                                           uint64_t *in_pointer_offset, bool big_tiff, bool ndpi, bool big_endian) {
     uint64_t offset = *dir_offset;
     *dir_offset = 0;
 
@@ -146,99 +350,111 @@ struct tiff_directory *read_tiff_directory(file_handle *fp, uint64_t *dir_offset
     }
 
     // read number of entries in directory
-    uint64_t entry_count = read_uint(fp, big_tiff ? 8 : 2, big_endian);
+    uint8_t count_size = big_tiff ? 8 : 2;
+    uint64_t entry_count = read_uint(fp, count_size, big_endian);
+
+    uint8_t entry_size = big_tiff ? 20 : 12;
+    uint8_t count_field_size = big_tiff ? 8 : 4;
+    uint8_t read_size = big_tiff ? 8 : 4;
+    uint8_t next_pointer_size = (big_tiff || ndpi) ? 8 : 4;
+    if (entry_count > (SIZE_MAX - NDPI_BIT_EXTENSION - 8) / (entry_size + NDPI_BIT_EXTENSION)) {
+        fprintf(stderr, "Error: Invalid number of directory entries.\n");
+        return NULL;
+    }
 
-    struct tiff_directory *tiff_dir = (struct tiff_directory *)malloc(sizeof(struct tiff_directory));
-    tiff_dir->count = entry_count;
-    tiff_dir->in_pointer_offset = *in_pointer_offset;
+    // the ndpi extension block holds the high 4 bytes of every value and is located
+    // after the entries, relative to the directory offset
+    size_t entries_size = entry_count * entry_size;
+    size_t ndpi_extension_end = ndpi && entry_count > 0
+                                    ? (NDPI_ENTRY_EXTENSION * entry_count) + (NDPI_BIT_EXTENSION * entry_count) +
+                                          (NDPI_ENTRY_EXTENSION / 2) - count_size
+                                    : 0;
+    size_t block_size = entries_size + next_pointer_size;
+    if (ndpi_extension_end > block_size) {
+        block_size = ndpi_extension_end;
+    }
 
-    struct tiff_entry *entries = (struct tiff_entry *)malloc(entry_count * sizeof(struct tiff_entry));
+    uint8_t *block = (uint8_t *)malloc(block_size);
+    struct tiff_directory *tiff_dir = (struct tiff_directory *)arena_alloc(arena, sizeof(struct tiff_directory));
+    struct tiff_entry *entries = (struct tiff_entry *)arena_alloc(arena, entry_count * sizeof(struct tiff_entry));
 
-    for (uint64_t i = 0; i < entry_count; i++) {
-        struct tiff_entry *entry = (struct tiff_entry *)malloc(sizeof(struct tiff_entry));
+    if (block == NULL || tiff_dir == NULL || entries == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for entry.\n");
+        free(block);
+        return NULL;
+    }
 
-        if (entry == NULL) {
-            fprintf(stderr, "Error: Could not allocate memory for entry.\n");
-            free_tiff_dir_and_entries(tiff_dir, entries, entry);
-            return NULL;
-        }
+    // the block may be truncated at the end of the file
+    size_t bytes_read = file_read(block, 1, block_size, fp);
+    if (bytes_read < entries_size) {
+        fprintf(stderr, "Error: Reading value to array failed.\n");
+        free(block);
+        return NULL;
+    }
+    if (bytes_read < ndpi_extension_end) {
+        fprintf(stderr, "Error: Cannot read offset extension.\n");
+        free(block);
+        return NULL;
+    }
+
+    tiff_dir->count = entry_count;
+    tiff_dir->in_pointer_offset = *in_pointer_offset;
+    tiff_dir->ndpi_high_bits = 0;
 
-        entry->start = file_tell(fp);
+    uint64_t entries_start = offset + count_size;
+    for (uint64_t i = 0; i < entry_count; i++) {
+        const uint8_t *raw_entry = block + (i * entry_size);
+        struct tiff_entry *entry = &entries[i];
 
-        uint16_t tag = read_uint(fp, 2, big_endian);
-        uint16_t type = read_uint(fp, 2, big_endian);
-        uint64_t count = read_uint(fp, big_tiff ? 8 : 4, big_endian);
-        entry->tag = tag;
-        entry->type = type;
+        entry->start = entries_start + (i * entry_size);
+        entry->tag = decode_uint(raw_entry, 2, big_endian);
+        entry->type = decode_uint(raw_entry + 2, 2, big_endian);
+        uint64_t count = decode_uint(raw_entry + 4, count_field_size, big_endian);
         entry->count = count;
 
         // calculate the size of the entry value
         uint32_t value_size = get_size_of_value(entry->type, &entry->count);
         if (!value_size || count > (SIZE_MAX / value_size)) {
             fprintf(stderr, "Error: Failed to determine valid parameters to read value from file.\n");
-            free_tiff_dir_and_entries(tiff_dir, entries, entry);
+            free(block);
             return NULL;
         }
 
-        // read entry value to array
-        uint8_t value[(big_tiff || ndpi) ? 8 : 4];
-        uint8_t read_size = big_tiff ? 8 : 4;
-        if (file_read(value, read_size, 1, fp) != 1) {
-            fprintf(stderr, "Error: Reading value to array failed.\n");
-            free_tiff_dir_and_entries(tiff_dir, entries, entry);
-            return NULL;
-        }
+        // gather entry value
+        uint8_t value[8] = {0};
+        memcpy(value, raw_entry + 4 + count_field_size, read_size);
 
         if (ndpi) {
             bool is_value = (value_size * count <= read_size);
-            if (file_seek(fp,
-                          offset + (NDPI_ENTRY_EXTENSION * entry_count) + (NDPI_BIT_EXTENSION * i) +
-                              (NDPI_ENTRY_EXTENSION / 2),
-                          SEEK_SET) != 0) {
-                fprintf(stderr, "Error: Cannot seek to offset extension.\n");
-                free_tiff_dir_and_entries(tiff_dir, entries, entry);
-                return NULL;
-            }
-            if (file_read(value + NDPI_BIT_EXTENSION, NDPI_BIT_EXTENSION, 1, fp) != 1) {
-                fprintf(stderr, "Error: Cannot read offset extension.\n");
-                free_tiff_dir_and_entries(tiff_dir, entries, entry);
-                return NULL;
-            }
+            size_t extension = (NDPI_ENTRY_EXTENSION * entry_count) + (NDPI_BIT_EXTENSION * i) +
+                               (NDPI_ENTRY_EXTENSION / 2) - count_size;
+            memcpy(value + NDPI_BIT_EXTENSION, block + extension, NDPI_BIT_EXTENSION);
             if (is_value && (value[4] > 0 || value[5] > 0 || value[6] > 0 || value[7] > 0)) {
                 uint32_t result;
                 memcpy(&result, value + NDPI_BIT_EXTENSION, sizeof(result));
                 tiff_dir->ndpi_high_bits = result;
             }
-            uint64_t dir_start = (NDPI_ENTRY_EXTENSION * (i + 1)) + (NDPI_BIT_EXTENSION / 2);
-            if (file_seek(fp, offset + dir_start, SEEK_SET) != 0) {
-                fprintf(stderr, "Error: Cannot seek to IFD start.\n");
-                free_tiff_dir_and_entries(tiff_dir, entries, entry);
-                return NULL;
-            }
-        }
-
-        if (big_tiff || ndpi) {
-            // big tiff or ndpi offset pointer reserves 8 bytes
-            memcpy(&entry->offset, value, 8);
-            fix_byte_order(&entry->offset, sizeof(entry->offset), 1, big_endian);
-        } else {
-            // non big tiff offset only reserves 4 bytes
-            uint32_t offset32;
-            memcpy(&offset32, value, 4);
-            fix_byte_order(&offset32, sizeof(offset32), 1, big_endian);
-            entry->offset = offset32;
         }
 
-        entries[i] = *entry;
-        free(entry);
+        // big tiff or ndpi offset pointer reserves 8 bytes,
+        // non big tiff offset only reserves 4 bytes
+        entry->offset = decode_uint(value, (big_tiff || ndpi) ? 8 : 4, big_endian);
     }
 
     // get the directory offset of the successor
-    uint64_t next_dir_offset = file_tell(fp) + (big_tiff ? 8 : 2);
-
+    uint64_t next_pointer = entries_start + entries_size;
     tiff_dir->entries = entries;
-    tiff_dir->out_pointer_offset = next_dir_offset;
-    *dir_offset = read_uint(fp, (big_tiff || ndpi) ? 8 : 4, big_endian);
+    tiff_dir->out_pointer_offset = next_pointer + (big_tiff ? 8 : 2);
+    if (bytes_read >= entries_size + next_pointer_size) {
+        *dir_offset = decode_uint(block + entries_size, next_pointer_size, big_endian);
+    }
+    free(block);
+
+    // leave the stream just behind the successor offset
+    if (file_seek(fp, next_pointer + next_pointer_size, SEEK_SET) != 0) {
+        fprintf(stderr, "Error: Cannot seek to IFD end.\n");
+        return NULL;
+    }
 
     return tiff_dir;
 }
@@ -275,257 +491,463 @@ int32_t check_file_header(file_handle *fp, bool *big_endian, bool *big_tiff) {
     return result;
 }
 
-// read the tiff file structure with offsets from the file stream
-struct tiff_file *read_tiff_file(file_handle *fp, bool big_tiff, bool ndpi, bool big_endian) {
+// start reading the tiff file structure from the file stream. only the offset of the first
+// directory is read, directories are read on demand with read_next_tiff_directory
+struct tiff_file *open_tiff_file(file_handle *fp, bool big_tiff, bool ndpi, bool big_endian) {
     // get directory offset; file stream pointer must be located just
     // before the directory offset
     uint64_t in_pointer_offset = file_tell(fp);
     uint64_t diroff = read_uint(fp, (big_tiff || ndpi) ? 8 : 4, big_endian);
-    // reading the initial directory
-    struct tiff_directory *dir = read_tiff_directory(fp, &diroff, &in_pointer_offset, big_tiff, ndpi, big_endian);
-
-    if (dir == NULL) {
+    if (diroff == 0) {
         fprintf(stderr, "Error: Failed reading directory.\n");
         return NULL;
     }
 
     struct tiff_file *file = (struct tiff_file *)malloc(sizeof(struct tiff_file));
-    // initialize tiff file and add first directory
+    // initialize tiff file, directories are added from its arena
     init_tiff_file(file, 1);
-    insert_dir_into_tiff_file(file, dir);
+    file->big_tiff = big_tiff;
+    file->big_endian = big_endian;
+    file->ndpi = ndpi;
+    file->next_dir_offset = diroff;
+    file->next_in_pointer_offset = in_pointer_offset;
+    return file;
+}
 
+// read the next directory of the chain and add it to the tiff file. returns 1 if a
+// directory was read, 0 if the chain has ended and -1 if reading failed
+int32_t read_next_tiff_directory(file_handle *fp, struct tiff_file *file) {
     // when the directory offset is 0 we reached the end of the tiff file
-    while (diroff != 0) {
-        uint64_t current_in_pointer_offset = file_tell(fp) - 8;
-        struct tiff_directory *current_dir =
-            read_tiff_directory(fp, &diroff, &current_in_pointer_offset, big_tiff, ndpi, big_endian);
-
-        if (current_dir == NULL) {
-            fprintf(stderr, "Error: Failed reading directory.\n");
-            free(current_dir);
-            return NULL;
-        }
-        insert_dir_into_tiff_file(file, current_dir);
+    if (file->next_dir_offset == 0) {
+        return 0;
+    }
+
+    uint64_t in_pointer_offset = file->next_in_pointer_offset;
+    struct tiff_directory *dir = read_tiff_directory(fp, &file->arena, &file->next_dir_offset, &in_pointer_offset,
+                                                     file->big_tiff, file->ndpi, file->big_endian);
+    if (dir == NULL) {
+        fprintf(stderr, "Error: Failed reading directory.\n");
+        return -1;
     }
+    // the stream is located behind the pointer to the successor
+    file->next_in_pointer_offset = file_tell(fp) - ((file->big_tiff || file->ndpi) ? 8 : 4);
+    insert_dir_into_tiff_file(file, dir);
+    return 1;
+}
+
+// read all directories of the chain that are not read yet
+int32_t read_remaining_tiff_directories(file_handle *fp, struct tiff_file *file) {
+    int32_t result;
+    do {
+        result = read_next_tiff_directory(fp, file);
+    } while (result == 1);
+    return result;
+}
 
+// read the tiff file structure with offsets from the file stream
+struct tiff_file *read_tiff_file(file_handle *fp, bool big_tiff, bool ndpi, bool big_endian) {
+    struct tiff_file *file = open_tiff_file(fp, big_tiff, ndpi, big_endian);
+    if (file == NULL) {
+        return NULL;
+    }
+    if (read_remaining_tiff_directories(fp, file) != 0) {
+        free_tiff_file(file);
+        return NULL;
+    }
+    build_tag_index(file);
     return file;
 }
 
-// check the head of the directory offset for a given prefix. if the head is not equal to the given
-// prefix the label/macro image is not wiped
-int32_t check_prefix(file_handle *fp, const char *prefix) {
-    size_t prefix_len = strlen(prefix);
-    char *buf = (char *)malloc(prefix_len + 1);
-    buf[prefix_len] = '\0';
+// start reading the tiff file structure at the file header, see open_tiff_file
+struct tiff_file *open_tiff_file_with_header(file_handle *fp, bool ndpi) {
+    bool big_tiff = false;
+    bool big_endian = false;
+    if (file_seek(fp, 0, SEEK_SET) != 0 || check_file_header(fp, &big_endian, &big_tiff) != 0) {
+        return NULL;
+    }
+    return open_tiff_file(fp, big_tiff, ndpi, big_endian);
+}
 
-    if (file_read(buf, prefix_len, 1, fp) != 1) {
-        fprintf(stderr, "Error: Could not read strip prefix.\n");
+// read the tiff file structure starting at the file header
+struct tiff_file *read_tiff_file_with_header(file_handle *fp, bool ndpi) {
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_PARSE);
+    bool big_tiff = false;
+    bool big_endian = false;
+    struct tiff_file *file = NULL;
+    if (file_seek(fp, 0, SEEK_SET) == 0 && check_file_header(fp, &big_endian, &big_tiff) == 0) {
+        file = read_tiff_file(fp, big_tiff, ndpi, big_endian);
+    }
+    stats_leave_phase(phase);
+    return file;
+}
+
+// submit the reads of the heads of the strips in one batch without waiting for them. the returned
+// buffer receives the heads and is passed to reap_prefix_reads together with the requests.
+// returns NULL if the reads could not be submitted
+char *submit_prefix_reads(file_handle *fp, const uint64_t *strip_offsets, int32_t count, const char *prefix,
+                          struct file_io_request **requests) {
+    size_t prefix_len = strlen(prefix);
+    char *buf = (char *)malloc(count * prefix_len + 1);
+    *requests = (struct file_io_request *)malloc((count + 1) * sizeof(struct file_io_request));
+    if (buf == NULL || *requests == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for strip prefixes.\n");
         free(buf);
-        return -1;
+        free(*requests);
+        return NULL;
     }
 
-    if (strcmp(prefix, buf) != 0) {
-        fprintf(stderr, "Error: Prefix in data strip not found.\n");
+    for (int32_t i = 0; i < count; i++) {
+        (*requests)[i].offset = strip_offsets[i];
+        (*requests)[i].buffer = buf + i * prefix_len;
+        (*requests)[i].length = prefix_len;
+        (*requests)[i].write = false;
+    }
+    if (file_submit_requests(fp, *requests, count) != 0) {
         free(buf);
-        return -1;
+        free(*requests);
+        return NULL;
     }
-    free(buf);
-    return 0;
+    return buf;
 }
 
-int32_t wipe_directory(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, bool big_tiff,
-                       const char *prefix, const char *suffix) {
-    int32_t size_offsets;
-    int32_t size_lengths;
-    // gather strip offsets and lengths form tiff directory
-    if (big_tiff) {
-        uint64_t *strip_offsets = read_pointer64_by_tag(fp, dir, TIFFTAG_STRIPOFFSETS, ndpi, big_endian, &size_offsets);
-        uint64_t *strip_lengths =
-            read_pointer64_by_tag(fp, dir, TIFFTAG_STRIPBYTECOUNTS, ndpi, big_endian, &size_lengths);
+// wait for the heads submitted by submit_prefix_reads and compare them with the prefix. if a head is
+// not equal to the given prefix the strip is not wiped. frees the buffer and the requests and returns
+// the number of leading strips with prefix
+int32_t reap_prefix_reads(file_handle *fp, int32_t count, const char *prefix, char *buffer,
+                          struct file_io_request *requests) {
+    size_t prefix_len = strlen(prefix);
+    file_reap_requests(fp);
 
-        if (strip_offsets == NULL || strip_lengths == NULL) {
-            fprintf(stderr, "Error: Could not retrieve strip offset and length.\n");
-            return -1;
+    int32_t valid = 0;
+    for (; valid < count; valid++) {
+        if (requests[valid].result != prefix_len) {
+            fprintf(stderr, "Error: Could not read strip prefix.\n");
+            break;
+        }
+        if (memcmp(prefix, buffer + valid * prefix_len, prefix_len) != 0) {
+            fprintf(stderr, "Error: Prefix in data strip not found.\n");
+            break;
         }
+    }
+    free(buffer);
+    free(requests);
+    return valid;
+}
 
-        if (size_offsets != size_lengths) {
-            fprintf(stderr, "Error: Length of strip offsets and lengths are not matching.\n");
-            free(strip_offsets);
-            free(strip_lengths);
+// check the heads of the strips for a given prefix, all heads are read in one batch.
+// returns the number of leading strips with prefix
+int32_t check_prefixes(file_handle *fp, const uint64_t *strip_offsets, int32_t count, const char *prefix) {
+    struct file_io_request *requests;
+    char *buffer = submit_prefix_reads(fp, strip_offsets, count, prefix, &requests);
+    if (buffer == NULL) {
+        return 0;
+    }
+    return reap_prefix_reads(fp, count, prefix, buffer, requests);
+}
+
+// overwrite the strips with prefix, zeros and suffix. the heads of the strips are read while
+// the writes are prepared, then the writes of all strips are submitted in one batch. strips
+// following a strip without the expected prefix are left untouched
+int32_t wipe_strips(file_handle *fp, const uint64_t *strip_offsets, const uint64_t *strip_lengths, int32_t count,
+                    const char *prefix, const char *suffix) {
+    int32_t result = 0;
+    char *prefix_buffer = NULL;
+    struct file_io_request *prefix_requests = NULL;
+    if (prefix != NULL) {
+        prefix_buffer = submit_prefix_reads(fp, strip_offsets, count, prefix, &prefix_requests);
+        if (prefix_buffer == NULL) {
             return -1;
         }
+    }
 
-        for (int32_t i = 0; i < size_offsets; i++) {
-            file_seek(fp, strip_offsets[i], SEEK_SET);
+    // one fill buffer is shared by all strips
+    uint64_t max_length = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (strip_lengths[i] > max_length) {
+            max_length = strip_lengths[i];
+        }
+    }
+    size_t buffer_size;
+    // fill strip with zeros
+    // ToDo: check if writing 0's is sufficient
+    char *fill_buffer = create_fill_buffer('0', max_length, &buffer_size);
+
+    // each strip takes a prefix, a suffix and as many chunks as needed to fill the rest
+    size_t num_requests = 0;
+    for (int32_t i = 0; fill_buffer != NULL && i < count; i++) {
+        num_requests += 2 + strip_lengths[i] / buffer_size + 1;
+    }
+    struct file_io_request *requests =
+        (struct file_io_request *)malloc((num_requests + 1) * sizeof(struct file_io_request));
+    // index of the first request of each strip
+    size_t *first_requests = (size_t *)malloc((count + 1) * sizeof(size_t));
+    if (fill_buffer == NULL || requests == NULL || first_requests == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for write requests.\n");
+        if (prefix != NULL) {
+            // the buffers of the heads are released once they are read
+            reap_prefix_reads(fp, count, prefix, prefix_buffer, prefix_requests);
+        }
+        free(fill_buffer);
+        free(requests);
+        free(first_requests);
+        return -1;
+    }
 
-            if (prefix != NULL) {
-                if (check_prefix(fp, prefix) != 0) {
-                    free(strip_offsets);
-                    free(strip_lengths);
-                    return -1;
-                }
-                file_seek(fp, strip_offsets[i], SEEK_SET);
-            }
+    size_t prefix_len = prefix != NULL ? strlen(prefix) : 0;
+    size_t suffix_len = suffix != NULL ? strlen(suffix) : 0;
+    num_requests = 0;
+    for (int32_t i = 0; i < count; i++) {
+        uint64_t offset = strip_offsets[i];
+        uint64_t length = strip_lengths[i];
+        uint64_t strip_prefix_len = prefix_len < length ? prefix_len : length;
+        uint64_t strip_suffix_len = suffix_len < length - strip_prefix_len ? suffix_len : length - strip_prefix_len;
+
+        first_requests[i] = num_requests;
+        struct file_io_request request = {offset, (void *)prefix, strip_prefix_len, true, 0};
+        if (strip_prefix_len > 0) {
+            requests[num_requests++] = request;
+        }
+        offset += strip_prefix_len;
+        for (uint64_t remaining = length - strip_prefix_len - strip_suffix_len; remaining > 0;) {
+            request.offset = offset;
+            request.buffer = fill_buffer;
+            request.length = remaining < buffer_size ? remaining : buffer_size;
+            requests[num_requests++] = request;
+            offset += request.length;
+            remaining -= request.length;
+        }
+        if (strip_suffix_len > 0) {
+            request.offset = offset;
+            request.buffer = (void *)suffix;
+            request.length = strip_suffix_len;
+            requests[num_requests++] = request;
+        }
+    }
 
-            // fill strip with zeros
-            // ToDo: check if writing 0's is sufficient
-            char *strip = create_pre_suffixed_char_array('0', strip_lengths[i], prefix, suffix);
-            if (!file_write(strip, 1, strip_lengths[i], fp)) {
-                fprintf(stderr, "Error: Wiping image data failed.\n");
-                free(strip_offsets);
-                free(strip_lengths);
-                free(strip);
-                return -1;
-            }
-            free(strip);
+    // the heads have to be read before any strip is overwritten
+    if (prefix != NULL) {
+        int32_t valid = reap_prefix_reads(fp, count, prefix, prefix_buffer, prefix_requests);
+        if (valid < count) {
+            result = -1;
+            num_requests = first_requests[valid];
         }
-        free(strip_offsets);
-        free(strip_lengths);
-        return 0;
+    }
+
+    if (file_submit_requests(fp, requests, num_requests) != 0 || file_reap_requests(fp) != 0) {
+        fprintf(stderr, "Error: Wiping image data failed.\n");
+        result = -1;
+    }
+    free(first_requests);
+    free(requests);
+    free(fill_buffer);
+    return result;
+}
+
+// widen 32 bit values to 64 bit, the given values are freed
+static uint64_t *widen_values(uint32_t *values, int32_t count) {
+    uint64_t *widened = values != NULL ? (uint64_t *)malloc(count * sizeof(uint64_t) + 1) : NULL;
+    for (int32_t i = 0; widened != NULL && i < count; i++) {
+        widened[i] = values[i];
+    }
+    free(values);
+    return widened;
+}
+
+// read the strip offsets and lengths of a directory in one batch, 32 bit values are
+// widened so that classic and big tiff files share the wiping code
+int32_t read_strips(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, bool big_tiff,
+                    uint64_t **strip_offsets, uint64_t **strip_lengths, int32_t *count) {
+    struct tag_values values[2] = {{TIFFTAG_STRIPOFFSETS, NULL, 0}, {TIFFTAG_STRIPBYTECOUNTS, NULL, 0}};
+    read_values_by_tags(fp, dir, ndpi, big_endian, big_tiff ? sizeof(uint64_t) : sizeof(uint32_t), values, 2);
+    if (big_tiff) {
+        *strip_offsets = (uint64_t *)values[0].values;
+        *strip_lengths = (uint64_t *)values[1].values;
     } else {
-        uint32_t *strip_offsets = read_pointer32_by_tag(fp, dir, TIFFTAG_STRIPOFFSETS, ndpi, big_endian, &size_offsets);
-        uint32_t *strip_lengths =
-            read_pointer32_by_tag(fp, dir, TIFFTAG_STRIPBYTECOUNTS, ndpi, big_endian, &size_lengths);
+        *strip_offsets = widen_values((uint32_t *)values[0].values, values[0].length);
+        *strip_lengths = widen_values((uint32_t *)values[1].values, values[1].length);
+    }
+    int32_t size_offsets = values[0].length;
+    int32_t size_lengths = values[1].length;
 
-        if (strip_offsets == NULL || strip_lengths == NULL) {
-            fprintf(stderr, "Error: Could not retrieve strip offset and length.\n");
-            return -1;
-        }
+    if (*strip_offsets == NULL || *strip_lengths == NULL) {
+        fprintf(stderr, "Error: Could not retrieve strip offset and length.\n");
+        free(*strip_offsets);
+        free(*strip_lengths);
+        return -1;
+    }
 
-        if (size_offsets != size_lengths) {
-            fprintf(stderr, "Error: Length of strip offsets and lengths are not matching.\n");
+    if (size_offsets != size_lengths) {
+        fprintf(stderr, "Error: Length of strip offsets and lengths are not matching.\n");
+        free(*strip_offsets);
+        free(*strip_lengths);
+        return -1;
+    }
+    *count = size_offsets;
+    return 0;
+}
+
+int32_t wipe_directory(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, bool big_tiff,
+                       const char *prefix, const char *suffix) {
+    uint64_t *strip_offsets;
+    uint64_t *strip_lengths;
+    int32_t count;
+    // gather strip offsets and lengths form tiff directory
+    if (read_strips(fp, dir, ndpi, big_endian, big_tiff, &strip_offsets, &strip_lengths, &count) != 0) {
+        return -1;
+    }
+
+    // Fix NDPI offset in case file is larger than 4GB
+    // convert to uint64, add high bits of ndpi dir to UINT32_MAX
+    // add the strip offset to this in order to get the actual offset
+    if (!big_tiff && ndpi) {
+        int64_t current_pos = file_tell(fp);
+        if (file_seek(fp, 0, SEEK_END) != 0) {
+            fprintf(stderr, "Error: Could not determine file size.\n");
             free(strip_offsets);
             free(strip_lengths);
             return -1;
         }
+        int64_t size = file_tell(fp);
+        file_seek(fp, current_pos, SEEK_SET);
+        for (int32_t i = 0; size > UINT32_MAX && i < count; i++) {
+            strip_offsets[i] += (uint64_t)UINT32_MAX + dir->ndpi_high_bits;
+        }
+    }
 
-        for (int32_t i = 0; i < size_offsets; i++) {
+    // strips without prefix and suffix are all filled alike,
+    // so adjacent strips are written at once
+    if (prefix == NULL && suffix == NULL) {
+        count = merge_ranges(strip_offsets, strip_lengths, count);
+    }
 
-            uint64_t new_offset = strip_offsets[i];
+    int32_t result = wipe_strips(fp, strip_offsets, strip_lengths, count, prefix, suffix);
+    free(strip_offsets);
+    free(strip_lengths);
+    return result;
+}
 
-            // Fix NDPI offset in case file is larger than 4GB
-            // convert to uint64, add high bits of ndpi dir to UINT32_MAX
-            // add the strip offset to this in order to get the actual offset
-            int64_t current_pos = file_tell(fp);
-            file_seek(fp, 0, SEEK_END);
-            int64_t size = file_tell(fp);
-            file_seek(fp, current_pos, SEEK_SET);
-            if (ndpi && (size > UINT32_MAX)) {
-                new_offset = ((uint64_t)UINT32_MAX + dir->ndpi_high_bits) + (uint64_t)strip_offsets[i];
-            }
+// find the first entry with the given tag in a directory and return its index
+// or -1. the tags are kept in an array of their own and compared eight at once
+int64_t find_entry_by_tag(const struct tiff_directory *dir, uint16_t tag) {
+    uint32_t i = 0;
+#if defined(__SSE2__)
+    __m128i needle = _mm_set1_epi16((int16_t)tag);
+    for (; i + 8 <= dir->count; i += 8) {
+        __m128i tags = _mm_loadu_si128((const __m128i *)&dir->tags[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(tags, needle)) != 0) {
+            break;
+        }
+    }
+#elif defined(__ARM_NEON)
+    uint16x8_t needle = vdupq_n_u16(tag);
+    for (; i + 8 <= dir->count; i += 8) {
+        uint8x8_t matches = vmovn_u16(vceqq_u16(vld1q_u16(&dir->tags[i]), needle));
+        if (vget_lane_u64(vreinterpret_u64_u8(matches), 0) != 0) {
+            break;
+        }
+    }
+#endif
+    // the remaining tags or the block containing the match
+    for (; i < dir->count; i++) {
+        if (dir->tags[i] == tag) {
+            return i;
+        }
+    }
+    return -1;
+}
 
-            file_seek(fp, new_offset, SEEK_SET);
+// read the values of several entries of a directory by tiff tag, the values that do not fit into
+// their entries are read in one batch. a single value is taken from the entry and stored with
+// value_size bytes. the values have to be freed, they are NULL for missing or unreadable entries
+void read_values_by_tags(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, int32_t value_size,
+                         struct tag_values *values, int32_t count) {
+    struct file_io_request *requests = (struct file_io_request *)malloc((count + 1) * sizeof(struct file_io_request));
+    int32_t *entry_sizes = (int32_t *)malloc((count + 1) * sizeof(int32_t));
+    int32_t *targets = (int32_t *)malloc((count + 1) * sizeof(int32_t));
+    for (int32_t i = 0; i < count; i++) {
+        values[i].values = NULL;
+        values[i].length = 0;
+    }
+    if (requests == NULL || entry_sizes == NULL || targets == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for entry values.\n");
+        free(requests);
+        free(entry_sizes);
+        free(targets);
+        return;
+    }
 
-            if (prefix != NULL) {
-                if (check_prefix(fp, prefix) != 0) {
-                    free(strip_offsets);
-                    free(strip_lengths);
-                    return -1;
-                }
-                file_seek(fp, new_offset, SEEK_SET);
-            }
+    int32_t num_requests = 0;
+    for (int32_t i = 0; i < count; i++) {
+        int64_t index = find_entry_by_tag(dir, values[i].tag);
+        if (index < 0) {
+            continue;
+        }
+        struct tiff_entry entry = dir->entries[index];
+        int32_t entry_size = get_size_of_value(entry.type, &entry.count);
+        if (!entry_size) {
+            continue;
+        }
 
-            // fill strip with zeros
-            // ToDo: check if writing 0's is sufficient
-            char *strip = create_pre_suffixed_char_array('0', strip_lengths[i], prefix, suffix);
-            if (!file_write(strip, 1, strip_lengths[i], fp)) {
-                fprintf(stderr, "Error: Wiping image data failed.\n");
-                free(strip_offsets);
-                free(strip_lengths);
-                free(strip);
-                return -1;
+        size_t size = (size_t)entry_size * entry.count;
+        void *buffer = malloc(size > (size_t)value_size ? size : (size_t)value_size);
+        if (buffer == NULL) {
+            continue;
+        }
+        values[i].values = buffer;
+        values[i].length = entry.count;
+
+        if (entry.count == 1) {
+            if (value_size == sizeof(uint64_t)) {
+                *(uint64_t *)buffer = entry.offset;
+            } else {
+                *(uint32_t *)buffer = entry.offset;
             }
-            free(strip);
+            continue;
         }
-        free(strip_offsets);
-        free(strip_lengths);
+
+        struct file_io_request request = {ndpi ? entry.start + 8 : entry.offset, buffer, size, false, 0};
+        requests[num_requests] = request;
+        entry_sizes[num_requests] = entry_size;
+        targets[num_requests++] = i;
     }
-    return 0;
+
+    file_submit_batch(fp, requests, num_requests);
+    for (int32_t k = 0; k < num_requests; k++) {
+        struct tag_values *target = &values[targets[k]];
+        if (requests[k].result != requests[k].length) {
+            fprintf(stderr, "Error: Failed to read entry value.\n");
+            free(target->values);
+            target->values = NULL;
+            target->length = 0;
+            continue;
+        }
+        fix_byte_order(target->values, entry_sizes[k], target->length, big_endian);
+    }
+    free(requests);
+    free(entry_sizes);
+    free(targets);
 }
 
 // read a 32-bit pointer from the directory entries by tiff tag
 uint32_t *read_pointer32_by_tag(file_handle *fp, struct tiff_directory *dir, int32_t tag, bool ndpi, bool big_endian,
                                 int32_t *length) {
-    for (uint64_t i = 0; i < dir->count; i++) {
-        struct tiff_entry entry = dir->entries[i];
-        if (entry.tag == tag) {
-            int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-            if (entry_size) {
-                uint32_t *v_buffer = (uint32_t *)malloc(entry_size * entry.count);
-
-                if (entry.count == 1) {
-                    *length = entry.count;
-                    v_buffer[0] = entry.offset;
-                    return v_buffer;
-                }
-
-                uint64_t new_offset = entry.offset;
-
-                if (ndpi) {
-                    new_offset = entry.start + 8;
-                }
-
-                if (file_seek(fp, new_offset, SEEK_SET)) {
-                    fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", entry.offset);
-                    continue;
-                }
-                if (file_read(v_buffer, entry_size, entry.count, fp) < 1) {
-                    fprintf(stderr, "Error: Failed to read entry value.\n");
-                    continue;
-                }
-
-                fix_byte_order(v_buffer, entry_size, entry.count, big_endian);
-                *length = entry.count;
-
-                return v_buffer;
-            }
-        }
+    struct tag_values values = {tag, NULL, 0};
+    read_values_by_tags(fp, dir, ndpi, big_endian, sizeof(uint32_t), &values, 1);
+    if (values.values != NULL) {
+        *length = values.length;
     }
-    return NULL;
+    return (uint32_t *)values.values;
 }
 
 // read a 64-bit pointer from the directory entries by tiff tag
 uint64_t *read_pointer64_by_tag(file_handle *fp, struct tiff_directory *dir, int32_t tag, bool ndpi, bool big_endian,
                                 int32_t *length) {
-    for (uint64_t i = 0; i < dir->count; i++) {
-        struct tiff_entry entry = dir->entries[i];
-        if (entry.tag == tag) {
-            int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-            if (entry_size) {
-                uint64_t *v_buffer = (uint64_t *)malloc(entry_size * entry.count);
-
-                if (entry.count == 1) {
-                    *length = entry.count;
-                    v_buffer[0] = entry.offset;
-                    return v_buffer;
-                }
-
-                uint64_t new_offset = entry.offset;
-
-                if (ndpi) {
-                    new_offset = entry.start + 8;
-                }
-
-                if (file_seek(fp, new_offset, SEEK_SET)) {
-                    fprintf(stderr, "Error: Failed to seek to offset %" PRIu64 ".\n", entry.offset);
-                    continue;
-                }
-                if (file_read(v_buffer, entry_size, entry.count, fp) < 1) {
-                    fprintf(stderr, "Error: Failed to read entry value.\n");
-                    continue;
-                }
-
-                fix_byte_order(v_buffer, entry_size, entry.count, big_endian);
-                *length = entry.count;
-
-                return v_buffer;
-            }
-        }
+    struct tag_values values = {tag, NULL, 0};
+    read_values_by_tags(fp, dir, ndpi, big_endian, sizeof(uint64_t), &values, 1);
+    if (values.values != NULL) {
+        *length = values.length;
     }
-
-    return NULL;
+    return (uint64_t *)values.values;
 }
 
 int32_t unlink_directory(file_handle *fp, struct tiff_file *file, int32_t current_dir, bool is_ndpi) {
@@ -534,34 +956,33 @@ int32_t unlink_directory(file_handle *fp, struct tiff_file *file, int32_t curren
         return -1;
     }
 
-    struct tiff_directory dir = file->directories[current_dir];
-    struct tiff_directory successor = file->directories[current_dir + 1];
+    // the successor may not be read yet
+    if ((uint32_t)current_dir + 1 >= file->used && read_next_tiff_directory(fp, file) < 0) {
+        return -1;
+    }
 
-    if (!is_ndpi && successor.count == 0 && successor.in_pointer_offset == 0) {
-        // current directory is the last in file
-        // search to out pointer of current dir
-        if (file_seek(fp, dir.out_pointer_offset, SEEK_SET)) {
-            fprintf(stderr, "Error: Failed to seek to offset.\n");
-            return -1;
-        }
-        // overwrite out pointer with 0 to end file
-        uint64_t new_pointer_address[1];
-        new_pointer_address[0] = 0x0;
-        if (file_write(new_pointer_address, sizeof(uint64_t), 1, fp) != 1) {
-            fprintf(stderr, "Error: Failed to write directory out pointer \
-                        to null at pointer position.\n");
+    struct tiff_directory dir = file->directories[current_dir];
+    // pointers to directories have 8 bytes in big tiff and ndpi files and 4 bytes otherwise
+    size_t pointer_size = (file->big_tiff || is_ndpi) ? 8 : 4;
+    uint8_t new_pointer[8] = {0};
+
+    if ((uint32_t)current_dir + 1 >= file->used) {
+        // the last directory has no successor, so the predecessor becomes the last directory
+        if (file_seek(fp, dir.in_pointer_offset, SEEK_SET) || file_write(new_pointer, pointer_size, 1, fp) != 1) {
+            fprintf(stderr, "Error: Failed to write directory in pointer of predecessor.\n");
             return -1;
         }
         return 0;
     }
 
+    struct tiff_directory successor = file->directories[current_dir + 1];
+
     // current directory has a successor
     if (file_seek(fp, successor.in_pointer_offset, SEEK_SET)) {
         fprintf(stderr, "Error: Failed to seek to offset.\n");
         return -1;
     }
-    uint64_t new_pointer_address[1];
-    if (file_read(&new_pointer_address, sizeof(uint64_t), 1, fp) != 1) {
+    if (file_read(new_pointer, pointer_size, 1, fp) != 1) {
         fprintf(stderr, "Error: Failed to read pointer.\n");
         return -1;
     }
@@ -569,7 +990,7 @@ int32_t unlink_directory(file_handle *fp, struct tiff_file *file, int32_t curren
         fprintf(stderr, "Error: Failed to seek to offset.\n");
         return -1;
     }
-    if (file_write(new_pointer_address, sizeof(uint64_t), 1, fp) != 1) {
+    if (file_write(new_pointer, pointer_size, 1, fp) != 1) {
         fprintf(stderr, "Error: Failed to write directory in pointer \
                     to predecessor at pointer position.\n");
         return -1;
@@ -579,79 +1000,69 @@ int32_t unlink_directory(file_handle *fp, struct tiff_file *file, int32_t curren
 }
 
 int32_t get_aperio_gt450_dir_by_name(struct tiff_file *file, const char *dir_name) {
-    for (uint64_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        // printf("--directory %i\n", i);
-        for (uint64_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            if (entry.tag == TIFFTAG_SUBFILETYPE) {
-                if (entry.offset == 0) { // thumbnail or else
-                    break;               // skip IFD
-                }
-
-                if ((strcmp(dir_name, LABEL) == 0 && entry.offset == 1) ||
-                    (strcmp(dir_name, MACRO) == 0 && entry.offset == 9)) {
-                    return i;
-                }
+    uint64_t num_references;
+    const struct tiff_tag_reference *references = find_tag_references(file, TIFFTAG_SUBFILETYPE, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        struct tiff_entry entry = *get_entry_of_reference(file, &references[k]);
+        if (entry.offset == 0) { // thumbnail or else
+            // skip IFD
+            while (k + 1 < num_references && references[k + 1].dir == references[k].dir) {
+                k++;
             }
+            continue;
+        }
+
+        if ((strcmp(dir_name, LABEL) == 0 && entry.offset == 1) ||
+            (strcmp(dir_name, MACRO) == 0 && entry.offset == 9)) {
+            return references[k].dir;
         }
     }
     return -1;
 }
 
-int32_t tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag, const char *contains_value) {
-    for (uint64_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint64_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            if (entry.tag == tag) {
-                // get requested image tag from file
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                char *buffer = malloc(entry_size * entry.count);
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read image tag %" PRId32 ".\n", tag);
-                    free(buffer);
-                    return -1;
-                }
-                // check if tag value contains given string
-                if (contains(buffer, contains_value)) {
-                    free(buffer);
-                    return 1;
-                }
-                free(buffer);
-            }
+// find the first directory with a value of the tag containing the given string. directories are
+// read on demand and only up to the match. if first_only is set, only the value of the first
+// directory with the tag is checked. returns -1 if there is no match and -2 on errors
+int64_t find_directory_by_tag_value(file_handle *fp, struct tiff_file *file, int32_t tag, const char *value,
+                                    bool first_only) {
+    if (!first_only) {
+        // the values of the directories read so far are read at once instead of one after another
+        read_tag_values(fp, file, tag);
+    }
+    for (uint32_t dir = 0; dir < file->used || read_next_tiff_directory(fp, file) == 1; dir++) {
+        const struct tiff_tag_reference *reference = find_tag_reference_in_directory(file, dir, tag);
+        if (reference == NULL) {
+            continue;
+        }
+
+        // get the tag value from file or cache
+        const char *buffer = get_tag_value(fp, file, reference);
+        if (buffer == NULL) {
+            fprintf(stderr, "Error: Could not read image tag %" PRId32 ".\n", tag);
+            return -2;
+        }
+
+        // check if value contains expected value and return directory
+        if (contains(buffer, value)) {
+            return dir;
+        } else if (first_only) {
+            return -1;
         }
     }
     return -1;
 }
 
+int32_t tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag, const char *contains_value) {
+    return find_directory_by_tag_value(fp, file, tag, contains_value, false) >= 0 ? 1 : -1;
+}
+
+// check the value of the tag in the first directory with the tag, e.g. to probe a format
+// without reading the whole file structure
+int32_t first_tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag, const char *contains_value) {
+    return find_directory_by_tag_value(fp, file, tag, contains_value, true) >= 0 ? 1 : -1;
+}
+
 int32_t get_directory_by_tag_and_value(file_handle *fp, struct tiff_file *file, int32_t tag, const char *value) {
-    for (uint64_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint64_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            if (entry.tag == tag) {
-                // get the tag value from file
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                char *buffer = malloc(entry_size * entry.count);
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read image tag %" PRId32 ".\n", tag);
-                    free(buffer);
-                    return -1;
-                }
-
-                // check if value contains expected value and return directory
-                if (contains(buffer, value)) {
-                    free(buffer);
-                    return i;
-                }
-                free(buffer);
-            }
-        }
-    }
-    return -1;
+    int64_t dir = find_directory_by_tag_value(fp, file, tag, value, false);
+    return dir >= 0 ? (int32_t)dir : -1;
 }
@@ -5,6 +5,12 @@
 #include "utils.h"
 #include <inttypes.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 static const char TIF[] = "tif";
 static const char DOT_TIF[] = ".tif";
 
@@ -21,28 +27,75 @@ void insert_dir_into_tiff_file(struct tiff_file *file, struct tiff_directory *di
 
 void free_tiff_file(struct tiff_file *file);
 
+int32_t build_tag_index(struct tiff_file *file);
+
+const struct tiff_tag_reference *find_tag_references(struct tiff_file *file, uint16_t tag, uint64_t *count);
+
+const struct tiff_tag_reference *find_tag_reference_in_directory(struct tiff_file *file, uint32_t dir, uint16_t tag);
+
+struct tiff_entry *get_entry_of_reference(struct tiff_file *file, const struct tiff_tag_reference *reference);
+
+void free_tag_index(struct tiff_file *file);
+
+uint64_t get_length_of_value(struct tiff_entry entry);
+
+const char *get_tag_value(file_handle *fp, struct tiff_file *file, const struct tiff_tag_reference *reference);
+
+void read_tag_values(file_handle *fp, struct tiff_file *file, uint16_t tag);
+
+char *copy_tag_value(file_handle *fp, struct tiff_file *file, const struct tiff_tag_reference *reference);
+
+void invalidate_tag_values(struct tiff_file *file, uint64_t offset, uint64_t length);
+
 void fix_byte_order(void *data, int32_t size, int64_t count, bool big_endian);
 
+uint64_t decode_uint(const uint8_t *buffer, int32_t size, bool big_endian);
+
 uint64_t read_uint(file_handle *fp, int32_t size, bool big_endian);
 
 uint32_t get_size_of_value(uint16_t type, uint32_t *count);
 
 uint64_t fix_ndpi_offset(uint64_t directory_offset, uint64_t offset);
 
-void free_tiff_dir_and_entries(struct tiff_directory *tiff_dir, struct tiff_entry *entries, struct tiff_entry *entry);
-
-struct tiff_directory *read_tiff_directory(file_handle *fp, uint64_t *dir_offset, uint64_t *in_pointer_offset,
-                                           bool big_tiff, bool ndpi, bool big_endian);
+struct tiff_directory *read_tiff_directory(file_handle *fp, struct arena *arena, uint64_t *dir_offset,
+                                           uint64_t *in_pointer_offset, bool big_tiff, bool ndpi, bool big_endian);
 
 int32_t check_file_header(file_handle *fp, bool *big_endian, bool *big_tiff);
 
+struct tiff_file *open_tiff_file(file_handle *fp, bool big_tiff, bool ndpi, bool big_endian);
+
+int32_t read_next_tiff_directory(file_handle *fp, struct tiff_file *file);
+
+int32_t read_remaining_tiff_directories(file_handle *fp, struct tiff_file *file);
+
 struct tiff_file *read_tiff_file(file_handle *fp, bool big_tiff, bool ndpi, bool big_endian);
 
-int32_t check_prefix(file_handle *fp, const char *prefix);
+struct tiff_file *open_tiff_file_with_header(file_handle *fp, bool ndpi);
+
+struct tiff_file *read_tiff_file_with_header(file_handle *fp, bool ndpi);
+
+char *submit_prefix_reads(file_handle *fp, const uint64_t *strip_offsets, int32_t count, const char *prefix,
+                          struct file_io_request **requests);
+
+int32_t reap_prefix_reads(file_handle *fp, int32_t count, const char *prefix, char *buffer,
+                          struct file_io_request *requests);
+
+int32_t check_prefixes(file_handle *fp, const uint64_t *strip_offsets, int32_t count, const char *prefix);
+
+int32_t wipe_strips(file_handle *fp, const uint64_t *strip_offsets, const uint64_t *strip_lengths, int32_t count,
+                    const char *prefix, const char *suffix);
+
+int32_t read_strips(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, bool big_tiff,
+                    uint64_t **strip_offsets, uint64_t **strip_lengths, int32_t *count);
 
 int32_t wipe_directory(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, bool big_tiff,
                        const char *prefix, const char *suffix);
 
+int64_t find_entry_by_tag(const struct tiff_directory *dir, uint16_t tag);
+
+void read_values_by_tags(file_handle *fp, struct tiff_directory *dir, bool ndpi, bool big_endian, int32_t value_size,
+                         struct tag_values *values, int32_t count);
+
 uint32_t *read_pointer32_by_tag(file_handle *fp, struct tiff_directory *dir, int32_t tag, bool ndpi, bool big_endian,
                                 int32_t *length);
 
@@ -53,8 +106,13 @@ int32_t unlink_directory(file_handle *fp, struct tiff_file *file, int32_t curren
 
 int32_t get_aperio_gt450_dir_by_name(struct tiff_file *file, const char *dir_name);
 
+int64_t find_directory_by_tag_value(file_handle *fp, struct tiff_file *file, int32_t tag, const char *value,
+                                    bool first_only);
+
 int32_t tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag, const char *contains_value);
 
+int32_t first_tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag, const char *contains_value);
+
 int32_t get_directory_by_tag_and_value(file_handle *fp, struct tiff_file *file, int32_t tag, const char *value);
 
 const char *duplicate_file(const char *filename, const char *new_label_name, const char *file_extension);
@@ -1,6 +1,27 @@
+#ifdef __linux__
+// needed for copy_file_range
+#define _GNU_SOURCE
+#endif
+
 #include "utils.h"
 #include <inttypes.h>
 
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#endif
+
+#include "stats-alloc.h"
+
 // split a string by a given delimiter
 char **str_split(char *a_str, const char a_delim) {
     char **result = 0;
@@ -32,12 +53,22 @@ char **str_split(char *a_str, const char a_delim) {
     if (result) {
         // fill result array
         size_t idx = 0;
-        char *token = strtok(a_str, delim);
+        // reentrant tokenizer, str_split may be called from several threads
+        char *saveptr = NULL;
+#if defined(_WIN32) || defined(_WIN64)
+        char *token = strtok_s(a_str, delim, &saveptr);
+#else
+        char *token = strtok_r(a_str, delim, &saveptr);
+#endif
 
         while (token) {
             assert(idx < count);
             *(result + idx++) = strdup(token);
-            token = strtok(0, delim);
+#if defined(_WIN32) || defined(_WIN64)
+            token = strtok_s(0, delim, &saveptr);
+#else
+            token = strtok_r(0, delim, &saveptr);
+#endif
         }
         assert(idx == count - 1);
         *(result + idx) = 0;
@@ -106,6 +137,163 @@ char *create_pre_suffixed_char_array(const char fill_character, uint64_t length,
     return result;
 }
 
+// create a buffer filled with the given character that is reused for wiping all
+// data up to max_length, larger data is written in chunks of WIPE_CHUNK_SIZE
+char *create_fill_buffer(const char fill_character, uint64_t max_length, size_t *buffer_size) {
+    *buffer_size = max_length < WIPE_CHUNK_SIZE ? (max_length > 0 ? max_length : 1) : WIPE_CHUNK_SIZE;
+    char *buffer = (char *)malloc(*buffer_size);
+    if (buffer == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for fill buffer.\n");
+        return NULL;
+    }
+    memset(buffer, fill_character, *buffer_size);
+    return buffer;
+}
+
+// overwrite length bytes at the current position with the prefix, the content
+// of the fill buffer and the suffix, like create_pre_suffixed_char_array would
+int32_t write_wiped_data(file_handle *fp, const char *fill_buffer, size_t buffer_size, uint64_t length,
+                         const char *prefix, const char *suffix) {
+    uint64_t prefix_length = prefix != NULL ? strlen(prefix) : 0;
+    uint64_t suffix_length = suffix != NULL ? strlen(suffix) : 0;
+    if (prefix_length > length) {
+        prefix_length = length;
+    }
+    if (suffix_length > length - prefix_length) {
+        suffix_length = length - prefix_length;
+    }
+
+    if (prefix_length > 0 && file_write(prefix, prefix_length, 1, fp) != 1) {
+        return -1;
+    }
+    for (uint64_t remaining = length - prefix_length - suffix_length; remaining > 0;) {
+        size_t chunk_size = remaining < buffer_size ? remaining : buffer_size;
+        if (file_write(fill_buffer, chunk_size, 1, fp) != 1) {
+            return -1;
+        }
+        remaining -= chunk_size;
+    }
+    if (suffix_length > 0 && file_write(suffix, suffix_length, 1, fp) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int32_t compare_ranges(const void *a, const void *b) {
+    const struct data_range *range_a = (const struct data_range *)a;
+    const struct data_range *range_b = (const struct data_range *)b;
+    return range_a->offset < range_b->offset ? -1 : range_a->offset > range_b->offset;
+}
+
+// sort the ranges given by offsets and lengths and merge adjacent or overlapping
+// ones in place, so that contiguous data is written at once. returns the new count
+int32_t merge_ranges(uint64_t *offsets, uint64_t *lengths, int32_t count) {
+    if (count <= 1) {
+        return count;
+    }
+    struct data_range *ranges = (struct data_range *)malloc(count * sizeof(struct data_range));
+    if (ranges == NULL) {
+        return count;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        ranges[i].offset = offsets[i];
+        ranges[i].length = lengths[i];
+    }
+    qsort(ranges, count, sizeof(struct data_range), compare_ranges);
+
+    int32_t merged_count = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (ranges[i].length == 0) {
+            continue;
+        }
+        uint64_t end = ranges[i].offset + ranges[i].length;
+        if (merged_count > 0 && ranges[i].offset <= offsets[merged_count - 1] + lengths[merged_count - 1]) {
+            uint64_t merged_end = offsets[merged_count - 1] + lengths[merged_count - 1];
+            if (end > merged_end) {
+                lengths[merged_count - 1] = end - offsets[merged_count - 1];
+            }
+        } else {
+            offsets[merged_count] = ranges[i].offset;
+            lengths[merged_count] = ranges[i].length;
+            merged_count++;
+        }
+    }
+    free(ranges);
+    return merged_count;
+}
+
+// state of the random generator for pseudonymized values, kept per thread
+// so that concurrent anonymizations neither share nor race on it
+static _Thread_local uint64_t random_state = 0;
+
+// the header of a block is padded, so that all allocations are aligned
+#define ARENA_HEADER_SIZE ((sizeof(struct arena_block) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// allocate memory from the arena. small allocations are taken from the current block,
+// large ones get a block of their own. the memory is only released by free_arena
+void *arena_alloc(struct arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    struct arena_block *block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE / 2 ? size : ARENA_BLOCK_SIZE;
+        struct arena_block *new_block = (struct arena_block *)malloc(ARENA_HEADER_SIZE + block_size);
+        if (new_block == NULL) {
+            fprintf(stderr, "Error: Could not allocate memory for arena.\n");
+            return NULL;
+        }
+        new_block->size = block_size;
+        new_block->used = 0;
+        if (block != NULL && block_size > ARENA_BLOCK_SIZE / 2) {
+            // keep allocating small structures from the current block
+            new_block->next = block->next;
+            block->next = new_block;
+        } else {
+            new_block->next = block;
+            arena->blocks = new_block;
+        }
+        block = new_block;
+    }
+    void *memory = (uint8_t *)block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    return memory;
+}
+
+void free_arena(struct arena *arena) {
+    struct arena_block *block = arena->blocks;
+    while (block != NULL) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+}
+
+// seed the random generator of the calling thread, 0 seeds it from the current time
+void seed_random(uint64_t seed) {
+    // splitmix64 step, spreads small seeds over the whole state
+    uint64_t z = seed + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    random_state = seed == 0 ? 0 : (z ^ (z >> 31)) | 1;
+}
+
+// state of the random generator of the calling thread, e.g. to restore it after a seeded anonymization
+uint64_t get_random_state() { return random_state; }
+
+void set_random_state(uint64_t state) { random_state = state; }
+
+// xorshift64* generator of the calling thread
+uint64_t next_random() {
+    if (random_state == 0) {
+        // threads seeded within the same second still differ by the address of their state
+        seed_random((uint64_t)time(NULL) ^ (uint64_t)(uintptr_t)&random_state);
+    }
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545f4914f6cdd1d;
+}
+
 char *create_random_string(uint64_t length) {
     if (length < 1) {
         fprintf(stderr, "Error: Length smaller 1.\n");
@@ -114,9 +302,8 @@ char *create_random_string(uint64_t length) {
 
     char *result = (char *)malloc(length + 1);
 
-    srand(time(NULL));
     for (int32_t start = 0; (uint64_t)start < length; start++) {
-        result[start] = *(int32_to_str(rand() % (9 - 1)));
+        result[start] = '0' + next_random() % (9 - 1);
     }
 
     result[length] = '\0';
@@ -370,50 +557,208 @@ const char *duplicate_file(const char *filename, const char *new_file_name, cons
     }
 }
 
-int32_t copy_file_v2(const char *src, const char *dest) {
-    char command[strlen(src) + strlen(dest) + 15];
+// get a monotonic timestamp in seconds
+double get_time_in_seconds() {
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 #ifdef __linux__
-    // we create the copy command for linux
-    snprintf(command, sizeof command, "cp \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
-#elif defined(__APPLE__) && defined(__MACH__)
-    // we create the copy command for MacOS
-    snprintf(command, sizeof command, "cp \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
-#elif _WIN32
-    // we create the copy command for win32
-    snprintf(command, sizeof command, "xcopy /Y \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
-#elif _WIN64
-    // we create the copy command for win64
-    snprintf(command, sizeof command, "xcopy /Y \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
+// copy the file content between descriptors inside of the kernel, either via
+// copy_file_range or via sendfile. returns 1 if the method is not supported
+int32_t copy_file_in_kernel(int32_t src_fd, int32_t dest_fd, uint64_t size, bool use_sendfile,
+                            struct copy_stats *stats) {
+    uint64_t copied = 0;
+    while (copied < size) {
+        size_t chunk_size = (size - copied) < COPY_KERNEL_CHUNK_SIZE ? (size - copied) : COPY_KERNEL_CHUNK_SIZE;
+        ssize_t bytes_copied = use_sendfile ? sendfile(dest_fd, src_fd, NULL, chunk_size)
+                                            : copy_file_range(src_fd, NULL, dest_fd, NULL, chunk_size, 0);
+        if (bytes_copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // nothing is copied yet, so the next method can be tried
+            return copied == 0 ? 1 : -1;
+        }
+        if (bytes_copied == 0) {
+            break;
+        }
+        copied += bytes_copied;
+    }
+    if (copied < size) {
+        // the copy is truncated, the next method can only be tried if nothing was copied yet
+        return copied == 0 ? 1 : -1;
+    }
+    stats->bytes_copied = copied;
+    stats->method = use_sendfile ? "sendfile" : "copy_file_range";
+    return 0;
+}
+
+// try to clone the file (reflink) or to copy it inside of the kernel. returns
+// 1 if none of the methods is supported for the given files
+int32_t copy_file_linux(const char *src, const char *dest, struct copy_stats *stats) {
+    int32_t src_fd = open(src, O_RDONLY);
+    if (src_fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(src_fd, &st) != 0) {
+        close(src_fd);
+        return -1;
+    }
+
+    int32_t dest_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+    if (dest_fd < 0) {
+        close(src_fd);
+        return -1;
+    }
+
+    int32_t result = 1;
+#ifdef FICLONE
+    // file systems with reflink support (e.g. xfs, btrfs) share the extents of both files
+    if (ioctl(dest_fd, FICLONE, src_fd) == 0) {
+        stats->bytes_copied = st.st_size;
+        stats->method = "reflink";
+        result = 0;
+    }
+#endif
+    if (result == 1) {
+        result = copy_file_in_kernel(src_fd, dest_fd, st.st_size, false, stats);
+    }
+    if (result == 1) {
+        result = copy_file_in_kernel(src_fd, dest_fd, st.st_size, true, stats);
+    }
+
+    close(src_fd);
+    if (close(dest_fd) != 0) {
+        result = -1;
+    }
+    return result;
+}
+#endif
+
+// copy the file content chunk by chunk through user space
+int32_t copy_file_chunked(const char *src, const char *dest, struct copy_stats *stats) {
+    file_handle *src_fp = file_open(src, "rb");
+    if (src_fp == NULL) {
+        return -1;
+    }
+
+    file_handle *dest_fp = file_open(dest, "wb");
+    if (dest_fp == NULL) {
+        file_close(src_fp);
+        return -1;
+    }
+
+    char *buffer = (char *)malloc(COPY_CHUNK_SIZE);
+    int32_t result = 0;
+    uint64_t copied = 0;
+    size_t bytes_read;
+    while ((bytes_read = file_read(buffer, 1, COPY_CHUNK_SIZE, src_fp)) > 0) {
+        if (file_write(buffer, 1, bytes_read, dest_fp) != bytes_read) {
+            result = -1;
+            break;
+        }
+        copied += bytes_read;
+    }
+    free(buffer);
+
+    file_close(src_fp);
+    if (file_close(dest_fp) != 0) {
+        result = -1;
+    }
+    stats->bytes_copied = copied;
+    stats->method = "chunked";
+    return result;
+}
+
+// copy a file without spawning a shell. on linux the file is cloned if supported
+// by the file system or copied inside of the kernel, otherwise it is copied in chunks
+int32_t copy_file_with_stats(const char *src, const char *dest, struct copy_stats *stats) {
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_COPY);
+    double start = get_time_in_seconds();
+    stats->bytes_copied = 0;
+    stats->seconds = 0;
+    stats->method = NULL;
+
+    int32_t result = 1;
+#ifdef __linux__
+    result = copy_file_linux(src, dest, stats);
+#endif
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__)) || defined(_WIN32) || defined(_WIN64)
+    if (result == 1) {
+        result = copy_file_chunked(src, dest, stats);
+    }
 #else
-    // todo: implement for mac
-    return -1;
+    result = -1;
 #endif
+    stats_leave_phase(phase);
+
+    if (result != 0) {
+        fprintf(stderr, "Error: Could not copy file %s to %s.\n", src, dest);
+        return -1;
+    }
+    stats->seconds = get_time_in_seconds() - start;
+    stats_record_copy(stats);
+    return 0;
+}
+
+int32_t copy_file_v2(const char *src, const char *dest) {
+    struct copy_stats stats;
+    return copy_file_with_stats(src, dest, &stats);
 }
 
 int32_t copy_directory(const char *src, const char *dest) {
-    char command[strlen(src) + strlen(dest) + 15];
-#ifdef __linux__
-    // we create the copy command for linux
-    snprintf(command, sizeof command, "cp -r \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
-#elif defined(__APPLE__) && defined(__MACH__)
-    // we create the copy command for MacOS
-    snprintf(command, sizeof command, "cp -r \"%s\" \"%s\"%c", src, dest, '\0');
-    return system(command);
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+    DIR *dir = opendir(src);
+    if (dir == NULL) {
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(src, &st) != 0 || (mkdir(dest, st.st_mode & 0777) != 0 && errno != EEXIST)) {
+        closedir(dir);
+        return -1;
+    }
+
+    // copy all files and subdirectories
+    int32_t result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        const char *src_entry = concat_path_filename(src, entry->d_name);
+        const char *dest_entry = concat_path_filename(dest, entry->d_name);
+        if (stat(src_entry, &st) != 0) {
+            result = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            result = copy_directory(src_entry, dest_entry);
+        } else if (S_ISREG(st.st_mode)) {
+            result = copy_file_v2(src_entry, dest_entry);
+        }
+        free((void *)src_entry);
+        free((void *)dest_entry);
+    }
+    closedir(dir);
+    return result;
 #elif _WIN32
+    char command[strlen(src) + strlen(dest) + 15];
     // we create the copy command for win32
     snprintf(command, sizeof command, "xcopy /Y \"%s\" \"%s\" /s /e%c", src, dest, '\0');
     return system(command);
 #elif _WIN64
+    char command[strlen(src) + strlen(dest) + 15];
     // we create the copy command for win64
     snprintf(command, sizeof command, "xcopy /Y \"%s\" \"%s\" /s /e%c", src, dest, '\0');
     return system(command);
 #else
-    // todo: implement for mac
     return -1;
 #endif
 }
@@ -423,9 +768,9 @@ int32_t copy_directory(const char *src, const char *dest) {
 bool is_system_big_endian() {
     int32_t n = 1;
     if (*(char *)&n == 1) {
-        return true;
+        return false;
     }
-    return false;
+    return true;
 }
 
 // swap bytes of unsigned integer 16 bits
@@ -444,6 +789,81 @@ uint64_t _swap_uint64(uint64_t value) {
     return (value << 32) | (value >> 32);
 }
 
+#if defined(X86_SIMD)
+// shuffle masks reversing the bytes of 2, 4 and 8 byte elements
+static const uint8_t SWAP_MASKS[3][16] = {{1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+                                          {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+                                          {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8}};
+
+static const uint8_t *get_swap_mask(int32_t size) { return SWAP_MASKS[size == 2 ? 0 : (size == 4 ? 1 : 2)]; }
+
+// swap 32 bytes per step, returns the number of bytes swapped
+__attribute__((target("avx2"))) static size_t swap_byte_order_avx2(uint8_t *data, int32_t size, size_t length) {
+    __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)get_swap_mask(size)));
+    size_t pos = 0;
+    for (; pos + 32 <= length; pos += 32) {
+        __m256i values = _mm256_loadu_si256((const __m256i *)(data + pos));
+        _mm256_storeu_si256((__m256i *)(data + pos), _mm256_shuffle_epi8(values, mask));
+    }
+    return pos;
+}
+
+// swap 16 bytes per step, returns the number of bytes swapped
+__attribute__((target("ssse3"))) static size_t swap_byte_order_ssse3(uint8_t *data, int32_t size, size_t length) {
+    __m128i mask = _mm_loadu_si128((const __m128i *)get_swap_mask(size));
+    size_t pos = 0;
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i values = _mm_loadu_si128((const __m128i *)(data + pos));
+        _mm_storeu_si128((__m128i *)(data + pos), _mm_shuffle_epi8(values, mask));
+    }
+    return pos;
+}
+
+// the cpu features are detected by libgcc at startup, so checking them only reads shared state
+static int32_t get_swap_instruction_set() {
+    return __builtin_cpu_supports("avx2") ? 2 : (__builtin_cpu_supports("ssse3") ? 1 : 0);
+}
+#endif
+
+// reverse the byte order of every element in an array of 2, 4 or 8 byte elements
+void swap_byte_order(void *data, int32_t size, size_t count) {
+    if (size != 2 && size != 4 && size != 8) {
+        return;
+    }
+
+    size_t pos = 0;
+#if defined(X86_SIMD)
+    // arrays shorter than a vector register are swapped one element at a time
+    int32_t instruction_set = size * count >= 16 ? get_swap_instruction_set() : 0;
+    if (instruction_set == 2) {
+        pos = swap_byte_order_avx2((uint8_t *)data, size, size * count) / size;
+    } else if (instruction_set == 1) {
+        pos = swap_byte_order_ssse3((uint8_t *)data, size, size * count) / size;
+    }
+#endif
+
+    // swap the remaining elements one at a time
+    for (; pos < count; pos++) {
+        uint8_t *element = (uint8_t *)data + pos * size;
+        if (size == 2) {
+            uint16_t value;
+            memcpy(&value, element, sizeof(value));
+            value = _swap_uint16(value);
+            memcpy(element, &value, sizeof(value));
+        } else if (size == 4) {
+            uint32_t value;
+            memcpy(&value, element, sizeof(value));
+            value = _swap_uint32(value);
+            memcpy(element, &value, sizeof(value));
+        } else {
+            uint64_t value;
+            memcpy(&value, element, sizeof(value));
+            value = _swap_uint64(value);
+            memcpy(element, &value, sizeof(value));
+        }
+    }
+}
+
 const char *slice_str(const char *str, size_t start, size_t end) {
     char *result = (char *)malloc(end - start);
     size_t j = 0;
@@ -465,36 +885,187 @@ int32_t bytes_to_int(unsigned char *buffer, int32_t size) {
     return ret;
 }
 
-// iteratively searches file for value and returns size of file where value was found
-uint64_t iteratively_get_size_of_value(file_handle *fp, char *value, uint64_t step) {
+// find the first occurrence of value in a buffer that is not NUL-terminated.
+// candidates are located by their first byte with memchr
+const char *find_in_buffer(const char *buffer, size_t length, const char *value, size_t value_length) {
+    if (value_length == 0 || value_length > length) {
+        return NULL;
+    }
+    const char *last = buffer + (length - value_length);
+    const char *candidate = buffer;
+    while (candidate <= last) {
+        candidate = (const char *)memchr(candidate, value[0], last - candidate + 1);
+        if (candidate == NULL) {
+            return NULL;
+        }
+        if (memcmp(candidate + 1, value + 1, value_length - 1) == 0) {
+            return candidate;
+        }
+        candidate++;
+    }
+    return NULL;
+}
 
-    file_seek(fp, 0, SEEK_END);
-    uint64_t file_length = file_tell(fp);
+// search the file for value in chunks and get the offset of its first occurrence. the tail
+// of each chunk is kept, so that values spanning two chunks are found as well
+int32_t find_value_in_file(file_handle *fp, const char *value, uint64_t *offset) {
+    size_t value_length = strlen(value);
+    if (value_length == 0 || value_length > SEARCH_CHUNK_SIZE) {
+        return -1;
+    }
 
-    while (step < file_length) {
-        char *buffer = malloc(sizeof(char) * step);
-        file_seek(fp, 0, SEEK_SET);
+    char *buffer = (char *)malloc(SEARCH_CHUNK_SIZE + value_length - 1);
+    if (buffer == NULL || file_seek(fp, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "Error: Could not read file.\n");
+        free(buffer);
+        return -1;
+    }
 
-        if (file_read(buffer, step, 1, fp) != 1) {
-            free(buffer);
-            fprintf(stderr, "Error: Could not read file.\n");
-            return 0;
+    int32_t result = -1;
+    uint64_t buffer_offset = 0;
+    size_t kept = 0;
+    while (true) {
+        size_t bytes_read = file_read(buffer + kept, 1, SEARCH_CHUNK_SIZE, fp);
+        if (bytes_read == 0) {
+            break;
+        }
+        size_t length = kept + bytes_read;
+        const char *found = find_in_buffer(buffer, length, value, value_length);
+        if (found != NULL) {
+            *offset = buffer_offset + (found - buffer);
+            result = 0;
+            break;
         }
+        // keep the bytes that may be the beginning of the value
+        kept = length < value_length - 1 ? length : value_length - 1;
+        memmove(buffer, buffer + length - kept, kept);
+        buffer_offset += length - kept;
+    }
 
-        // found value
-        if (contains(buffer, value)) {
-            // calculates size
-            char *ret = strstr(buffer, value);
-            uint64_t size = ret - buffer;
-            file_seek(fp, 0, SEEK_SET);
-            free(buffer);
-            return size;
-        } else {
-            free(buffer);
-            step += step;
+    free(buffer);
+    file_seek(fp, 0, SEEK_SET);
+    return result;
+}
+
+int32_t get_child_in_pattern_scanner(const struct pattern_scanner *scanner, int32_t node, uint8_t symbol) {
+    if (node == 0) {
+        return scanner->root_children[symbol];
+    }
+    int32_t child = scanner->nodes[node].first_child;
+    while (child >= 0 && scanner->nodes[child].symbol != symbol) {
+        child = scanner->nodes[child].next_sibling;
+    }
+    return child;
+}
+
+// build an aho-corasick automaton for the given patterns, so that all of them
+// are searched in a single pass over a buffer with find_patterns
+struct pattern_scanner *create_pattern_scanner(const char *const *patterns, size_t num_patterns) {
+    size_t capacity = 1;
+    for (size_t i = 0; i < num_patterns; i++) {
+        capacity += strlen(patterns[i]);
+    }
+
+    struct pattern_scanner *scanner = (struct pattern_scanner *)malloc(sizeof(struct pattern_scanner));
+    struct pattern_scanner_node *nodes =
+        (struct pattern_scanner_node *)malloc(capacity * sizeof(struct pattern_scanner_node));
+    int32_t *queue = (int32_t *)malloc(capacity * sizeof(int32_t));
+    if (scanner == NULL || nodes == NULL || queue == NULL) {
+        fprintf(stderr, "Error: Could not allocate memory for pattern scanner.\n");
+        free(scanner);
+        free(nodes);
+        free(queue);
+        return NULL;
+    }
+    scanner->nodes = nodes;
+    scanner->num_nodes = 1;
+    scanner->num_patterns = num_patterns;
+    memset(scanner->root_children, -1, sizeof(scanner->root_children));
+    nodes[0] = (struct pattern_scanner_node){-1, -1, 0, 0, -1, 0, 0};
+
+    // insert the patterns into the trie, a repeated pattern is only reported for its first index
+    for (size_t i = 0; i < num_patterns; i++) {
+        int32_t node = 0;
+        for (const char *c = patterns[i]; *c != '\0'; c++) {
+            uint8_t symbol = (uint8_t)*c;
+            int32_t child = get_child_in_pattern_scanner(scanner, node, symbol);
+            if (child < 0) {
+                child = scanner->num_nodes++;
+                nodes[child] = (struct pattern_scanner_node){-1, nodes[node].first_child, 0, 0, -1,
+                                                             nodes[node].depth + 1, symbol};
+                nodes[node].first_child = child;
+                if (node == 0) {
+                    scanner->root_children[symbol] = child;
+                }
+            }
+            node = child;
+        }
+        if (node != 0 && nodes[node].pattern < 0) {
+            nodes[node].pattern = i;
         }
     }
-    return 0;
+
+    // set fail and output links in breadth-first order, so that the links of shorter suffixes are known
+    size_t head = 0;
+    size_t tail = 0;
+    for (int32_t child = nodes[0].first_child; child >= 0; child = nodes[child].next_sibling) {
+        queue[tail++] = child;
+    }
+    while (head < tail) {
+        int32_t node = queue[head++];
+        for (int32_t child = nodes[node].first_child; child >= 0; child = nodes[child].next_sibling) {
+            int32_t fail = nodes[node].fail;
+            int32_t next;
+            while ((next = get_child_in_pattern_scanner(scanner, fail, nodes[child].symbol)) < 0 && fail != 0) {
+                fail = nodes[fail].fail;
+            }
+            nodes[child].fail = next < 0 ? 0 : next;
+            nodes[child].output =
+                nodes[nodes[child].fail].pattern >= 0 ? nodes[child].fail : nodes[nodes[child].fail].output;
+            queue[tail++] = child;
+        }
+    }
+
+    free(queue);
+    return scanner;
+}
+
+// scan the buffer once and get the first occurrence of every pattern, NULL for patterns
+// that are not found. returns the number of patterns found
+size_t find_patterns(const struct pattern_scanner *scanner, const char *buffer, size_t length, const char **matches) {
+    const struct pattern_scanner_node *nodes = scanner->nodes;
+    for (size_t i = 0; i < scanner->num_patterns; i++) {
+        matches[i] = NULL;
+    }
+
+    size_t found = 0;
+    int32_t node = 0;
+    for (size_t i = 0; i < length && found < scanner->num_patterns; i++) {
+        uint8_t symbol = (uint8_t)buffer[i];
+        int32_t next;
+        while ((next = get_child_in_pattern_scanner(scanner, node, symbol)) < 0 && node != 0) {
+            node = nodes[node].fail;
+        }
+        node = next < 0 ? 0 : next;
+
+        // report all patterns ending at this position
+        int32_t output = nodes[node].pattern >= 0 ? node : nodes[node].output;
+        for (; output != 0; output = nodes[output].output) {
+            int32_t pattern = nodes[output].pattern;
+            if (matches[pattern] == NULL) {
+                matches[pattern] = buffer + i + 1 - nodes[output].depth;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+void free_pattern_scanner(struct pattern_scanner *scanner) {
+    if (scanner != NULL) {
+        free(scanner->nodes);
+        free(scanner);
+    }
 }
 
 const char *concat_wildcard_string_int32(const char *str, int32_t integer) {
@@ -3,8 +3,15 @@
 
 #include "defines.h"
 #include "file-api.h"
+#include "stats.h"
 #include "time.h"
 
+// the vectorized byte swap needs gcc or clang on x86, the cpu support is checked at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 // string and int operations
 char **str_split(char *a_str, const char a_delim);
 
@@ -14,6 +21,25 @@ int32_t file_exists(const char *filename);
 
 char *create_pre_suffixed_char_array(const char x, uint64_t length, const char *prefix, const char *suffix);
 
+char *create_fill_buffer(const char fill_character, uint64_t max_length, size_t *buffer_size);
+
+int32_t write_wiped_data(file_handle *fp, const char *fill_buffer, size_t buffer_size, uint64_t length,
+                         const char *prefix, const char *suffix);
+
+int32_t merge_ranges(uint64_t *offsets, uint64_t *lengths, int32_t count);
+
+void *arena_alloc(struct arena *arena, size_t size);
+
+void free_arena(struct arena *arena);
+
+void seed_random(uint64_t seed);
+
+uint64_t get_random_state();
+
+void set_random_state(uint64_t state);
+
+uint64_t next_random();
+
 char *create_random_string(uint64_t length);
 
 char *create_replacement_string(const char x, uint64_t length);
@@ -46,7 +72,15 @@ const char *add_equals_sign(const char *str1, const char *str2);
 
 bool contains(const char *str1, const char *str2);
 
-uint64_t iteratively_get_size_of_value(file_handle *fp, char *value, uint64_t step);
+const char *find_in_buffer(const char *buffer, size_t length, const char *value, size_t value_length);
+
+int32_t find_value_in_file(file_handle *fp, const char *value, uint64_t *offset);
+
+struct pattern_scanner *create_pattern_scanner(const char *const *patterns, size_t num_patterns);
+
+size_t find_patterns(const struct pattern_scanner *scanner, const char *buffer, size_t length, const char **matches);
+
+void free_pattern_scanner(struct pattern_scanner *scanner);
 
 const char *concat_wildcard_string_int32(const char *str, int32_t integer);
 
@@ -61,6 +95,12 @@ const char *slice_str(const char *value, size_t start, size_t end);
 // file operations
 const char *duplicate_file(const char *filename, const char *new_file_name, const char *file_extension);
 
+double get_time_in_seconds();
+
+int32_t copy_file_chunked(const char *src, const char *dest, struct copy_stats *stats);
+
+int32_t copy_file_with_stats(const char *src, const char *dest, struct copy_stats *stats);
+
 int32_t copy_file_v2(const char *src, const char *dest);
 
 int32_t copy_directory(const char *src, const char *dest);
@@ -74,6 +114,8 @@ uint32_t _swap_uint32(uint32_t value);
 
 uint64_t _swap_uint64(uint64_t value);
 
+void swap_byte_order(void *data, int32_t size, size_t count);
+
 int32_t count_contains(const char *str1, const char *str2);
 
 int32_t bytes_to_int(unsigned char *buffer, int32_t size);
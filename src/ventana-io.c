@@ -1,6 +1,7 @@
 #include "ventana-io.h"
+#include "stats-alloc.h"
 
-struct metadata_attribute *get_attribute_ventana(char *buffer, const char *delimiter1, const char *delimiter2) {
+struct metadata_attribute *get_attribute_ventana(const char *buffer, const char *delimiter1, const char *delimiter2) {
     char *value = get_string_between_delimiters(buffer, delimiter1, delimiter2);
     // check if tag is not an empty string
     if (value[0] != '\0') {
@@ -17,22 +18,27 @@ struct metadata_attribute *get_attribute_ventana(char *buffer, const char *delim
 }
 
 struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file) {
-    // all metadata with double quotes
-    static const char *METADATA_ATTRIBUTES[] = {VENTANA_BASENAME_ATT, VENTANA_FILENAME_ATT,  VENTANA_UNITNUMBER_ATT,
-                                                VENTANA_USERNAME_ATT, VENTANA_BUILDDATE_ATT, VENTANA_BARCODE1D_ATT,
-                                                VENTANA_BARCODE2D_ATT};
-
-    // all metadata with single quotes
-    static const char *METADATA_ATTRIBUTES_2[] = {
-        VENTANA_BASENAME_ATT_2,  VENTANA_FILENAME_ATT_2,  VENTANA_UNITNUMBER_ATT_2, VENTANA_USERNAME_ATT_2,
-        VENTANA_BUILDDATE_ATT_2, VENTANA_BARCODE1D_ATT_2, VENTANA_BARCODE2D_ATT_2};
+    // all metadata with double quotes followed by all metadata with single quotes,
+    // the value of an attribute ends with the quote its name ends with
+    static const char *METADATA_ATTRIBUTES[] = {
+        VENTANA_BASENAME_ATT,     VENTANA_FILENAME_ATT,   VENTANA_UNITNUMBER_ATT,  VENTANA_USERNAME_ATT,
+        VENTANA_BUILDDATE_ATT,    VENTANA_BARCODE1D_ATT,  VENTANA_BARCODE2D_ATT,   VENTANA_BASENAME_ATT_2,
+        VENTANA_FILENAME_ATT_2,   VENTANA_UNITNUMBER_ATT_2, VENTANA_USERNAME_ATT_2, VENTANA_BUILDDATE_ATT_2,
+        VENTANA_BARCODE1D_ATT_2, VENTANA_BARCODE2D_ATT_2};
+    static const size_t NUM_ATTRIBUTES = sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]);
 
     // initialize metadata_attribute struct
-    struct metadata_attribute **attributes =
-        malloc(sizeof(**attributes) * (sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]) +
-                                       sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0])));
+    struct metadata_attribute **attributes = malloc(sizeof(**attributes) * NUM_ATTRIBUTES);
     int8_t metadata_id = 0;
 
+    // all attributes are searched in a single pass over each XMP
+    struct pattern_scanner *scanner = create_pattern_scanner(METADATA_ATTRIBUTES, NUM_ATTRIBUTES);
+    const char *matches[sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0])];
+    if (scanner == NULL) {
+        free(attributes);
+        return NULL;
+    }
+
     // iterate over directories in tiff file
     for (uint64_t i = 0; i < file->used; i++) {
         struct tiff_directory dir = file->directories[i];
@@ -45,29 +51,24 @@ struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file) {
                 int32_t entry_size = get_size_of_value(entry.type, &entry.count);
 
                 // read content of XMP into buffer
-                char *buffer = malloc(entry_size * entry.count);
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
+                size_t length = entry_size * entry.count;
+                char *buffer = malloc(length + 1);
+                if (buffer == NULL || file_read(buffer, entry.count, entry_size, fp) != 1) {
                     fprintf(stderr, "Error: Could not read XMP Tag.\n");
                     free(buffer);
+                    free_pattern_scanner(scanner);
                     return NULL;
                 }
-
-                // checks for all metadata with double quotes
-                for (size_t k = 0; k < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); k++) {
-                    if (contains(buffer, METADATA_ATTRIBUTES[k])) {
+                buffer[length] = '\0';
+
+                // checks for all metadata, the value is read from the first occurrence of an attribute
+                find_patterns(scanner, buffer, strlen(buffer), matches);
+                for (size_t k = 0; k < NUM_ATTRIBUTES; k++) {
+                    if (matches[k] != NULL) {
+                        const char *attribute = METADATA_ATTRIBUTES[k];
+                        const char quote[] = {attribute[strlen(attribute) - 1], '\0'};
                         struct metadata_attribute *single_attribute =
-                            get_attribute_ventana(buffer, METADATA_ATTRIBUTES[k], "\"");
-                        if (single_attribute != NULL) {
-                            attributes[metadata_id++] = single_attribute;
-                        }
-                    }
-                }
-
-                // checks for all metadata with double quotes
-                for (size_t k = 0; k < sizeof(METADATA_ATTRIBUTES_2) / sizeof(METADATA_ATTRIBUTES_2[0]); k++) {
-                    if (contains(buffer, METADATA_ATTRIBUTES_2[k])) {
-                        struct metadata_attribute *single_attribute =
-                            get_attribute_ventana(buffer, METADATA_ATTRIBUTES_2[k], "\'");
+                            get_attribute_ventana(matches[k], attribute, quote);
                         if (single_attribute != NULL) {
                             attributes[metadata_id++] = single_attribute;
                         }
@@ -83,6 +84,7 @@ struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file) {
                 if (file_read(buffer, entry.count, entry_size, fp) != 1) {
                     fprintf(stderr, "Error: Could not read DATE_TIME Tag.\n");
                     free(buffer);
+                    free_pattern_scanner(scanner);
                     return NULL;
                 }
                 // add metadata
@@ -94,6 +96,7 @@ struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file) {
             }
         }
     }
+    free_pattern_scanner(scanner);
 
     // add all found metadata
     struct metadata *metadata_attributes = malloc(sizeof(*metadata_attributes));
@@ -102,9 +105,45 @@ struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file) {
     return metadata_attributes;
 }
 
+struct wsi_data *get_wsi_data_ventana_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename) {
+    // check for valid file extension
+    const char *ext = get_filename_ext(filename);
+    if (strcmp(ext, BIF) != 0 && strcmp(ext, TIF) != 0) {
+        return NULL;
+    }
+
+    // ventana files are always stored as BigTIFF
+    if (!file->big_tiff) {
+        fprintf(stderr, "Error: Not a valid Ventana file.\n");
+        return NULL;
+    }
+
+    // checks the first XMP, which follows the label directory, to determine if file is actually Ventana
+    int32_t result = first_tag_value_contains(fp, file, TIFFTAG_XMP, "iScan");
+
+    // checks result
+    if (result == -1) {
+        fprintf(stderr, "Error: Could not find XMP tag.\n");
+        return NULL;
+    }
+
+    // gets all metadata
+    if (read_remaining_tiff_directories(fp, file) != 0) {
+        return NULL;
+    }
+    struct metadata *metadata_attributes = get_metadata_ventana(fp, file);
+
+    // is Ventana
+    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
+    wsi_data->format = VENTANA;
+    wsi_data->filename = filename;
+    wsi_data->metadata_attributes = metadata_attributes;
+    wsi_data->tiff_file = NULL;
+    return wsi_data;
+}
+
 struct wsi_data *get_wsi_data_ventana(const char *filename) {
     // gets file extension
-    int32_t result = 0;
     const char *ext = get_filename_ext(filename);
 
     // check for valid file extension
@@ -113,7 +152,7 @@ struct wsi_data *get_wsi_data_ventana(const char *filename) {
     }
 
     // opens file
-    file_handle *fp = file_open(filename, "rb+");
+    file_handle *fp = file_open_mapped(filename, "rb+");
 
     // checks if file was successfully opened
     if (fp == NULL) {
@@ -121,49 +160,18 @@ struct wsi_data *get_wsi_data_ventana(const char *filename) {
         return NULL;
     }
 
-    // checks file details
-    bool big_tiff = false;
-    bool big_endian = false;
-    result = check_file_header(fp, &big_endian, &big_tiff);
-
-    // checks result
-    if (!big_tiff || result != 0) {
-        fprintf(stderr, "Error: Not a valid Ventana file.\n");
-        file_close(fp);
-        return NULL;
-    }
-
     // creates tiff file structure
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, false, big_endian);
+    struct tiff_file *file = read_tiff_file_with_header(fp, false);
 
     // checks result
     if (file == NULL) {
-        fprintf(stderr, "Error: Could not read tiff file.\n");
-        file_close(fp);
-        return NULL;
-    }
-
-    // checks tag value in order to if file is actually Ventana
-    result = tag_value_contains(fp, file, TIFFTAG_XMP, "iScan");
-
-    // checks result
-    if (result == -1) {
-        fprintf(stderr, "Error: Could not find XMP tag.\n");
         file_close(fp);
         return NULL;
     }
 
-    // gets all metadata
-    struct metadata *metadata_attributes = get_metadata_ventana(fp, file);
-
-    // is Ventana
-    struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
-    wsi_data->format = VENTANA;
-    wsi_data->filename = filename;
-    wsi_data->metadata_attributes = metadata_attributes;
+    struct wsi_data *wsi_data = get_wsi_data_ventana_from_tiff(fp, file, filename);
 
-    // clean up
+    // cleanup
     free_tiff_file(file);
     file_close(fp);
     return wsi_data;
@@ -171,32 +179,9 @@ struct wsi_data *get_wsi_data_ventana(const char *filename) {
 
 // gets the label directory of ventana file
 int64_t get_ventana_label_dir(file_handle *fp, struct tiff_file *file) {
-
-    for (uint64_t i = 0; i < file->used; i++) {
-
-        struct tiff_directory dir = file->directories[i];
-        for (uint64_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            if (entry.tag == TIFFTAG_IMAGEDESCRIPTION) {
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-
-                char *buffer = malloc(entry_size * entry.count);
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read image description.\n");
-                    free(buffer);
-                    return -1;
-                }
-
-                if (contains(buffer, "Label")) {
-                    free(buffer);
-                    return i;
-                }
-                free(buffer);
-            }
-        }
-    }
-    return -1;
+    // the label directory is usually the first one, directories behind it are not needed
+    int64_t dir = find_directory_by_tag_value(fp, file, TIFFTAG_IMAGEDESCRIPTION, "Label", false);
+    return dir >= 0 ? dir : -1;
 }
 
 // wipes the label directory of ventana file by replacing bytes with zeros
@@ -204,24 +189,25 @@ int32_t wipe_label_ventana(file_handle *fp, struct tiff_directory *dir, bool big
     int32_t offset_tag = TIFFTAG_TILEOFFSETS;
     int32_t byte_count_tag = TIFFTAG_TILEBYTECOUNTS;
 
-    for (uint64_t i = 0; i < dir->count; i++) {
-        struct tiff_entry entry = dir->entries[i];
-        // the label image might be saved strip-based instead of tile-based
-        // so we have to search for the respective tiff tags to distinguish
-        if (entry.tag == TIFFTAG_STRIPOFFSETS) {
-            offset_tag = TIFFTAG_STRIPOFFSETS;
-            byte_count_tag = TIFFTAG_STRIPBYTECOUNTS;
-            break;
-        }
+    // the label image might be saved strip-based instead of tile-based
+    // so we have to search for the respective tiff tags to distinguish
+    if (find_entry_by_tag(dir, TIFFTAG_STRIPOFFSETS) >= 0) {
+        offset_tag = TIFFTAG_STRIPOFFSETS;
+        byte_count_tag = TIFFTAG_STRIPBYTECOUNTS;
     }
 
-    int32_t size_offsets;
-    int32_t size_lengths;
-    uint64_t *strip_offsets = read_pointer64_by_tag(fp, dir, offset_tag, false, big_endian, &size_offsets);
-    uint64_t *strip_lengths = read_pointer64_by_tag(fp, dir, byte_count_tag, false, big_endian, &size_lengths);
+    // offsets and byte counts are read in one batch
+    struct tag_values values[2] = {{offset_tag, NULL, 0}, {byte_count_tag, NULL, 0}};
+    read_values_by_tags(fp, dir, false, big_endian, sizeof(uint64_t), values, 2);
+    uint64_t *strip_offsets = (uint64_t *)values[0].values;
+    uint64_t *strip_lengths = (uint64_t *)values[1].values;
+    int32_t size_offsets = values[0].length;
+    int32_t size_lengths = values[1].length;
 
     if (strip_offsets == NULL || strip_lengths == NULL) {
         fprintf(stderr, "Error: Could not retrieve strip offset and length.\n");
+        free(strip_offsets);
+        free(strip_lengths);
         return -1;
     }
 
@@ -232,22 +218,13 @@ int32_t wipe_label_ventana(file_handle *fp, struct tiff_directory *dir, bool big
         return -1;
     }
 
-    for (int32_t i = 0; i < size_offsets; i++) {
-        file_seek(fp, strip_offsets[i], SEEK_SET);
+    // adjacent tiles are written at once
+    size_offsets = merge_ranges(strip_offsets, strip_lengths, size_offsets);
 
-        char *strip = create_pre_suffixed_char_array('0', strip_lengths[i], NULL, NULL);
-        if (!file_write(strip, 1, strip_lengths[i], fp)) {
-            fprintf(stderr, "Error: Wiping image data failed.\n");
-            free(strip_offsets);
-            free(strip_lengths);
-            free(strip);
-            return -1;
-        }
-        free(strip);
-    }
+    int32_t result = wipe_strips(fp, strip_offsets, strip_lengths, size_offsets, NULL, NULL);
     free(strip_offsets);
     free(strip_lengths);
-    return 0;
+    return result;
 }
 
 // wipes and unlinks directory
@@ -287,108 +264,103 @@ char *anonymize_xmp_attribute_if_exists(char *buffer, const char *attr, const ch
 // anonymizes metadata in XMP Tags of ventana file
 int32_t remove_metadata_in_ventana(file_handle *fp, struct tiff_file *file) {
 
-    for (uint64_t i = 0; i < file->used; i++) {
-        struct tiff_directory dir = file->directories[i];
-        for (uint64_t j = 0; j < dir.count; j++) {
-            struct tiff_entry entry = dir.entries[j];
-            // searches for XMP Tag in all directories and removes metadata in it
-            if (entry.tag == TIFFTAG_XMP) {
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-                char *buffer = malloc(entry_size * entry.count);
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read XMP Tag.\n");
-                    free(buffer);
-                    return -1;
-                }
+    // searches for XMP Tag in all directories and removes metadata in it
+    uint64_t num_references;
+    const struct tiff_tag_reference *references = find_tag_references(file, TIFFTAG_XMP, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        struct tiff_entry entry = *get_entry_of_reference(file, &references[k]);
+        int32_t entry_size = get_size_of_value(entry.type, &entry.count);
+        char *buffer = copy_tag_value(fp, file, &references[k]);
+        if (buffer == NULL) {
+            fprintf(stderr, "Error: Could not read XMP Tag.\n");
+            return -1;
+        }
 
-                char *result = buffer;
-                bool rewrite = false;
-
-                // all metadata with double quotes
-                const char *METADATA_ATTRIBUTES[] = {
-                    VENTANA_BASENAME_ATT,  VENTANA_FILENAME_ATT,  VENTANA_UNITNUMBER_ATT, VENTANA_USERNAME_ATT,
-                    VENTANA_BUILDDATE_ATT, VENTANA_BARCODE1D_ATT, VENTANA_BARCODE2D_ATT};
-
-                for (size_t k = 0; k < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); k++) {
-                    if (contains(result, METADATA_ATTRIBUTES[k])) {
-                        char *new_result = anonymize_xmp_attribute_if_exists(result, METADATA_ATTRIBUTES[k], "\"");
-                        if (new_result != NULL) {
-                            strcpy(result, new_result);
-                            free(new_result);
-                            rewrite = true;
-                        }
-                    }
+        char *result = buffer;
+        bool rewrite = false;
+
+        // all metadata with double quotes
+        const char *METADATA_ATTRIBUTES[] = {
+            VENTANA_BASENAME_ATT,  VENTANA_FILENAME_ATT,  VENTANA_UNITNUMBER_ATT, VENTANA_USERNAME_ATT,
+            VENTANA_BUILDDATE_ATT, VENTANA_BARCODE1D_ATT, VENTANA_BARCODE2D_ATT};
+
+        for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES) / sizeof(METADATA_ATTRIBUTES[0]); i++) {
+            if (contains(result, METADATA_ATTRIBUTES[i])) {
+                char *new_result = anonymize_xmp_attribute_if_exists(result, METADATA_ATTRIBUTES[i], "\"");
+                if (new_result != NULL) {
+                    strcpy(result, new_result);
+                    free(new_result);
+                    rewrite = true;
                 }
+            }
+        }
 
-                // all metadata with single quotes
-                const char *METADATA_ATTRIBUTES_2[] = {
-                    VENTANA_BASENAME_ATT_2,  VENTANA_FILENAME_ATT_2,  VENTANA_UNITNUMBER_ATT_2, VENTANA_USERNAME_ATT_2,
-                    VENTANA_BUILDDATE_ATT_2, VENTANA_BARCODE1D_ATT_2, VENTANA_BARCODE2D_ATT_2};
-
-                for (size_t k = 0; k < sizeof(METADATA_ATTRIBUTES_2) / sizeof(METADATA_ATTRIBUTES_2[0]); k++) {
-                    if (contains(result, METADATA_ATTRIBUTES_2[k])) {
-                        char *new_result = anonymize_xmp_attribute_if_exists(result, METADATA_ATTRIBUTES_2[k], "\'");
-                        if (new_result != NULL) {
-                            strcpy(result, new_result);
-                            free(new_result);
-                            rewrite = true;
-                        }
-                    }
+        // all metadata with single quotes
+        const char *METADATA_ATTRIBUTES_2[] = {
+            VENTANA_BASENAME_ATT_2,  VENTANA_FILENAME_ATT_2,  VENTANA_UNITNUMBER_ATT_2, VENTANA_USERNAME_ATT_2,
+            VENTANA_BUILDDATE_ATT_2, VENTANA_BARCODE1D_ATT_2, VENTANA_BARCODE2D_ATT_2};
+
+        for (size_t i = 0; i < sizeof(METADATA_ATTRIBUTES_2) / sizeof(METADATA_ATTRIBUTES_2[0]); i++) {
+            if (contains(result, METADATA_ATTRIBUTES_2[i])) {
+                char *new_result = anonymize_xmp_attribute_if_exists(result, METADATA_ATTRIBUTES_2[i], "\'");
+                if (new_result != NULL) {
+                    strcpy(result, new_result);
+                    free(new_result);
+                    rewrite = true;
                 }
+            }
+        }
 
-                // alters XML data of XMP tag
-                if (rewrite) {
-                    file_seek(fp, entry.offset, SEEK_SET);
-                    if (!file_write(result, entry_size, entry.count, fp)) {
-                        fprintf(stderr, "Error: Changing XML Data in XMP Tag failed.\n");
-                        free(buffer);
-                        return -1;
-                    }
-                }
+        // alters XML data of XMP tag
+        if (rewrite) {
+            file_seek(fp, entry.offset, SEEK_SET);
+            if (!file_write(result, entry_size, entry.count, fp)) {
+                fprintf(stderr, "Error: Changing XML Data in XMP Tag failed.\n");
                 free(buffer);
+                return -1;
             }
+            invalidate_tag_values(file, entry.offset, get_length_of_value(entry));
+        }
+        free(buffer);
+    }
 
-            // remove value in DATE_TIME tag
-            if (entry.tag == TIFFTAG_DATETIME) {
-                file_seek(fp, entry.offset, SEEK_SET);
-                int32_t entry_size = get_size_of_value(entry.type, &entry.count);
-                char *buffer = malloc(entry_size * entry.count);
+    // remove value in DATE_TIME tag
+    references = find_tag_references(file, TIFFTAG_DATETIME, &num_references);
+    for (uint64_t k = 0; k < num_references; k++) {
+        struct tiff_entry entry = *get_entry_of_reference(file, &references[k]);
+        int32_t entry_size = get_size_of_value(entry.type, &entry.count);
+        const char *buffer = get_tag_value(fp, file, &references[k]);
 
-                if (file_read(buffer, entry.count, entry_size, fp) != 1) {
-                    fprintf(stderr, "Error: Could not read DATE_TIME Tag.\n");
-                    free(buffer);
-                    return -1;
-                }
+        if (buffer == NULL) {
+            fprintf(stderr, "Error: Could not read DATE_TIME Tag.\n");
+            return -1;
+        }
 
-                char *replacement = create_replacement_string(' ', strlen(buffer));
-                char *new_buffer = replace_str(buffer, buffer, replacement);
-                file_seek(fp, entry.offset, SEEK_SET);
-                if (!file_write(new_buffer, entry_size, entry.count, fp)) {
-                    fprintf(stderr, "Error: Changing data in DATE_TIME Tag failed.\n");
-                    free(replacement);
-                    free(buffer);
-                    free(new_buffer);
-                    return -1;
-                }
-                free(replacement);
-                free(buffer);
-                free(new_buffer);
-            }
+        char *replacement = create_replacement_string(' ', strlen(buffer));
+        char *new_buffer = replace_str(buffer, buffer, replacement);
+        file_seek(fp, entry.offset, SEEK_SET);
+        if (!file_write(new_buffer, entry_size, entry.count, fp)) {
+            fprintf(stderr, "Error: Changing data in DATE_TIME Tag failed.\n");
+            free(replacement);
+            free(new_buffer);
+            return -1;
         }
+        invalidate_tag_values(file, entry.offset, get_length_of_value(entry));
+        free(replacement);
+        free(new_buffer);
     }
     return 1;
 }
 
 // anonymizes ventana file
 int32_t handle_ventana(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                       bool do_inplace) {
+                       bool do_inplace, struct tiff_file *file) {
 
     if (keep_macro_image) {
         fprintf(stderr, "Error: Cannot keep macro image in Ventana file.\n");
     }
 
-    fprintf(stdout, "Anonymize Ventana WSI...\n");
+    fprintf(stderr, "Anonymize Ventana WSI...\n");
 
     const char *ext = get_filename_ext(*filename);
 
@@ -398,31 +370,28 @@ int32_t handle_ventana(const char **filename, const char *new_label_name, bool k
         *filename = duplicate_file(*filename, new_label_name, is_bif ? DOT_BIF : DOT_TIF);
     }
 
-    file_handle *fp = file_open(*filename, "rb+");
+    file_handle *fp = file_open_mapped(*filename, "rb+");
 
     if (fp == NULL) {
         fprintf(stderr, "Error: Could not open tiff file.\n");
+        if (file != NULL) {
+            free_tiff_file(file);
+        }
         return -1;
     }
 
-    bool big_tiff = false;
-    bool big_endian = false;
-    int32_t result = check_file_header(fp, &big_endian, &big_tiff);
-
-    if (result == -1) {
-        file_close(fp);
-        return -1;
+    // read the file structure, unless it was already read during format detection
+    if (file == NULL) {
+        file = read_tiff_file_with_header(fp, false);
     }
 
-    struct tiff_file *file;
-    file = read_tiff_file(fp, big_tiff, false, big_endian);
-
     if (file == NULL) {
         fprintf(stderr, "Error: Could not read tiff file.\n");
         file_close(fp);
         return -1;
     }
 
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_WIPE_LABEL);
     int64_t label_dir = get_ventana_label_dir(fp, file);
 
     if (label_dir == -1) {
@@ -432,7 +401,8 @@ int32_t handle_ventana(const char **filename, const char *new_label_name, bool k
         return -1;
     }
 
-    result = wipe_and_unlink_ventana_directory(fp, file, label_dir, big_endian, disable_unlinking);
+    stats_record_directory(label_dir);
+    int32_t result = wipe_and_unlink_ventana_directory(fp, file, label_dir, file->big_endian, disable_unlinking);
 
     if (result == -1) {
         free_tiff_file(file);
@@ -440,10 +410,11 @@ int32_t handle_ventana(const char **filename, const char *new_label_name, bool k
         return -1;
     }
 
+    stats_enter_phase(PHASE_METADATA);
     remove_metadata_in_ventana(fp, file);
+    stats_leave_phase(phase);
 
     // clean up
-    free((void *)(*filename));
     free_tiff_file(file);
     file_close(fp);
     return result;
@@ -7,14 +7,16 @@ static const char BIF[] = "bif";
 static const char DOT_BIF[] = ".bif";
 
 // main functions
-struct metadata_attribute *get_attribute_ventana(char *buffer, const char *delimiter1, const char *delimiter2);
+struct metadata_attribute *get_attribute_ventana(const char *buffer, const char *delimiter1, const char *delimiter2);
 
 struct metadata *get_metadata_ventana(file_handle *fp, struct tiff_file *file);
 
+struct wsi_data *get_wsi_data_ventana_from_tiff(file_handle *fp, struct tiff_file *file, const char *filename);
+
 struct wsi_data *get_wsi_data_ventana(const char *filename);
 
 int32_t handle_ventana(const char **filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
-                       bool do_inplace);
+                       bool do_inplace, struct tiff_file *file);
 
 // additional functions
 int64_t get_ventana_label_dir(file_handle *fp, struct tiff_file *file);
@@ -1,40 +1,120 @@
 #include "wsi-anonymizer.h"
+#include "stats-alloc.h"
 
-int32_t (*handle_format_functions[])(const char **filename, const char *new_label_name, bool keep_macro_image,
-                                     bool disable_unlinking, bool do_inplace) = {
+// the format tables are never modified, so format detection and anonymization may run on several threads
+static int32_t (*const handle_format_functions[])(const char **filename, const char *new_label_name,
+                                                  bool keep_macro_image, bool disable_unlinking, bool do_inplace,
+                                                  struct tiff_file *file) = {
     &handle_aperio, &handle_hamamatsu, &handle_mirax, &handle_ventana, &handle_isyntax, &handle_philips_tiff};
 
-struct wsi_data *(*get_wsi_data_functions[])(const char *filename) = {
+static struct wsi_data *(*const get_wsi_data_functions[])(const char *filename) = {
     &get_wsi_data_aperio,  &get_wsi_data_hamamatsu, &get_wsi_data_mirax,
     &get_wsi_data_ventana, &get_wsi_data_isyntax,   &get_wsi_data_philips_tiff};
 
-int8_t num_of_formats = sizeof(VENDOR_AND_FORMAT_STRINGS) / sizeof(char *);
+// probes for tiff based formats working on an already read file structure,
+// NULL for formats that are not tiff based
+static struct wsi_data *(*const get_wsi_data_from_tiff_functions[])(file_handle *fp, struct tiff_file *file,
+                                                                     const char *filename) = {
+    &get_wsi_data_aperio_from_tiff,  &get_wsi_data_hamamatsu_from_tiff, NULL,
+    &get_wsi_data_ventana_from_tiff, NULL,                              &get_wsi_data_philips_tiff_from_tiff};
 
-struct wsi_data *get_wsi_data(const char *filename) {
+static const int8_t num_of_formats = sizeof(VENDOR_AND_FORMAT_STRINGS) / sizeof(char *);
+
+// check if the extension belongs to any of the tiff based formats
+bool has_tiff_based_extension(const char *ext) {
+    static const char *TIFF_BASED_EXTENSIONS[] = {SVS, TIF, NDPI, BIF, TIFF};
+    for (size_t i = 0; i < sizeof(TIFF_BASED_EXTENSIONS) / sizeof(TIFF_BASED_EXTENSIONS[0]); i++) {
+        if (strcmp(ext, TIFF_BASED_EXTENSIONS[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// opens the file once and checks the tiff header. the file structure is shared by all tiff
+// based probes, which read directories on demand, and is kept in the returned data
+struct wsi_data *get_wsi_data_tiff_based(const char *filename) {
+    const char *ext = get_filename_ext(filename);
+    if (!has_tiff_based_extension(ext)) {
+        return NULL;
+    }
+
+    file_handle *fp = file_open_mapped(filename, "rb+");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    // ndpi files use an extended tiff structure
+    struct tiff_file *file = open_tiff_file_with_header(fp, strcmp(ext, NDPI) == 0);
+    if (file == NULL) {
+        file_close(fp);
+        return NULL;
+    }
+
+    struct wsi_data *wsi_data = NULL;
+    for (int8_t i = 0; i < num_of_formats - 2 && wsi_data == NULL; i++) {
+        if (get_wsi_data_from_tiff_functions[i] != NULL) {
+            wsi_data = get_wsi_data_from_tiff_functions[i](fp, file, filename);
+        }
+    }
+    file_close(fp);
+
+    if (wsi_data == NULL) {
+        free_tiff_file(file);
+        return NULL;
+    }
+    wsi_data->tiff_file = file;
+    return wsi_data;
+}
+
+struct wsi_data *detect_wsi_format(const char *filename) {
     if (file_exists(filename)) {
+        // tiff based formats are probed on a single read of the file structure
+        struct wsi_data *wsi_data = get_wsi_data_tiff_based(filename);
+        if (wsi_data != NULL) {
+            return wsi_data;
+        }
+
+        // remaining formats are probed one by one
         for (int8_t i = 0; i < num_of_formats - 2; i++) {
-            struct wsi_data *wsi_data = get_wsi_data_functions[i](filename);
+            if (get_wsi_data_from_tiff_functions[i] != NULL) {
+                continue;
+            }
+            wsi_data = get_wsi_data_functions[i](filename);
             if (wsi_data != NULL) {
                 return wsi_data;
             }
         }
         // unknown format
-        struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
+        wsi_data = malloc(sizeof(*wsi_data));
         wsi_data->format = UNKNOWN;
+        wsi_data->filename = filename;
+        wsi_data->metadata_attributes = NULL;
+        wsi_data->tiff_file = NULL;
         return wsi_data;
     } else {
         // invalid format
         struct wsi_data *wsi_data = malloc(sizeof(*wsi_data));
         wsi_data->format = INVALID;
+        wsi_data->filename = filename;
+        wsi_data->metadata_attributes = NULL;
+        wsi_data->tiff_file = NULL;
         return wsi_data;
     }
 }
 
-int32_t anonymize_wsi_with_result(const char **filename, const char *new_label_name, bool keep_macro_image,
-                                  bool disable_unlinking, bool do_inplace) {
-    int32_t result = -1;
+struct wsi_data *get_wsi_data(const char *filename) {
+    ANONYMIZATION_PHASE phase = stats_enter_phase(PHASE_PROBE);
+    struct wsi_data *wsi_data = detect_wsi_format(filename);
+    stats_record_format(wsi_data->format);
+    stats_leave_phase(phase);
+    return wsi_data;
+}
 
-    struct wsi_data *wsi_data = get_wsi_data(*filename);
+// anonymize a file with already detected format. wsi_data is released
+int32_t anonymize_wsi_data(struct wsi_data *wsi_data, const char **filename, const char *new_label_name,
+                           bool keep_macro_image, bool disable_unlinking, bool do_inplace) {
+    int32_t result = -1;
 
     if (wsi_data == NULL) {
         fprintf(stderr, "Error: Unable to collect metadata.\n");
@@ -48,32 +128,151 @@ int32_t anonymize_wsi_with_result(const char **filename, const char *new_label_n
         free(wsi_data);
         return result;
     } else {
+        // the handler takes ownership of the file structure read during format detection
+        struct tiff_file *file = wsi_data->tiff_file;
+        wsi_data->tiff_file = NULL;
+        const char *original_filename = *filename;
         result = handle_format_functions[wsi_data->format](filename, new_label_name, keep_macro_image,
-                                                           disable_unlinking, do_inplace);
+                                                           disable_unlinking, do_inplace, file);
+        // in copy mode the handler replaces the filename by the one of the copy
+        if (*filename != original_filename) {
+            free((void *)(*filename));
+            *filename = original_filename;
+        }
         free_wsi_data(wsi_data);
         return result;
     }
 }
 
+int32_t anonymize_wsi_with_result(const char **filename, const char *new_label_name, bool keep_macro_image,
+                                  bool disable_unlinking, bool do_inplace) {
+    struct wsi_data *wsi_data = get_wsi_data(*filename);
+    return anonymize_wsi_data(wsi_data, filename, new_label_name, keep_macro_image, disable_unlinking, do_inplace);
+}
+
 int32_t anonymize_wsi_inplace(const char *filename, const char *new_label_name, bool keep_macro_image,
                               bool disable_unlinking) {
     return anonymize_wsi_with_result(&filename, new_label_name, keep_macro_image, disable_unlinking, true);
 }
 
+// anonymize a file with the options of the given context, a non-zero seed makes the
+// pseudonymized values reproducible without affecting later calls on the same thread
+int32_t anonymize_wsi_with_context(const char *filename, const struct anonymization_context *context) {
+    if (context->random_seed == 0) {
+        return anonymize_wsi_with_result(&filename, context->new_label_name, context->keep_macro_image,
+                                         context->disable_unlinking, context->do_inplace);
+    }
+    uint64_t random_state = get_random_state();
+    seed_random(context->random_seed);
+    int32_t result = anonymize_wsi_with_result(&filename, context->new_label_name, context->keep_macro_image,
+                                               context->disable_unlinking, context->do_inplace);
+    set_random_state(random_state);
+    return result;
+}
+
+// anonymize a file like anonymize_wsi_with_context and collect file operations,
+// allocations and the time spent in each phase of the anonymization into stats
+int32_t anonymize_wsi_ex(const char *filename, const struct anonymization_context *context,
+                         struct anonymization_stats *stats) {
+    stats_start_recording(stats);
+    int32_t result = anonymize_wsi_with_context(filename, context);
+    stats_stop_recording();
+    return result;
+}
+
 int32_t anonymize_wsi(const char *filename, const char *new_label_name, bool keep_macro_image, bool disable_unlinking,
                       bool do_inplace) {
     return anonymize_wsi_with_result(&filename, new_label_name, keep_macro_image, disable_unlinking, do_inplace);
 }
 
-void free_wsi_data(struct wsi_data *wsi_data) {
-    if (wsi_data->metadata_attributes != NULL) {
-        for (size_t metadata_id = 0; metadata_id < wsi_data->metadata_attributes->length; metadata_id++) {
-            wsi_data->metadata_attributes->attributes[metadata_id]->key = NULL;
-            wsi_data->metadata_attributes->attributes[metadata_id]->value = NULL;
-            free(wsi_data->metadata_attributes->attributes[metadata_id]);
+int32_t anonymize_wsi_to_delta(const char *filename, const char *delta_filename, bool keep_macro_image,
+                               bool disable_unlinking) {
+    // the file is anonymized in-place, but all writes are recorded into the delta
+    struct file_delta *delta = init_file_delta();
+    if (file_start_delta_recording(filename, delta) != 0) {
+        free_file_delta(delta);
+        return -1;
+    }
+
+    int32_t result = -1;
+    struct wsi_data *wsi_data = get_wsi_data(filename);
+    if (wsi_data->format == MIRAX) {
+        // mirax slides consist of several files
+        fprintf(stderr, "Error: Delta output is not supported for Mirax files.\n");
+        free_wsi_data(wsi_data);
+    } else {
+        result = anonymize_wsi_data(wsi_data, &filename, NULL, keep_macro_image, disable_unlinking, true);
+    }
+    file_stop_delta_recording();
+
+    if (result == 0) {
+        result = write_delta_file(delta, delta_filename);
+    }
+    free_file_delta(delta);
+    return result;
+}
+
+// anonymize a tiff based slide read from the input and write it to the output. the file structure
+// is parsed from a lookahead buffer of at most lookahead_size bytes at the beginning of the input,
+// the remaining bytes are passed through with the changes of the anonymization applied
+int32_t anonymize_wsi_stream(FILE *input, FILE *output, const char *extension, uint64_t lookahead_size,
+                             bool keep_macro_image, bool disable_unlinking) {
+    if (!has_tiff_based_extension(extension)) {
+        fprintf(stderr, "Error: Streaming is only supported for tiff based formats.\n");
+        return -1;
+    }
+
+    // the input is opened by the handlers under a file name carrying the extension
+    const char *filename = concat_str("stdin.", extension);
+    struct stream_source source = {input, NULL, 0, 0, lookahead_size, false, false};
+    struct file_delta *delta = init_file_delta();
+    if (file_start_stream_recording(filename, &source, delta) != 0) {
+        free_file_delta(delta);
+        free((void *)filename);
+        return -1;
+    }
+
+    int32_t result = -1;
+    struct wsi_data *wsi_data = get_wsi_data(filename);
+    if (wsi_data->tiff_file == NULL) {
+        fprintf(stderr, "Error: Input is not a slide in %s format.\n", extension);
+        free_wsi_data(wsi_data);
+    } else {
+        result = anonymize_wsi_data(wsi_data, &filename, NULL, keep_macro_image, disable_unlinking, true);
+    }
+    file_stop_delta_recording();
+
+    // handlers skip some associated images that are not found, which may be
+    // the case for images behind the lookahead
+    if (result == 0 && source.exceeded) {
+        fprintf(stderr, "Error: Slide could not be anonymized within the lookahead.\n");
+        result = -1;
+    }
+    if (result == 0) {
+        result = stream_with_delta(&source, delta, output);
+    }
+    free(source.buffer);
+    free_file_delta(delta);
+    free((void *)filename);
+    return result;
+}
+
+void free_metadata(struct metadata *metadata) {
+    if (metadata != NULL) {
+        for (size_t metadata_id = 0; metadata_id < metadata->length; metadata_id++) {
+            metadata->attributes[metadata_id]->key = NULL;
+            metadata->attributes[metadata_id]->value = NULL;
+            free(metadata->attributes[metadata_id]);
         }
-        free(wsi_data->metadata_attributes->attributes);
-        free(wsi_data->metadata_attributes);
+        free(metadata->attributes);
+        free(metadata);
+    }
+}
+
+void free_wsi_data(struct wsi_data *wsi_data) {
+    free_metadata(wsi_data->metadata_attributes);
+    if (wsi_data->tiff_file != NULL) {
+        free_tiff_file(wsi_data->tiff_file);
     }
     free(wsi_data);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "aperio-flavor-io.h"
 #include "defines.h"
+#include "file-delta.h"
 #include "hamamatsu-io.h"
 #include "isyntax-io.h"
 #include "mirax-io.h"
@@ -10,17 +11,38 @@
 #include "plugin.h"
 #include "ventana-io.h"
 
-static const char *VENDOR_AND_FORMAT_STRINGS[] = {"Aperio",          "Hamamatsu",    "3DHistech (Mirax)", "Ventana",
-                                                  "Philips iSyntax", "Philips TIFF", "Unknown",           "Invalid"};
+static const char *const VENDOR_AND_FORMAT_STRINGS[] = {"Aperio",          "Hamamatsu",    "3DHistech (Mirax)",
+                                                        "Ventana",         "Philips iSyntax", "Philips TIFF",
+                                                        "Unknown",         "Invalid"};
 
 extern struct wsi_data *get_wsi_data(const char *filename);
 
+extern int32_t anonymize_wsi_data(struct wsi_data *wsi_data, const char **filename, const char *new_label_name,
+                                  bool keep_macro_image, bool disable_unlinking, bool do_inplace);
+
 extern int32_t anonymize_wsi_inplace(const char *filename, const char *new_label_name, bool keep_macro_image,
                                      bool disable_unlinking);
 
 extern int32_t anonymize_wsi(const char *filename, const char *new_label_name, bool keep_macro_image,
                              bool disable_unlinking, bool do_inplace);
 
+extern int32_t anonymize_wsi_with_context(const char *filename, const struct anonymization_context *context);
+
+extern int32_t anonymize_wsi_ex(const char *filename, const struct anonymization_context *context,
+                                struct anonymization_stats *stats);
+
+extern int32_t anonymize_wsi_to_delta(const char *filename, const char *delta_filename, bool keep_macro_image,
+                                      bool disable_unlinking);
+
+extern int32_t apply_delta(const char *filename, const char *delta_filename, const char *output_filename);
+
+extern int32_t stream_delta(const char *filename, const char *delta_filename, FILE *output);
+
+extern int32_t anonymize_wsi_stream(FILE *input, FILE *output, const char *extension, uint64_t lookahead_size,
+                                    bool keep_macro_image, bool disable_unlinking);
+
+extern void free_metadata(struct metadata *metadata);
+
 extern void free_wsi_data(struct wsi_data *wsi_data);
 
 #endif
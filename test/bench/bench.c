@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include "../../src/file-api.h"
+#include "../../src/tiff-based-io.h"
+#include "../../src/utils.h"
+#include "../../src/wsi-anonymizer.h"
+#include "slide-generator.h"
+
+#define BENCH_DEFAULT_IMAGE_SIZE 64
+#define BENCH_DEFAULT_LEVELS 4
+#define BENCH_DEFAULT_REPETITIONS 5
+#define BENCH_MAX_REPETITIONS 1000
+
+// phases of an anonymization. wipe only overwrites label and macro image, anonymize additionally
+// unlinks them. the time needed for unlinking is taken from the statistics of the anonymization
+enum bench_phase {
+    BENCH_COPY, BENCH_DETECT, BENCH_PARSE, BENCH_METADATA, BENCH_WIPE, BENCH_ANONYMIZE, BENCH_UNLINK, BENCH_PHASE_COUNT
+};
+
+static const char *const BENCH_PHASE_NAMES[] = {"copy", "detect", "parse", "metadata", "wipe", "anonymize", "unlink"};
+
+struct bench_format {
+    const char *name;
+    const char *extension;
+    FILE_FORMAT format;
+    bool gt450;
+};
+
+static const struct bench_format BENCH_FORMATS[] = {
+    {"aperio", "svs", APERIO, false},  {"aperio-gt450", "svs", APERIO, true}, {"hamamatsu", "ndpi", HAMAMATSU, false},
+    {"ventana", "bif", VENTANA, false}, {"philips-tiff", "tiff", PHILIPS_TIFF, false},
+    {"isyntax", "isyntax", PHILIPS_ISYNTAX, false}, {"mirax", "mrxs", MIRAX, false}};
+
+struct bench_result {
+    // duration of every repetition in milliseconds, negative if the phase does not apply
+    double timings[BENCH_PHASE_COUNT][BENCH_MAX_REPETITIONS];
+    uint64_t file_size;
+    bool failed;
+};
+
+static double get_time_ms() {
+    struct timespec ts;
+#if defined(_WIN32)
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double difference = *(const double *)a - *(const double *)b;
+    return (difference > 0) - (difference < 0);
+}
+
+static int32_t generate_slide(const struct bench_format *format, const char *filename,
+                              const struct slide_options *options) {
+    switch (format->format) {
+    case APERIO:
+        return generate_aperio(filename, options, format->gt450);
+    case HAMAMATSU:
+        return generate_ndpi(filename, options);
+    case VENTANA:
+        return generate_ventana(filename, options);
+    case PHILIPS_TIFF:
+        return generate_philips_tiff(filename, options);
+    case PHILIPS_ISYNTAX:
+        return generate_isyntax(filename, options);
+    case MIRAX:
+        return generate_mirax(filename, options);
+    default:
+        return -1;
+    }
+}
+
+// the data of a mirax slide is stored in a directory named like the slide without extension
+static char *get_data_directory(const char *filename) {
+    char *directory = strdup(filename);
+    char *ext = strrchr(directory, '.');
+    if (ext != NULL) {
+        *ext = '\0';
+    }
+    return directory;
+}
+
+// mirax slides are copied together with their data directory
+static int32_t copy_slide(const struct bench_format *format, const char *src, const char *dest) {
+    if (format->format == MIRAX) {
+        char *src_directory = get_data_directory(src);
+        char *dest_directory = get_data_directory(dest);
+        int32_t result = copy_directory(src_directory, dest_directory);
+        free(src_directory);
+        free(dest_directory);
+        if (result != 0) {
+            return -1;
+        }
+    }
+    return copy_file_v2(src, dest);
+}
+
+static uint64_t get_file_size(const char *filename) {
+    file_handle *fp = file_open(filename, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+    file_seek(fp, 0, SEEK_END);
+    uint64_t size = file_tell(fp);
+    file_close(fp);
+    return size;
+}
+
+// the image data of mirax slides is stored in the data file
+static uint64_t get_slide_size(const struct bench_format *format, const char *filename) {
+    uint64_t size = get_file_size(filename);
+    if (format->format == MIRAX) {
+        char *directory = get_data_directory(filename);
+        const char *data_filename = concat_path_filename(directory, "Data0000.dat");
+        size += get_file_size(data_filename);
+        free((void *)data_filename);
+        free(directory);
+    }
+    return size;
+}
+
+// read the file structure and the metadata of a slide, this is done by the format detection as well
+static int32_t parse_slide(const struct bench_format *format, const char *filename, double *parse_time,
+                           double *metadata_time) {
+    double start = get_time_ms();
+    file_handle *fp = file_open_mapped(filename, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    struct metadata *metadata = NULL;
+    if (format->format == PHILIPS_ISYNTAX) {
+        uint64_t header_size;
+        int32_t result = find_value_in_file(fp, ISYNTAX_EOT, &header_size);
+        *parse_time = get_time_ms() - start;
+        if (result != 0) {
+            file_close(fp);
+            return -1;
+        }
+        start = get_time_ms();
+        metadata = get_metadata_isyntax(fp, header_size);
+    } else {
+        struct tiff_file *file = read_tiff_file_with_header(fp, format->format == HAMAMATSU);
+        *parse_time = get_time_ms() - start;
+        if (file == NULL) {
+            file_close(fp);
+            return -1;
+        }
+        start = get_time_ms();
+        if (format->format == APERIO) {
+            metadata = get_metadata_aperio(fp, file);
+        } else if (format->format == HAMAMATSU) {
+            metadata = get_metadata_hamamatsu(fp, file);
+        } else if (format->format == VENTANA) {
+            metadata = get_metadata_ventana(fp, file);
+        } else {
+            metadata = get_metadata_philips_tiff(fp, file);
+        }
+        free_tiff_file(file);
+    }
+    *metadata_time = get_time_ms() - start;
+    free_metadata(metadata);
+    file_close(fp);
+    return 0;
+}
+
+// run all phases of a single repetition on a fresh copy of the pristine slide
+static int32_t run_repetition(const struct bench_format *format, const char *pristine, const char *work,
+                              struct bench_result *result, int32_t repetition) {
+    double start = get_time_ms();
+    if (copy_slide(format, pristine, work) != 0) {
+        return -1;
+    }
+    result->timings[BENCH_COPY][repetition] = get_time_ms() - start;
+
+    start = get_time_ms();
+    struct wsi_data *wsi_data = get_wsi_data(work);
+    result->timings[BENCH_DETECT][repetition] = get_time_ms() - start;
+    bool detected = wsi_data != NULL && wsi_data->format == format->format;
+    if (wsi_data != NULL) {
+        free_wsi_data(wsi_data);
+    }
+    if (!detected) {
+        fprintf(stderr, "Error: Generated %s slide was not detected.\n", format->name);
+        return -1;
+    }
+
+    // mirax slides are not parsed from a single file
+    result->timings[BENCH_PARSE][repetition] = -1;
+    result->timings[BENCH_METADATA][repetition] = -1;
+    if (format->format != MIRAX && parse_slide(format, work, &result->timings[BENCH_PARSE][repetition],
+                                               &result->timings[BENCH_METADATA][repetition]) != 0) {
+        return -1;
+    }
+
+    start = get_time_ms();
+    if (anonymize_wsi(work, NULL, false, true, true) != 0) {
+        return -1;
+    }
+    result->timings[BENCH_WIPE][repetition] = get_time_ms() - start;
+
+    if (copy_slide(format, pristine, work) != 0) {
+        return -1;
+    }
+    struct anonymization_context context = {NULL, false, false, true, 0};
+    struct anonymization_stats stats;
+    start = get_time_ms();
+    if (anonymize_wsi_ex(work, &context, &stats) != 0) {
+        return -1;
+    }
+    result->timings[BENCH_ANONYMIZE][repetition] = get_time_ms() - start;
+    result->timings[BENCH_UNLINK][repetition] = stats.phase_seconds[PHASE_UNLINK] * 1000;
+    return 0;
+}
+
+static void write_phase(FILE *output, const double *timings, int32_t repetitions) {
+    double sorted[BENCH_MAX_REPETITIONS];
+    double sum = 0;
+    memcpy(sorted, timings, repetitions * sizeof(double));
+    qsort(sorted, repetitions, sizeof(double), compare_doubles);
+    for (int32_t i = 0; i < repetitions; i++) {
+        sum += sorted[i];
+    }
+    double median = repetitions % 2 == 1 ? sorted[repetitions / 2]
+                                         : (sorted[repetitions / 2 - 1] + sorted[repetitions / 2]) / 2;
+    fprintf(output, "{\"min_ms\": %.3f, \"median_ms\": %.3f, \"mean_ms\": %.3f}", sorted[0], median,
+            sum / repetitions);
+}
+
+static int32_t write_results(const char *filename, const struct bench_result *results,
+                             const struct slide_options *options, int32_t repetitions) {
+    FILE *output = fopen(filename, "w");
+    if (output == NULL) {
+        fprintf(stderr, "Error: Could not create %s.\n", filename);
+        return -1;
+    }
+
+    fprintf(output, "{\n  \"image_size\": %llu,\n  \"levels\": %d,\n  \"large_offsets\": %s,\n",
+            (unsigned long long)options->image_size, options->num_levels, options->large_offsets ? "true" : "false");
+    fprintf(output, "  \"repetitions\": %d,\n  \"results\": [", repetitions);
+    size_t num_formats = sizeof(BENCH_FORMATS) / sizeof(BENCH_FORMATS[0]);
+    for (size_t i = 0; i < num_formats; i++) {
+        fprintf(output, "%s\n    {\"format\": \"%s\", \"file_size\": %llu, \"success\": %s, \"phases\": {",
+                i > 0 ? "," : "", BENCH_FORMATS[i].name, (unsigned long long)results[i].file_size,
+                results[i].failed ? "false" : "true");
+        bool first = true;
+        for (int32_t phase = 0; phase < BENCH_PHASE_COUNT && !results[i].failed; phase++) {
+            if (results[i].timings[phase][0] < 0) {
+                continue;
+            }
+            fprintf(output, "%s\n      \"%s\": ", first ? "" : ",", BENCH_PHASE_NAMES[phase]);
+            write_phase(output, results[i].timings[phase], repetitions);
+            first = false;
+        }
+        fprintf(output, "%s}}", first ? "" : "\n    ");
+    }
+    fprintf(output, "\n  ]\n}\n");
+    return fclose(output) == 0 ? 0 : -1;
+}
+
+void print_help() {
+    printf("\nUsage: ./wsi-anon-bench [-OPTIONS]\n\n");
+    printf("Generates a synthetic slide for every supported format and measures each phase of the\n");
+    printf("anonymization. The results are written as JSON.\n\n");
+    printf("OPTIONS:\n");
+    printf("-s <size>   Size of the image data of the base level in MiB (default %d)\n", BENCH_DEFAULT_IMAGE_SIZE);
+    printf("-d <levels> Number of pyramid levels (default %d)\n", BENCH_DEFAULT_LEVELS);
+    printf("-r <count>  Number of repetitions (default %d)\n", BENCH_DEFAULT_REPETITIONS);
+    printf("-l          Store the macro image of Hamamatsu slides behind 4 GiB (sparse file)\n");
+    printf("-q          Read and write the slides with io_uring instead of a memory mapping\n");
+    printf("-w <dir>    Working directory for the generated slides (default bench-slides)\n");
+    printf("-o <file>   Output file for the results (default bench-results.json)\n");
+    printf("-h          Prints this help\n\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct slide_options options = {(uint64_t)BENCH_DEFAULT_IMAGE_SIZE << 20, BENCH_DEFAULT_LEVELS, false};
+    int32_t repetitions = BENCH_DEFAULT_REPETITIONS;
+    const char *work_directory = "bench-slides";
+    const char *output_filename = "bench-results.json";
+
+    for (int32_t i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-l") == 0) {
+            options.large_offsets = true;
+        } else if (strcmp(arg, "-q") == 0) {
+            if (file_use_io_uring(true) != 0) {
+                fprintf(stderr, "Error: io_uring is not supported on this system.\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "-h") == 0) {
+            print_help();
+            return 0;
+        } else if (value != NULL && strcmp(arg, "-s") == 0) {
+            options.image_size = strtoull(value, NULL, 10) << 20;
+            i++;
+        } else if (value != NULL && strcmp(arg, "-d") == 0) {
+            options.num_levels = atoi(value);
+            i++;
+        } else if (value != NULL && strcmp(arg, "-r") == 0) {
+            repetitions = atoi(value);
+            i++;
+        } else if (value != NULL && strcmp(arg, "-w") == 0) {
+            work_directory = value;
+            i++;
+        } else if (value != NULL && strcmp(arg, "-o") == 0) {
+            output_filename = value;
+            i++;
+        } else {
+            print_help();
+            return 1;
+        }
+    }
+    if (options.image_size == 0 || options.num_levels < 1 || options.num_levels > GENERATOR_MAX_LEVELS ||
+        repetitions < 1 || repetitions > BENCH_MAX_REPETITIONS) {
+        fprintf(stderr, "Error: Invalid benchmark options.\n");
+        return 1;
+    }
+#if defined(_WIN32)
+    _mkdir(work_directory);
+#else
+    mkdir(work_directory, 0755);
+#endif
+
+    size_t num_formats = sizeof(BENCH_FORMATS) / sizeof(BENCH_FORMATS[0]);
+    struct bench_result *results = (struct bench_result *)calloc(num_formats, sizeof(struct bench_result));
+    int32_t failures = 0;
+    for (size_t i = 0; i < num_formats; i++) {
+        const struct bench_format *format = &BENCH_FORMATS[i];
+        char pristine_name[64], work_name[64];
+        snprintf(pristine_name, sizeof(pristine_name), "%s.%s", format->name, format->extension);
+        snprintf(work_name, sizeof(work_name), "%s-work.%s", format->name, format->extension);
+        const char *pristine = concat_path_filename(work_directory, pristine_name);
+        const char *work = concat_path_filename(work_directory, work_name);
+
+        // every repetition starts from the same pristine slide
+        results[i].failed = generate_slide(format, pristine, &options) != 0;
+        results[i].file_size = get_slide_size(format, pristine);
+        for (int32_t repetition = 0; repetition < repetitions && !results[i].failed; repetition++) {
+            results[i].failed = run_repetition(format, pristine, work, &results[i], repetition) != 0;
+        }
+        if (results[i].failed) {
+            fprintf(stderr, "Error: Benchmark of %s failed.\n", format->name);
+            failures++;
+        }
+        free((void *)pristine);
+        free((void *)work);
+    }
+
+    int32_t result = write_results(output_filename, results, &options, repetitions);
+    if (result == 0) {
+        printf("Benchmark results written to %s.\n", output_filename);
+    }
+    free(results);
+    return result == 0 && failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,555 @@
+#include "slide-generator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+
+#include "../../src/b64.h"
+#include "../../src/defines.h"
+#include "../../src/file-api.h"
+#include "../../src/utils.h"
+
+// a tiff entry holds either an inline value or external data, which is written in front of its directory
+struct generated_entry {
+    uint16_t tag;
+    uint16_t type;
+    uint64_t count;
+    uint64_t value;
+    const void *data;
+    size_t length;
+};
+
+struct generated_directory {
+    struct generated_entry entries[GENERATOR_MAX_ENTRIES];
+    int32_t count;
+};
+
+// writes a tiff file from front to back. data placed behind 4 GiB in ndpi files is written
+// separately, so that all directories stay in the first 4 GiB
+struct tiff_writer {
+    file_handle *fp;
+    bool big_tiff;
+    bool ndpi;
+    uint64_t end;
+    uint64_t next_pointer_offset;
+};
+
+// image data is a repeated block of pseudo random bytes
+static uint8_t *get_random_block() {
+    static uint8_t block[GENERATOR_STRIP_SIZE];
+    static bool initialized = false;
+    if (!initialized) {
+        uint64_t state = 0x9e3779b97f4a7c15ULL;
+        for (size_t i = 0; i < sizeof(block); i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            block[i] = (uint8_t)state;
+        }
+        initialized = true;
+    }
+    return block;
+}
+
+static void add_value(struct generated_directory *dir, uint16_t tag, uint16_t type, uint64_t count, uint64_t value) {
+    dir->entries[dir->count++] = (struct generated_entry){tag, type, count, value, NULL, 0};
+}
+
+static void add_data(struct generated_directory *dir, uint16_t tag, uint16_t type, uint64_t count, const void *data,
+                     size_t length) {
+    dir->entries[dir->count++] = (struct generated_entry){tag, type, count, 0, data, length};
+}
+
+static void add_string(struct generated_directory *dir, uint16_t tag, const char *value) {
+    add_data(dir, tag, TIFF_ASCII, strlen(value) + 1, value, strlen(value) + 1);
+}
+
+static int32_t write_le(file_handle *fp, uint64_t value, int32_t size) {
+    uint8_t buffer[8];
+    for (int32_t i = 0; i < size; i++) {
+        buffer[i] = (value >> (8 * i)) & 0xff;
+    }
+    return file_write(buffer, size, 1, fp) == 1 ? 0 : -1;
+}
+
+static int32_t write_at(file_handle *fp, uint64_t offset, const void *data, size_t length) {
+    if (file_seek(fp, offset, SEEK_SET) != 0 || (length > 0 && file_write(data, length, 1, fp) != 1)) {
+        fprintf(stderr, "Error: Could not write generated slide.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t begin_tiff(struct tiff_writer *writer, const char *filename, bool big_tiff, bool ndpi) {
+    writer->fp = file_open(filename, "wb+");
+    if (writer->fp == NULL) {
+        fprintf(stderr, "Error: Could not create %s.\n", filename);
+        return -1;
+    }
+    writer->big_tiff = big_tiff;
+    writer->ndpi = ndpi;
+
+    // the offset of the first directory is set when the directory is written
+    uint8_t header[16] = {'I', 'I', big_tiff ? TIFF_VERSION_BIG : TIFF_VERSION_CLASSIC, 0, 8, 0, 0, 0};
+    size_t header_size = big_tiff ? 16 : (ndpi ? 12 : 8);
+    writer->next_pointer_offset = big_tiff ? 8 : 4;
+    writer->end = header_size;
+    return write_at(writer->fp, 0, header, header_size);
+}
+
+static int32_t end_tiff(struct tiff_writer *writer) { return file_close(writer->fp) == 0 ? 0 : -1; }
+
+// append data at the end of the written part of the file and return its offset
+static uint64_t append_data(struct tiff_writer *writer, const void *data, size_t length) {
+    uint64_t offset = writer->end;
+    if (write_at(writer->fp, offset, data, length) != 0) {
+        return 0;
+    }
+    writer->end += length + (length % 2);
+    return offset;
+}
+
+// write strips of random image data starting with an optional prefix at the given offset and
+// return the offset behind them
+static uint64_t write_strips(struct tiff_writer *writer, uint64_t offset, uint64_t size, const char *prefix,
+                             int32_t *count, uint64_t **offsets, uint64_t **lengths) {
+    *count = (int32_t)((size + GENERATOR_STRIP_SIZE - 1) / GENERATOR_STRIP_SIZE);
+    *offsets = (uint64_t *)malloc(*count * sizeof(uint64_t));
+    *lengths = (uint64_t *)malloc(*count * sizeof(uint64_t));
+    for (int32_t i = 0; i < *count; i++) {
+        uint64_t length = size - (uint64_t)i * GENERATOR_STRIP_SIZE;
+        (*lengths)[i] = length < GENERATOR_STRIP_SIZE ? length : GENERATOR_STRIP_SIZE;
+        (*offsets)[i] = offset;
+        if (write_at(writer->fp, offset, get_random_block(), (*lengths)[i]) != 0 ||
+            (prefix != NULL && write_at(writer->fp, offset, prefix, strlen(prefix)) != 0)) {
+            return 0;
+        }
+        offset += (*lengths)[i];
+    }
+    return offset;
+}
+
+// append strips of random image data and add them to a directory
+static int32_t add_strips(struct tiff_writer *writer, struct generated_directory *dir, uint64_t size,
+                          const char *prefix, uint16_t offsets_tag, uint16_t lengths_tag) {
+    int32_t count;
+    uint64_t *offsets, *lengths;
+    uint64_t end = write_strips(writer, writer->end, size, prefix, &count, &offsets, &lengths);
+    if (end == 0) {
+        free(offsets);
+        free(lengths);
+        return -1;
+    }
+    writer->end = end + (end % 2);
+
+    // single strips are stored inline, the arrays are stored as long or long8
+    if (count == 1) {
+        uint16_t type = writer->big_tiff ? TIFF_LONG8 : TIFF_LONG;
+        add_value(dir, offsets_tag, type, 1, offsets[0]);
+        add_value(dir, lengths_tag, type, 1, lengths[0]);
+    } else {
+        int32_t size_of_value = writer->big_tiff ? 8 : 4;
+        uint8_t *values = (uint8_t *)malloc(2 * count * size_of_value);
+        for (int32_t i = 0; i < count; i++) {
+            memcpy(values + i * size_of_value, &offsets[i], size_of_value);
+            memcpy(values + (count + i) * size_of_value, &lengths[i], size_of_value);
+        }
+        uint16_t type = writer->big_tiff ? TIFF_LONG8 : TIFF_LONG;
+        uint64_t offsets_offset = append_data(writer, values, count * size_of_value);
+        uint64_t lengths_offset = append_data(writer, values + count * size_of_value, count * size_of_value);
+        free(values);
+        add_value(dir, offsets_tag, type, count, offsets_offset);
+        add_value(dir, lengths_tag, type, count, lengths_offset);
+    }
+    free(offsets);
+    free(lengths);
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return (int)((const struct generated_entry *)a)->tag - (int)((const struct generated_entry *)b)->tag;
+}
+
+// write the external data and the directory itself and link it to its predecessor
+static int32_t write_directory(struct tiff_writer *writer, struct generated_directory *dir) {
+    qsort(dir->entries, dir->count, sizeof(struct generated_entry), compare_entries);
+    size_t inline_size = writer->big_tiff ? 8 : 4;
+    for (int32_t i = 0; i < dir->count; i++) {
+        struct generated_entry *entry = &dir->entries[i];
+        if (entry->data != NULL) {
+            if (entry->length > inline_size) {
+                entry->value = append_data(writer, entry->data, entry->length);
+            } else {
+                memcpy(&entry->value, entry->data, entry->length);
+            }
+        }
+    }
+
+    // ndpi directories have an 8 byte successor offset, the high bytes of all
+    // values are stored behind it, starting with its upper half
+    size_t count_size = writer->big_tiff ? 8 : 2;
+    size_t entry_size = writer->big_tiff ? 20 : 12;
+    size_t pointer_size = (writer->big_tiff || writer->ndpi) ? 8 : 4;
+    size_t block_size = count_size + dir->count * entry_size + pointer_size;
+    if (writer->ndpi) {
+        block_size += 4 * dir->count - 4;
+    }
+    uint8_t *block = (uint8_t *)calloc(block_size, 1);
+    memcpy(block, &(uint64_t){(uint64_t)dir->count}, count_size);
+    for (int32_t i = 0; i < dir->count; i++) {
+        struct generated_entry *entry = &dir->entries[i];
+        uint8_t *raw_entry = block + count_size + i * entry_size;
+        size_t count_field_size = writer->big_tiff ? 8 : 4;
+        memcpy(raw_entry, &entry->tag, 2);
+        memcpy(raw_entry + 2, &entry->type, 2);
+        memcpy(raw_entry + 4, &entry->count, count_field_size);
+        memcpy(raw_entry + 4 + count_field_size, &entry->value, inline_size);
+        if (writer->ndpi) {
+            uint32_t high_bits = (uint32_t)(entry->value >> 32);
+            memcpy(block + count_size + dir->count * entry_size + 4 + 4 * i, &high_bits, 4);
+        }
+    }
+
+    // directories start at word boundaries
+    writer->end += writer->end % 2;
+    uint64_t dir_offset = append_data(writer, block, block_size);
+    free(block);
+    if (dir_offset == 0 || file_seek(writer->fp, writer->next_pointer_offset, SEEK_SET) != 0 ||
+        write_le(writer->fp, dir_offset, pointer_size) != 0) {
+        fprintf(stderr, "Error: Could not write generated directory.\n");
+        return -1;
+    }
+    writer->next_pointer_offset = dir_offset + count_size + dir->count * entry_size;
+    return 0;
+}
+
+// size of a pyramid level, every level is a quarter of its predecessor
+static uint64_t get_level_size(const struct slide_options *options, int32_t level) {
+    uint64_t size = options->image_size >> (2 * level);
+    return size > 0 ? size : 1;
+}
+
+// size of the image data of a directory, the pyramid levels are followed by label and macro image
+static uint64_t get_image_size(const struct slide_options *options, int32_t index) {
+    if (index == options->num_levels) {
+        return GENERATOR_LABEL_SIZE;
+    }
+    return index > options->num_levels ? GENERATOR_MACRO_SIZE : get_level_size(options, index);
+}
+
+int32_t generate_aperio(const char *filename, const struct slide_options *options, bool gt450) {
+    struct tiff_writer writer;
+    if (begin_tiff(&writer, filename, gt450, false) != 0) {
+        return -1;
+    }
+
+    static const char DESCRIPTION[] =
+        "Aperio Image Library v12.0.15 %s\r\n46000x32914 [0,100 46000x32914] (240x240) JPEG/RGB Q=70|AppMag = 20"
+        "|StripeWidth = 2040|ScanScope ID = CPAPERIOCS|Filename = CMU-1|Date = 12/29/09|Time = 09:59:15"
+        "|User = b414003d-95c6-48b0-9369-8010ed517ba7|Slide = 12|Barcode = ABC123|Rack = 7|MPP = 0.4990";
+    char description[sizeof(DESCRIPTION) + 8];
+    snprintf(description, sizeof(description), DESCRIPTION, gt450 ? "GT450" : "");
+
+    // pyramid levels, followed by label and macro image
+    int32_t result = 0;
+    for (int32_t level = 0; level < options->num_levels + 2 && result == 0; level++) {
+        struct generated_directory dir = {.count = 0};
+        bool is_label = level == options->num_levels;
+        bool is_macro = level == options->num_levels + 1;
+        uint64_t size = get_image_size(options, level);
+        add_value(&dir, TIFFTAG_SUBFILETYPE, TIFF_LONG, 1, is_label ? 1 : (is_macro ? 9 : 0));
+        add_value(&dir, TIFFTAG_COMPRESSION, TIFF_SHORT, 1, is_macro ? 7 : COMPRESSION_LZW);
+        add_string(&dir, TIFFTAG_IMAGEDESCRIPTION,
+                   level == 0 ? description
+                              : (is_label ? "Aperio Image Library v12\r\nlabel 387x463"
+                                          : (is_macro ? "Aperio Image Library v12\r\nmacro 1280x431"
+                                                      : "Aperio Image Library v12\r\n46000x32914 -> 11500x8228")));
+        // lzw compressed label strips start with a clear code
+        result = add_strips(&writer, &dir, size, is_label ? LZW_CLEARCODE : NULL, TIFFTAG_STRIPOFFSETS,
+                            TIFFTAG_STRIPBYTECOUNTS);
+        if (result == 0) {
+            result = write_directory(&writer, &dir);
+        }
+    }
+    return end_tiff(&writer) == 0 ? result : -1;
+}
+
+int32_t generate_ndpi(const char *filename, const struct slide_options *options) {
+    struct tiff_writer writer;
+    if (begin_tiff(&writer, filename, false, true) != 0) {
+        return -1;
+    }
+
+    // pyramid levels followed by the macro image, which is identified by a source lens of -1
+    int32_t result = 0;
+    for (int32_t level = 0; level < options->num_levels + 1 && result == 0; level++) {
+        struct generated_directory dir = {.count = 0};
+        bool is_macro = level == options->num_levels;
+        float source_lens = is_macro ? -1.0f : 20.0f / (1 << (2 * level));
+        uint32_t source_lens_value;
+        memcpy(&source_lens_value, &source_lens, sizeof(source_lens_value));
+        add_value(&dir, TIFFTAG_SUBFILETYPE, TIFF_LONG, 1, 0);
+        add_value(&dir, TIFFTAG_COMPRESSION, TIFF_SHORT, 1, 7);
+        add_string(&dir, TIFFTAG_DATETIME, "2019:05:03 10:11:12");
+        add_value(&dir, NDPI_FORMAT_FLAG, TIFF_LONG, 1, 1);
+        add_value(&dir, NDPI_SOURCELENS, TIFF_FLOAT, 1, source_lens_value);
+        add_string(&dir, NDPI_REFERENCE, "REF-1234567");
+        add_string(&dir, NDPI_SCANNER_SERIAL_NUMBER, "SN1234567");
+
+        // ndpi levels are stored as a single jpeg, the macro image may be placed behind 4 GiB
+        uint64_t size = is_macro ? GENERATOR_MACRO_SIZE : get_level_size(options, level);
+        uint64_t far_offset = is_macro && options->large_offsets ? GENERATOR_LARGE_OFFSET : 0;
+        int32_t count;
+        uint64_t *offsets, *lengths;
+        uint64_t offset = far_offset != 0 ? far_offset : writer.end;
+        uint64_t end = 0;
+        if (write_at(writer.fp, offset, JPEG_SOI, strlen(JPEG_SOI)) == 0) {
+            end = write_strips(&writer, offset + strlen(JPEG_SOI), size, NULL, &count, &offsets, &lengths);
+            free(offsets);
+            free(lengths);
+        }
+        if (end == 0) {
+            result = -1;
+            break;
+        }
+        if (far_offset == 0) {
+            writer.end = end + (end % 2);
+        }
+        add_value(&dir, TIFFTAG_STRIPOFFSETS, TIFF_LONG, 1, offset);
+        add_value(&dir, TIFFTAG_STRIPBYTECOUNTS, TIFF_LONG, 1, end - offset);
+        result = write_directory(&writer, &dir);
+    }
+    return end_tiff(&writer) == 0 ? result : -1;
+}
+
+int32_t generate_ventana(const char *filename, const struct slide_options *options) {
+    struct tiff_writer writer;
+    if (begin_tiff(&writer, filename, true, false) != 0) {
+        return -1;
+    }
+
+    static const char XMP[] =
+        "<?xml version=\"1.0\"?><Metadata><iScan BaseName=\"SLIDE-123\" JP2FileName=\"SLIDE-123.jp2\" "
+        "UnitNumber=\"U5\" UserName='operator' BuildDate=\"2020-01-01\" Barcode1D=\"BC1D\" Barcode2D='BC2D'/>"
+        "</Metadata>";
+
+    // tiled label image followed by the pyramid levels
+    int32_t result = 0;
+    for (int32_t level = -1; level < options->num_levels && result == 0; level++) {
+        struct generated_directory dir = {.count = 0};
+        add_value(&dir, TIFFTAG_SUBFILETYPE, TIFF_LONG, 1, 0);
+        add_string(&dir, TIFFTAG_DATETIME, "2020:01:01 10:00:00");
+        if (level < 0) {
+            add_string(&dir, TIFFTAG_IMAGEDESCRIPTION, "Label Image");
+            add_value(&dir, 322, TIFF_SHORT, 1, 256);
+            add_value(&dir, 323, TIFF_SHORT, 1, 256);
+            result = add_strips(&writer, &dir, GENERATOR_LABEL_SIZE, NULL, TIFFTAG_TILEOFFSETS,
+                                TIFFTAG_TILEBYTECOUNTS);
+        } else {
+            char description[32];
+            snprintf(description, sizeof(description), "level=%d mag=%d", level, 40 >> (2 * level));
+            add_data(&dir, TIFFTAG_IMAGEDESCRIPTION, TIFF_ASCII, strlen(description) + 1, description,
+                     strlen(description) + 1);
+            if (level == 0) {
+                add_data(&dir, TIFFTAG_XMP, TIFF_BYTE, sizeof(XMP), XMP, sizeof(XMP));
+            }
+            result = add_strips(&writer, &dir, get_level_size(options, level), NULL, TIFFTAG_STRIPOFFSETS,
+                                TIFFTAG_STRIPBYTECOUNTS);
+        }
+        if (result == 0) {
+            result = write_directory(&writer, &dir);
+        }
+    }
+    return end_tiff(&writer) == 0 ? result : -1;
+}
+
+// philips xml header with the label and macro image embedded as base64 encoded data
+static char *create_philips_xml(bool tiff) {
+    static const char ATTRIBUTE[] = "<Attribute Name=\"%s\" Group=\"0x1\" Element=\"0x2\" PMSVR=\"%s\">%s</Attribute>";
+    static const char SCANNED_IMAGE[] = "<DataObject ObjectType=\"DPScannedImage\">";
+    char *label = (char *)b64_encode(get_random_block(), GENERATOR_LABEL_SIZE);
+    char *macro = (char *)b64_encode(get_random_block(), GENERATOR_MACRO_SIZE);
+    size_t length = strlen(label) + strlen(macro) + 4096;
+    char *xml = (char *)malloc(length);
+
+    size_t position = snprintf(xml, length, "<?xml version=\"1.0\" encoding=\"UTF-8\" ?><DataObject ObjectType=\"%s\">",
+                               ISYNTAX_ROOTNODE);
+    const char *values[][3] = {{PHILIPS_DATETIME_ATT, "IString", "20190101120000.000000"},
+                               {PHILIPS_SERIAL_ATT, "IString", "FMT0123"},
+                               {PHILIPS_OPERID_ATT, "IString", "opid42"},
+                               {PHILIPS_RACK_NAME, "IUInt16", "3"},
+                               {PHILIPS_SLOT_NAME, "IUInt16", "7"},
+                               {PHILIPS_BARCODE_ATT, "IString", "QkFSQ09ERQ=="},
+                               {PHILIPS_SOURCE_FILE_ATT, "IString", "slide.tiff"}};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        position += snprintf(xml + position, length - position, ATTRIBUTE, values[i][0], values[i][1], values[i][2]);
+    }
+    position += snprintf(xml + position, length - position, "%s%s",
+                         "<Attribute Name=\"PIM_DP_SCANNED_IMAGES\" PMSVR=\"IDataObjectArray\"><Array>", SCANNED_IMAGE);
+    position += snprintf(xml + position, length - position, ATTRIBUTE, PHILIPS_IMAGE_TYPE, "IString", "WSI");
+
+    // philips tiff files store the image data in front of the image type, isyntax files behind it
+    const char *types[2] = {PHILIPS_MACROIMAGE, PHILIPS_LABELIMAGE};
+    const char *data[2] = {macro, label};
+    for (int32_t i = 0; i < 2; i++) {
+        position += snprintf(xml + position, length - position, "</DataObject>%s", SCANNED_IMAGE);
+        for (int32_t j = 0; j < 2; j++) {
+            bool is_data = (j == 0) == tiff;
+            position += snprintf(xml + position, length - position, ATTRIBUTE,
+                                 is_data ? PHILIPS_IMAGE_DATA : PHILIPS_IMAGE_TYPE, "IString",
+                                 is_data ? data[i] : types[i]);
+        }
+    }
+    snprintf(xml + position, length - position, "</DataObject></Array></Attribute></DataObject>");
+
+    free(label);
+    free(macro);
+    return xml;
+}
+
+int32_t generate_philips_tiff(const char *filename, const struct slide_options *options) {
+    struct tiff_writer writer;
+    if (begin_tiff(&writer, filename, false, false) != 0) {
+        return -1;
+    }
+
+    // pyramid levels, the first one holds the xml header, followed by label and macro image
+    char *xml = create_philips_xml(true);
+    int32_t result = 0;
+    for (int32_t level = 0; level < options->num_levels + 2 && result == 0; level++) {
+        struct generated_directory dir = {.count = 0};
+        bool is_label = level == options->num_levels;
+        bool is_macro = level == options->num_levels + 1;
+        add_value(&dir, TIFFTAG_SUBFILETYPE, TIFF_LONG, 1, 0);
+        if (level == 0) {
+            add_string(&dir, TIFFTAG_IMAGEDESCRIPTION, xml);
+            add_string(&dir, TIFFTAG_SOFTWARE, "Philips DP v1.0");
+        } else if (is_label || is_macro) {
+            add_string(&dir, TIFFTAG_IMAGEDESCRIPTION, is_label ? "Label" : "Macro");
+        }
+        uint64_t size = get_image_size(options, level);
+        result = add_strips(&writer, &dir, size, NULL, TIFFTAG_STRIPOFFSETS, TIFFTAG_STRIPBYTECOUNTS);
+        if (result == 0) {
+            result = write_directory(&writer, &dir);
+        }
+    }
+    free(xml);
+    return end_tiff(&writer) == 0 ? result : -1;
+}
+
+int32_t generate_isyntax(const char *filename, const struct slide_options *options) {
+    file_handle *fp = file_open(filename, "wb+");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not create %s.\n", filename);
+        return -1;
+    }
+
+    // the xml header is terminated by the end of transmission, followed by the image data
+    char *xml = create_philips_xml(false);
+    int32_t result = file_write(xml, strlen(xml), 1, fp) == 1 && file_write(ISYNTAX_EOT, 3, 1, fp) == 1 ? 0 : -1;
+    for (uint64_t written = 0; written < options->image_size && result == 0; written += GENERATOR_STRIP_SIZE) {
+        uint64_t length = options->image_size - written;
+        length = length < GENERATOR_STRIP_SIZE ? length : GENERATOR_STRIP_SIZE;
+        result = file_write(get_random_block(), length, 1, fp) == 1 ? 0 : -1;
+    }
+    free(xml);
+    return file_close(fp) == 0 ? result : -1;
+}
+
+static int32_t write_file(const char *filename, const void *data, size_t length) {
+    file_handle *fp = file_open(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not create %s.\n", filename);
+        return -1;
+    }
+    int32_t result = length == 0 || file_write(data, length, 1, fp) == 1 ? 0 : -1;
+    return file_close(fp) == 0 ? result : -1;
+}
+
+int32_t generate_mirax(const char *filename, const struct slide_options *options) {
+    // the slide consists of the mrxs file and a directory of the same name with the actual data
+    char *directory = strdup(filename);
+    char *ext = strrchr(directory, '.');
+    if (ext != NULL) {
+        *ext = '\0';
+    }
+#if defined(_WIN32)
+    _mkdir(directory);
+#else
+    mkdir(directory, 0755);
+#endif
+    const char *index_filename = concat_path_filename(directory, "Index.dat");
+    const char *data_filename = concat_path_filename(directory, "Data0000.dat");
+    const char *ini_filename = concat_path_filename(directory, "Slidedat.ini");
+
+    // data file with a header, thumbnail, barcode and whole slide image followed by the image data
+    static const char DATA_HEADER[] = "SLIDE_VERSION_01_TESTID12345\r\n ProfileName=\"operator profile\" ";
+    uint64_t data_size = MRXS_MAX_SIZE_DATA_DAT + 3 * (GENERATOR_LABEL_SIZE + 4);
+    uint8_t *data = (uint8_t *)calloc(data_size, 1);
+    memcpy(data, DATA_HEADER, strlen(DATA_HEADER));
+    int32_t record_offsets[3];
+    for (int32_t i = 0; i < 3; i++) {
+        record_offsets[i] = MRXS_MAX_SIZE_DATA_DAT + i * (GENERATOR_LABEL_SIZE + 4);
+        uint8_t *record = data + record_offsets[i];
+        memcpy(record, JPEG_SOI, 2);
+        memcpy(record + 2, get_random_block(), GENERATOR_LABEL_SIZE);
+        memcpy(record + 2 + GENERATOR_LABEL_SIZE, JPEG_EOI, 2);
+    }
+
+    // index file pointing to one record per level of the non hierarchical layer
+    uint8_t index[512] = {0};
+    int32_t table_offset = 64;
+    int32_t records_offset = table_offset + 4 * 3 + 16;
+    memcpy(index, "01.02TESTID12345", 16);
+    memcpy(index + MRXS_ROOT_OFFSET_NONHIER, &table_offset, 4);
+    for (int32_t i = 0; i < 3; i++) {
+        int32_t record_start = records_offset + i * 64;
+        int32_t page_start = record_start + 16;
+        int32_t page[7] = {1, 0, 0, 0, record_offsets[i], GENERATOR_LABEL_SIZE + 4, 0};
+        memcpy(index + table_offset + 4 * i, &record_start, 4);
+        memcpy(index + record_start + 4, &page_start, 4);
+        memcpy(index + page_start, page, sizeof(page));
+    }
+
+    static const char INI[] =
+        "[GENERAL]\r\nSLIDE_ID = TESTID12345\r\nSLIDE_NAME = patient name\r\nPROJECT_NAME = proj\r\n"
+        "SLIDE_VERSION = 01.02\r\nSLIDE_CREATIONDATETIME = 01/02/2020 10:11:12\r\n"
+        "SLIDE_UTC_CREATIONDATETIME = 20200102T101112\r\n[HIERARCHICAL]\r\nINDEXFILE = Index.dat\r\n"
+        "HIER_COUNT = 0\r\nNONHIER_COUNT = 1\r\nNONHIER_0_NAME = Scan data layer\r\nNONHIER_0_COUNT = 3\r\n"
+        "NONHIER_0_VAL_0 = ScanDataLayer_SlideThumbnail\r\nNONHIER_0_VAL_0_SECTION = NONHIERLAYER_0_LEVEL_0_SECTION\r\n"
+        "NONHIER_0_VAL_1 = ScanDataLayer_SlideBarcode\r\nNONHIER_0_VAL_1_SECTION = NONHIERLAYER_0_LEVEL_1_SECTION\r\n"
+        "NONHIER_0_VAL_2 = ScanDataLayer_WholeSlide\r\nNONHIER_0_VAL_2_SECTION = NONHIERLAYER_0_LEVEL_2_SECTION\r\n"
+        "[DATAFILE]\r\nFILE_COUNT = 1\r\nFILE_0 = Data0000.dat\r\n[NONHIERLAYER_0_SECTION]\r\n"
+        "SCANNER_HARDWARE_ID = HW123\r\n[NONHIERLAYER_0_LEVEL_0_SECTION]\r\nA = 1\r\n"
+        "[NONHIERLAYER_0_LEVEL_1_SECTION]\r\nB = 2\r\n[NONHIERLAYER_0_LEVEL_2_SECTION]\r\nC = 3\r\n";
+
+    int32_t result = 0;
+    if (write_file(filename, "mrxs", 4) != 0 || write_file(index_filename, index, sizeof(index)) != 0 ||
+        write_file(ini_filename, INI, strlen(INI)) != 0 || write_file(data_filename, data, data_size) != 0) {
+        result = -1;
+    }
+
+    // the image data of the slide is appended to the data file
+    file_handle *fp = result == 0 ? file_open(data_filename, "rb+") : NULL;
+    if (fp != NULL && file_seek(fp, 0, SEEK_END) == 0) {
+        for (uint64_t written = 0; written < options->image_size && result == 0; written += GENERATOR_STRIP_SIZE) {
+            uint64_t length = options->image_size - written;
+            length = length < GENERATOR_STRIP_SIZE ? length : GENERATOR_STRIP_SIZE;
+            result = file_write(get_random_block(), length, 1, fp) == 1 ? 0 : -1;
+        }
+    }
+    if (fp == NULL || file_close(fp) != 0) {
+        result = -1;
+    }
+
+    free(data);
+    free(directory);
+    free((void *)index_filename);
+    free((void *)data_filename);
+    free((void *)ini_filename);
+    return result;
+}
@@ -0,0 +1,35 @@
+#ifndef HEADER_SLIDE_GENERATOR_H
+#define HEADER_SLIDE_GENERATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GENERATOR_STRIP_SIZE (256 * 1024)
+#define GENERATOR_LABEL_SIZE (64 * 1024)
+#define GENERATOR_MACRO_SIZE (256 * 1024)
+#define GENERATOR_MAX_ENTRIES 16
+#define GENERATOR_LARGE_OFFSET 0x100000000ULL
+// levels are scaled by shifting, deeper pyramids would shift beyond the width of the sizes
+#define GENERATOR_MAX_LEVELS 15
+
+// options of a synthetic slide. the image data of the base level has the given size, every
+// further pyramid level is a quarter of its predecessor
+struct slide_options {
+    uint64_t image_size;
+    int32_t num_levels;
+    bool large_offsets;
+};
+
+int32_t generate_aperio(const char *filename, const struct slide_options *options, bool gt450);
+
+int32_t generate_ndpi(const char *filename, const struct slide_options *options);
+
+int32_t generate_ventana(const char *filename, const struct slide_options *options);
+
+int32_t generate_philips_tiff(const char *filename, const struct slide_options *options);
+
+int32_t generate_isyntax(const char *filename, const struct slide_options *options);
+
+int32_t generate_mirax(const char *filename, const struct slide_options *options);
+
+#endif
@@ -0,0 +1,62 @@
+#include "CUnit/Basic.h"
+
+#include "../../src/b64.h"
+
+// ####################### test cases ####################### //
+
+void test_b64_encode() {
+    const char *inputs[] = {"", "M", "Ma", "Man", "Many hands make light work."};
+    const char *expected[] = {"", "TQ==", "TWE=", "TWFu", "TWFueSBoYW5kcyBtYWtlIGxpZ2h0IHdvcmsu"};
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        char *result = (char *)b64_encode((const unsigned char *)inputs[i], strlen(inputs[i]));
+        CU_ASSERT_STRING_EQUAL(result, expected[i]);
+        free(result);
+    }
+}
+
+void test_b64_round_trip() {
+    // lengths around the block sizes of the vectorized codecs
+    unsigned char data[100];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char)(i * 37 + 11);
+    }
+    for (size_t len = 0; len <= sizeof(data); len++) {
+        char *encoded = (char *)b64_encode(data, len);
+        CU_ASSERT_EQUAL(strlen(encoded), (len + 2) / 3 * 4);
+        size_t decoded_size = 0;
+        unsigned char *decoded = b64_decode_ex(encoded, strlen(encoded), &decoded_size);
+        CU_ASSERT_EQUAL(decoded_size, len);
+        CU_ASSERT_EQUAL(memcmp(decoded, data, len), 0);
+        free(encoded);
+        free(decoded);
+    }
+}
+
+void test_b64_decode_stops_at_invalid_char() {
+    // the invalid character lies in the second block of 16 characters
+    const char *input = "QUJDREVGR0hJSktMTU5PUFFSU1RV-VZXWFla";
+    size_t decoded_size = 0;
+    unsigned char *decoded = b64_decode_ex(input, strlen(input), &decoded_size);
+    CU_ASSERT_EQUAL(decoded_size, 21);
+    CU_ASSERT_STRING_EQUAL((char *)decoded, "ABCDEFGHIJKLMNOPQRSTU");
+    free(decoded);
+}
+
+// ####################### test case setup ####################### //
+
+CU_TestInfo b64_tests[] = {{"Test [b64_encode]:", test_b64_encode},
+                           {"Test [b64_decode_ex] 1:", test_b64_round_trip},
+                           {"Test [b64_decode_ex] 2:", test_b64_decode_stops_at_invalid_char},
+                           CU_TEST_INFO_NULL};
+
+CU_SuiteInfo b64_test_suite[] = {{"Testing b64.c:", NULL, NULL, NULL, NULL, b64_tests}, CU_SUITE_INFO_NULL};
+
+void AddTestsB64(void) {
+    assert(NULL != CU_get_registry());
+    assert(!CU_is_test_running());
+
+    if (CUE_SUCCESS != CU_register_suites(b64_test_suite)) {
+        fprintf(stderr, "Register suites failed - %s ", CU_get_error_msg());
+        exit(1);
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef HEADER_B64_TEST_H
+#define HEADER_B64_TEST_H
+
+void AddTestsB64();
+
+#endif
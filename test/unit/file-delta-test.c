@@ -0,0 +1,116 @@
+#include "CUnit/Basic.h"
+
+#include "../../src/file-delta.h"
+
+// ####################### functions to test ####################### //
+
+extern struct file_delta *init_file_delta();
+
+extern int32_t add_patch_to_delta(struct file_delta *delta, uint64_t offset, const void *data, uint64_t length);
+
+extern void apply_delta_to_buffer(const struct file_delta *delta, uint64_t offset, void *buffer, uint64_t length);
+
+extern uint64_t get_size_of_delta_file(const struct file_delta *delta);
+
+extern int32_t stream_with_delta(struct stream_source *source, struct file_delta *delta, FILE *output);
+
+// ####################### test cases ####################### //
+
+void test_add_patch_to_delta_keeps_patches_sorted() {
+    struct file_delta *delta = init_file_delta();
+    add_patch_to_delta(delta, 20, "cc", 2);
+    add_patch_to_delta(delta, 0, "aa", 2);
+    add_patch_to_delta(delta, 10, "bb", 2);
+    CU_ASSERT_EQUAL(delta->count, 3);
+    CU_ASSERT_EQUAL(delta->patches[0].offset, 0);
+    CU_ASSERT_EQUAL(delta->patches[1].offset, 10);
+    CU_ASSERT_EQUAL(delta->patches[2].offset, 20);
+    free_file_delta(delta);
+}
+
+void test_add_patch_to_delta_merges_overlapping_patches() {
+    struct file_delta *delta = init_file_delta();
+    add_patch_to_delta(delta, 2, "aaaa", 4);
+    add_patch_to_delta(delta, 8, "bb", 2);
+    add_patch_to_delta(delta, 4, "XXXX", 4);
+    CU_ASSERT_EQUAL(delta->count, 1);
+    CU_ASSERT_EQUAL(delta->patches[0].offset, 2);
+    CU_ASSERT_EQUAL(delta->patches[0].length, 8);
+    CU_ASSERT_NSTRING_EQUAL(delta->patches[0].data, "aaXXXXbb", 8);
+    free_file_delta(delta);
+}
+
+void test_add_patch_to_delta_appends_to_last_patch() {
+    struct file_delta *delta = init_file_delta();
+    add_patch_to_delta(delta, 100, "zz", 2);
+    add_patch_to_delta(delta, 0, "aa", 2);
+    add_patch_to_delta(delta, 2, "bb", 2);
+    add_patch_to_delta(delta, 4, "cc", 2);
+    add_patch_to_delta(delta, 1, "X", 1);
+    CU_ASSERT_EQUAL(delta->count, 2);
+    CU_ASSERT_EQUAL(delta->patches[0].offset, 0);
+    CU_ASSERT_EQUAL(delta->patches[0].length, 6);
+    CU_ASSERT_TRUE(delta->patches[0].capacity >= 6);
+    CU_ASSERT_NSTRING_EQUAL(delta->patches[0].data, "aXbbcc", 6);
+    CU_ASSERT_EQUAL(delta->patches[1].offset, 100);
+    free_file_delta(delta);
+}
+
+void test_apply_delta_to_buffer() {
+    struct file_delta *delta = init_file_delta();
+    delta->original_size = 8;
+    add_patch_to_delta(delta, 1, "XY", 2);
+    add_patch_to_delta(delta, 7, "ZZZ", 3);
+    char buffer[] = "01234567";
+    apply_delta_to_buffer(delta, 0, buffer, 8);
+    CU_ASSERT_STRING_EQUAL(buffer, "0XY3456Z");
+    CU_ASSERT_EQUAL(get_size_of_delta_file(delta), 10);
+    free_file_delta(delta);
+}
+
+void test_stream_with_delta() {
+    FILE *input = tmpfile();
+    FILE *output = tmpfile();
+    fputs("0123456789", input);
+    rewind(input);
+
+    // the first four bytes are already in the lookahead, the rest is passed through
+    struct stream_source source = {input, (uint8_t *)malloc(4), 4, 4, 4, false, false};
+    CU_ASSERT_EQUAL(fread(source.buffer, 1, 4, input), 4);
+    struct file_delta *delta = init_file_delta();
+    add_patch_to_delta(delta, 2, "AB", 2);
+    add_patch_to_delta(delta, 8, "CDE", 3);
+    CU_ASSERT_EQUAL(stream_with_delta(&source, delta, output), 0);
+
+    char buffer[16] = {0};
+    rewind(output);
+    CU_ASSERT_EQUAL(fread(buffer, 1, sizeof(buffer), output), 11);
+    CU_ASSERT_STRING_EQUAL(buffer, "01AB4567CDE");
+    free(source.buffer);
+    free_file_delta(delta);
+    fclose(input);
+    fclose(output);
+}
+
+// ####################### test case setup ####################### //
+
+CU_TestInfo file_delta_tests[] = {
+    {"Test [add_patch_to_delta] 1:", test_add_patch_to_delta_keeps_patches_sorted},
+    {"Test [add_patch_to_delta] 2:", test_add_patch_to_delta_merges_overlapping_patches},
+    {"Test [add_patch_to_delta] 3:", test_add_patch_to_delta_appends_to_last_patch},
+    {"Test [apply_delta_to_buffer]:", test_apply_delta_to_buffer},
+    {"Test [stream_with_delta]:", test_stream_with_delta},
+    CU_TEST_INFO_NULL};
+
+CU_SuiteInfo file_delta_test_suite[] = {{"Testing file-delta.c:", NULL, NULL, NULL, NULL, file_delta_tests},
+                                        CU_SUITE_INFO_NULL};
+
+void AddTestsFileDelta(void) {
+    assert(NULL != CU_get_registry());
+    assert(!CU_is_test_running());
+
+    if (CUE_SUCCESS != CU_register_suites(file_delta_test_suite)) {
+        fprintf(stderr, "Register suites failed - %s ", CU_get_error_msg());
+        exit(1);
+    }
+}
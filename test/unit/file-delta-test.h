@@ -0,0 +1,6 @@
+#ifndef HEADER_FILE_DELTA_TEST_H
+#define HEADER_FILE_DELTA_TEST_H
+
+void AddTestsFileDelta();
+
+#endif
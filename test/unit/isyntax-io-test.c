@@ -0,0 +1,152 @@
+#include "CUnit/Basic.h"
+
+#include "../../src/isyntax-io.h"
+
+// ####################### functions to test ####################### //
+
+extern int32_t anonymize_isyntax_header(file_handle *fp, uint64_t header_size, bool keep_macro_image);
+
+extern char *create_blank_jpeg_base64();
+
+// ####################### helper ####################### //
+
+#define ATTRIBUTE(name, value) "<Attribute Name=\"" name "\" PMSVR=\"IString\">" value "</Attribute>"
+#define SCANNED_IMAGE "<DataObject ObjectType=\"DPScannedImage\">"
+
+// base64 data long enough to hold the blank image
+static char *create_image_data(char symbol) {
+    char *blank = create_blank_jpeg_base64();
+    size_t length = strlen(blank) + 64;
+    char *data = (char *)malloc(length + 1);
+    memset(data, symbol, length);
+    data[length] = '\0';
+    free(blank);
+    return data;
+}
+
+// writes the header followed by the end of transmission, anonymizes it and reads it back
+static char *anonymize_header(const char *header, bool keep_macro_image) {
+    const char *filename = "isyntax-header-test.isyntax";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    size_t header_size = strlen(header);
+    file_write(header, header_size, 1, fp);
+    file_write(ISYNTAX_EOT, strlen(ISYNTAX_EOT), 1, fp);
+    CU_ASSERT_EQUAL(anonymize_isyntax_header(fp, header_size, keep_macro_image), 0);
+
+    char *result = (char *)calloc(header_size + 1, 1);
+    file_seek(fp, 0, SEEK_SET);
+    CU_ASSERT_EQUAL(file_read(result, header_size, 1, fp), 1);
+    file_close(fp);
+    remove(filename);
+    return result;
+}
+
+// ####################### test cases ####################### //
+
+void test_anonymize_isyntax_header_metadata() {
+    const char *header = "<DataObject ObjectType=\"" ISYNTAX_ROOTNODE "\">" ATTRIBUTE(
+        PHILIPS_DATETIME_ATT, "20190101120000.000000") ATTRIBUTE(PHILIPS_SERIAL_ATT, "FMT0123")
+        ATTRIBUTE(PHILIPS_RACK_NAME, "3") ATTRIBUTE(PHILIPS_SLOT_NAME, "7") "</DataObject>";
+    char *result = anonymize_header(header, false);
+    if (result == NULL) {
+        return;
+    }
+
+    // every value keeps its length, so the header keeps its size
+    CU_ASSERT_EQUAL(strlen(result), strlen(header));
+    CU_ASSERT_PTR_NOT_NULL(strstr(result, ATTRIBUTE(PHILIPS_DATETIME_ATT, PHILIPS_MIN_DATETIME)));
+    CU_ASSERT_PTR_NOT_NULL(strstr(result, ATTRIBUTE(PHILIPS_SERIAL_ATT, "XXXXXXX")));
+
+    // slot and rack are blanked as whole elements
+    CU_ASSERT_PTR_NULL(strstr(result, PHILIPS_RACK_NAME));
+    CU_ASSERT_PTR_NULL(strstr(result, PHILIPS_SLOT_NAME));
+    CU_ASSERT_PTR_NOT_NULL(strstr(result, ATTRIBUTE(PHILIPS_SERIAL_ATT, "XXXXXXX") "   "));
+    free(result);
+}
+
+void test_anonymize_isyntax_header_image_data() {
+    char *wsi = create_image_data('W');
+    char *label = create_image_data('L');
+    char *macro = create_image_data('M');
+    size_t length = strlen(wsi) + strlen(label) + strlen(macro) + 1024;
+    char *header = (char *)malloc(length);
+    snprintf(header, length,
+             SCANNED_IMAGE ATTRIBUTE(PHILIPS_IMAGE_TYPE, "WSI") ATTRIBUTE(PHILIPS_IMAGE_DATA, "%s")
+                 "</DataObject>" SCANNED_IMAGE ATTRIBUTE(PHILIPS_IMAGE_TYPE, PHILIPS_LABELIMAGE)
+                     ATTRIBUTE(PHILIPS_IMAGE_DATA, "%s") "</DataObject>" SCANNED_IMAGE
+                 ATTRIBUTE(PHILIPS_IMAGE_TYPE, PHILIPS_MACROIMAGE) ATTRIBUTE(PHILIPS_IMAGE_DATA, "%s") "</DataObject>",
+             wsi, label, macro);
+
+    // only the image data of the label image is replaced if the macro image is kept
+    char *blank = create_blank_jpeg_base64();
+    char *result = anonymize_header(header, true);
+    if (result != NULL) {
+        CU_ASSERT_EQUAL(strlen(result), strlen(header));
+        CU_ASSERT_PTR_NOT_NULL(strstr(result, wsi));
+        CU_ASSERT_PTR_NULL(strstr(result, label));
+        CU_ASSERT_PTR_NOT_NULL(strstr(result, macro));
+        CU_ASSERT_PTR_NOT_NULL(strstr(result, blank));
+        free(result);
+    }
+
+    // the macro image is replaced as well otherwise
+    result = anonymize_header(header, false);
+    if (result != NULL) {
+        CU_ASSERT_PTR_NOT_NULL(strstr(result, wsi));
+        CU_ASSERT_PTR_NULL(strstr(result, label));
+        CU_ASSERT_PTR_NULL(strstr(result, macro));
+        free(result);
+    }
+
+    free(blank);
+    free(header);
+    free(macro);
+    free(label);
+    free(wsi);
+}
+
+void test_anonymize_isyntax_header_image_type_without_data() {
+    char *wsi = create_image_data('W');
+    size_t length = strlen(wsi) + 1024;
+    char *header = (char *)malloc(length);
+    snprintf(header, length,
+             SCANNED_IMAGE ATTRIBUTE(PHILIPS_IMAGE_TYPE, PHILIPS_LABELIMAGE) "</DataObject>" SCANNED_IMAGE
+                 ATTRIBUTE(PHILIPS_IMAGE_DATA, "%s") "</DataObject>",
+             wsi);
+
+    // the image type of the label does not apply to the image data of the next object
+    char *result = anonymize_header(header, false);
+    if (result != NULL) {
+        CU_ASSERT_PTR_NOT_NULL(strstr(result, wsi));
+        free(result);
+    }
+
+    free(header);
+    free(wsi);
+}
+
+// ####################### test case setup ####################### //
+
+CU_TestInfo isyntax_io_tests[] = {{"Test [anonymize_isyntax_header] 1:", test_anonymize_isyntax_header_metadata},
+                                  {"Test [anonymize_isyntax_header] 2:", test_anonymize_isyntax_header_image_data},
+                                  {"Test [anonymize_isyntax_header] 3:",
+                                   test_anonymize_isyntax_header_image_type_without_data},
+                                  CU_TEST_INFO_NULL};
+
+CU_SuiteInfo isyntax_io_test_suite[] = {{"Testing isyntax-io.c:", NULL, NULL, NULL, NULL, isyntax_io_tests},
+                                        CU_SUITE_INFO_NULL};
+
+void AddTestsIsyntaxIo(void) {
+    assert(NULL != CU_get_registry());
+    assert(!CU_is_test_running());
+
+    if (CUE_SUCCESS != CU_register_suites(isyntax_io_test_suite)) {
+        fprintf(stderr, "Register suites failed - %s ", CU_get_error_msg());
+        exit(1);
+    }
+}
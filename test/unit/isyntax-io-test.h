@@ -0,0 +1,6 @@
+#ifndef HEADER_ISYNTAX_IO_TEST_H
+#define HEADER_ISYNTAX_IO_TEST_H
+
+void AddTestsIsyntaxIo();
+
+#endif
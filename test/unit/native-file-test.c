@@ -0,0 +1,318 @@
+#include "CUnit/Basic.h"
+
+#include "../../src/file-api.h"
+
+// ####################### helper ####################### //
+
+#define MAPPED_TEST_SIZE 4096
+
+static const char *MAPPED_TEST_FILE = "mapped-file-test.bin";
+
+// creates the test file, each byte holds its offset modulo 256
+static bool create_mapped_test_file() {
+    file_handle *fp = file_open(MAPPED_TEST_FILE, "wb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return false;
+    }
+    uint8_t content[MAPPED_TEST_SIZE];
+    for (size_t i = 0; i < MAPPED_TEST_SIZE; i++) {
+        content[i] = (uint8_t)i;
+    }
+    size_t written = file_write(content, MAPPED_TEST_SIZE, 1, fp);
+    file_close(fp);
+    return written == 1;
+}
+
+static uint64_t get_size(file_handle *fp) {
+    uint64_t offset = file_tell(fp);
+    file_seek(fp, 0, SEEK_END);
+    uint64_t size = file_tell(fp);
+    file_seek(fp, offset, SEEK_SET);
+    return size;
+}
+
+// ####################### test cases ####################### //
+
+void test_mapped_read_and_seek() {
+    if (!create_mapped_test_file()) {
+        return;
+    }
+    file_handle *fp = file_open_mapped(MAPPED_TEST_FILE, "rb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE);
+
+    uint8_t buffer[16];
+    CU_ASSERT_EQUAL(file_seek(fp, 1000, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_read(buffer, 4, 4, fp), 4);
+    CU_ASSERT_EQUAL(buffer[0], (uint8_t)1000);
+    CU_ASSERT_EQUAL(buffer[15], (uint8_t)1015);
+    CU_ASSERT_EQUAL(file_tell(fp), 1016);
+
+    CU_ASSERT_EQUAL(file_seek(fp, -16, SEEK_CUR), 0);
+    CU_ASSERT_EQUAL(file_getc(fp), (uint8_t)1000);
+    CU_ASSERT_EQUAL(file_seek(fp, -1, SEEK_END), 0);
+    CU_ASSERT_EQUAL(file_tell(fp), MAPPED_TEST_SIZE - 1);
+    CU_ASSERT_EQUAL(file_getc(fp), (uint8_t)(MAPPED_TEST_SIZE - 1));
+    CU_ASSERT_EQUAL(file_getc(fp), EOF);
+    CU_ASSERT_EQUAL(file_seek(fp, -1, SEEK_SET), -1);
+
+    // only whole elements are read at the end of the mapping
+    CU_ASSERT_EQUAL(file_seek(fp, MAPPED_TEST_SIZE - 6, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_read(buffer, 4, 2, fp), 1);
+    CU_ASSERT_EQUAL(buffer[0], (uint8_t)(MAPPED_TEST_SIZE - 6));
+    CU_ASSERT_EQUAL(file_read(buffer, 1, 1, fp), 0);
+
+    file_close(fp);
+    remove(MAPPED_TEST_FILE);
+}
+
+void test_mapped_write() {
+    if (!create_mapped_test_file()) {
+        return;
+    }
+    file_handle *fp = file_open_mapped(MAPPED_TEST_FILE, "rb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+
+    const uint8_t patch[4] = {0xde, 0xad, 0xbe, 0xef};
+    CU_ASSERT_EQUAL(file_seek(fp, 2000, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_write(patch, sizeof(patch), 1, fp), 1);
+    CU_ASSERT_EQUAL(file_tell(fp), 2004);
+    CU_ASSERT_EQUAL(file_putc('x', fp), 'x');
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE);
+
+    // the handle reads its own writes
+    uint8_t buffer[6];
+    file_seek(fp, 1999, SEEK_SET);
+    CU_ASSERT_EQUAL(file_read(buffer, sizeof(buffer), 1, fp), 1);
+    CU_ASSERT_EQUAL(buffer[0], (uint8_t)1999);
+    CU_ASSERT_EQUAL(memcmp(buffer + 1, patch, sizeof(patch)), 0);
+    CU_ASSERT_EQUAL(buffer[5], 'x');
+    CU_ASSERT_EQUAL(file_close(fp), 0);
+
+    // the writes reach the file
+    fp = file_open(MAPPED_TEST_FILE, "rb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp != NULL) {
+        file_seek(fp, 2000, SEEK_SET);
+        CU_ASSERT_EQUAL(file_read(buffer, sizeof(patch), 1, fp), 1);
+        CU_ASSERT_EQUAL(memcmp(buffer, patch, sizeof(patch)), 0);
+        file_close(fp);
+    }
+    remove(MAPPED_TEST_FILE);
+}
+
+void test_mapped_write_past_mapping() {
+    if (!create_mapped_test_file()) {
+        return;
+    }
+    file_handle *fp = file_open_mapped(MAPPED_TEST_FILE, "rb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+
+    // the write starts inside the mapping and appends to the file
+    uint8_t content[32];
+    memset(content, 'a', sizeof(content));
+    CU_ASSERT_EQUAL(file_seek(fp, MAPPED_TEST_SIZE - 16, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_write(content, sizeof(content), 1, fp), 1);
+    CU_ASSERT_EQUAL(file_tell(fp), MAPPED_TEST_SIZE + 16);
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE + 16);
+
+    // appends at the end behind the mapping
+    CU_ASSERT_EQUAL(file_seek(fp, 0, SEEK_END), 0);
+    CU_ASSERT_EQUAL(file_printf(fp, "%s", "end"), 3);
+    CU_ASSERT_EQUAL(file_tell(fp), MAPPED_TEST_SIZE + 19);
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE + 19);
+
+    // reads cross the end of the mapping
+    char buffer[36];
+    CU_ASSERT_EQUAL(file_seek(fp, MAPPED_TEST_SIZE - 17, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_read(buffer, sizeof(buffer), 1, fp), 1);
+    CU_ASSERT_EQUAL((uint8_t)buffer[0], (uint8_t)(MAPPED_TEST_SIZE - 17));
+    CU_ASSERT_EQUAL(memcmp(buffer + 1, content, sizeof(content)), 0);
+    CU_ASSERT_EQUAL(memcmp(buffer + 33, "end", 3), 0);
+    CU_ASSERT_EQUAL(file_getc(fp), EOF);
+    CU_ASSERT_EQUAL(file_close(fp), 0);
+
+    fp = file_open(MAPPED_TEST_FILE, "rb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp != NULL) {
+        CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE + 19);
+        file_close(fp);
+    }
+    remove(MAPPED_TEST_FILE);
+}
+
+void test_mapped_submit_batch() {
+    if (!create_mapped_test_file()) {
+        return;
+    }
+    file_handle *fp = file_open_mapped(MAPPED_TEST_FILE, "rb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+
+    uint8_t zeros[8] = {0};
+    uint8_t first[8];
+    uint8_t second[8];
+    struct file_io_request requests[] = {{100, zeros, sizeof(zeros), true, 0},
+                                         {96, first, sizeof(first), false, 0},
+                                         {MAPPED_TEST_SIZE - 8, second, sizeof(second), false, 0}};
+    file_seek(fp, 10, SEEK_SET);
+    CU_ASSERT_EQUAL(file_submit_batch(fp, requests, 3), 0);
+    CU_ASSERT_EQUAL(requests[1].result, sizeof(first));
+    CU_ASSERT_EQUAL(first[3], 99);
+    CU_ASSERT_EQUAL(first[4], 0);
+    CU_ASSERT_EQUAL(second[7], (uint8_t)(MAPPED_TEST_SIZE - 1));
+
+    // the batch does not move the stream position
+    CU_ASSERT_EQUAL(file_tell(fp), 10);
+
+    // requests behind the end of the file are incomplete
+    struct file_io_request request = {MAPPED_TEST_SIZE - 4, first, sizeof(first), false, 0};
+    CU_ASSERT_EQUAL(file_submit_batch(fp, &request, 1), -1);
+    CU_ASSERT_EQUAL(request.result, 4);
+
+    file_close(fp);
+    remove(MAPPED_TEST_FILE);
+}
+
+void test_submit_and_reap_requests() {
+    if (!create_mapped_test_file()) {
+        return;
+    }
+    file_handle *fp = file_open(MAPPED_TEST_FILE, "rb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+
+    // requests of several submissions are reaped together
+    uint8_t zeros[8] = {0};
+    uint8_t first[8];
+    uint8_t second[8];
+    struct file_io_request writes[] = {{200, zeros, sizeof(zeros), true, 0}};
+    struct file_io_request reads[] = {{196, first, sizeof(first), false, 0},
+                                      {MAPPED_TEST_SIZE - 4, second, sizeof(second), false, 0}};
+    file_seek(fp, 10, SEEK_SET);
+    CU_ASSERT_EQUAL(file_submit_requests(fp, writes, 1), 0);
+    CU_ASSERT_EQUAL(file_reap_requests(fp), 0);
+    CU_ASSERT_EQUAL(file_submit_requests(fp, reads, 2), 0);
+    CU_ASSERT_EQUAL(file_reap_requests(fp), -1);
+    CU_ASSERT_EQUAL(reads[0].result, sizeof(first));
+    CU_ASSERT_EQUAL(first[3], 199);
+    CU_ASSERT_EQUAL(first[4], 0);
+    CU_ASSERT_EQUAL(reads[1].result, 4);
+    CU_ASSERT_EQUAL(file_tell(fp), 10);
+
+    // nothing is left to reap
+    CU_ASSERT_EQUAL(file_reap_requests(fp), 0);
+
+    file_close(fp);
+    remove(MAPPED_TEST_FILE);
+}
+
+void test_io_uring_requests() {
+    if (file_use_io_uring(true) != 0) {
+        // not supported by the platform or the kernel
+        return;
+    }
+    if (!create_mapped_test_file()) {
+        file_use_io_uring(false);
+        return;
+    }
+    file_handle *fp = file_open_mapped(MAPPED_TEST_FILE, "rb+");
+    file_use_io_uring(false);
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        remove(MAPPED_TEST_FILE);
+        return;
+    }
+
+    // more requests than the ring holds at once, submitted in two parts and reaped together
+    uint8_t buffer[MAPPED_TEST_SIZE];
+    struct file_io_request requests[MAPPED_TEST_SIZE / 16];
+    size_t count = MAPPED_TEST_SIZE / 16;
+    for (size_t i = 0; i < count; i++) {
+        struct file_io_request request = {i * 16, buffer + i * 16, 16, false, 0};
+        requests[i] = request;
+    }
+    memset(buffer, 0, sizeof(buffer));
+    CU_ASSERT_EQUAL(file_submit_requests(fp, requests, count / 2), 0);
+    CU_ASSERT_EQUAL(file_submit_requests(fp, requests + count / 2, count - count / 2), 0);
+    CU_ASSERT_EQUAL(file_reap_requests(fp), 0);
+    size_t matching = 0;
+    while (matching < MAPPED_TEST_SIZE && buffer[matching] == (uint8_t)matching) {
+        matching++;
+    }
+    CU_ASSERT_EQUAL(matching, MAPPED_TEST_SIZE);
+
+    // the ring is reused by the next batch, writes and incomplete reads
+    uint8_t patch[4] = {0xde, 0xad, 0xbe, 0xef};
+    uint8_t tail[8];
+    struct file_io_request write = {3000, patch, sizeof(patch), true, 0};
+    CU_ASSERT_EQUAL(file_submit_batch(fp, &write, 1), 0);
+    struct file_io_request read = {MAPPED_TEST_SIZE - 4, tail, sizeof(tail), false, 0};
+    CU_ASSERT_EQUAL(file_submit_batch(fp, &read, 1), -1);
+    CU_ASSERT_EQUAL(read.result, 4);
+    CU_ASSERT_EQUAL(tail[3], (uint8_t)(MAPPED_TEST_SIZE - 1));
+
+    // the handle is read and written sequentially as well
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE);
+    CU_ASSERT_EQUAL(file_seek(fp, 2999, SEEK_SET), 0);
+    CU_ASSERT_EQUAL(file_read(tail, 5, 1, fp), 1);
+    CU_ASSERT_EQUAL(tail[0], (uint8_t)2999);
+    CU_ASSERT_EQUAL(memcmp(tail + 1, patch, sizeof(patch)), 0);
+    CU_ASSERT_EQUAL(file_seek(fp, 0, SEEK_END), 0);
+    CU_ASSERT_EQUAL(file_printf(fp, "%s", "end"), 3);
+    CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE + 3);
+    CU_ASSERT_EQUAL(file_close(fp), 0);
+
+    fp = file_open(MAPPED_TEST_FILE, "rb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp != NULL) {
+        file_seek(fp, 3000, SEEK_SET);
+        CU_ASSERT_EQUAL(file_read(tail, sizeof(patch), 1, fp), 1);
+        CU_ASSERT_EQUAL(memcmp(tail, patch, sizeof(patch)), 0);
+        CU_ASSERT_EQUAL(get_size(fp), MAPPED_TEST_SIZE + 3);
+        file_close(fp);
+    }
+    remove(MAPPED_TEST_FILE);
+}
+
+// ####################### test case setup ####################### //
+
+CU_TestInfo native_file_tests[] = {{"Test [file_open_mapped] 1:", test_mapped_read_and_seek},
+                                   {"Test [file_open_mapped] 2:", test_mapped_write},
+                                   {"Test [file_open_mapped] 3:", test_mapped_write_past_mapping},
+                                   {"Test [file_submit_batch] 1:", test_mapped_submit_batch},
+                                   {"Test [file_submit_requests] 1:", test_submit_and_reap_requests},
+                                   {"Test [file_use_io_uring] 1:", test_io_uring_requests},
+                                   CU_TEST_INFO_NULL};
+
+CU_SuiteInfo native_file_test_suite[] = {{"Testing native-file.c:", NULL, NULL, NULL, NULL, native_file_tests},
+                                         CU_SUITE_INFO_NULL};
+
+void AddTestsNativeFile(void) {
+    assert(NULL != CU_get_registry());
+    assert(!CU_is_test_running());
+
+    if (CUE_SUCCESS != CU_register_suites(native_file_test_suite)) {
+        fprintf(stderr, "Register suites failed - %s ", CU_get_error_msg());
+        exit(1);
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef HEADER_NATIVE_FILE_TEST_H
+#define HEADER_NATIVE_FILE_TEST_H
+
+void AddTestsNativeFile();
+
+#endif
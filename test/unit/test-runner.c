@@ -3,7 +3,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "b64-test.h"
+#include "file-delta-test.h"
 #include "ini-parser-test.h"
+#include "isyntax-io-test.h"
+#include "native-file-test.h"
+#include "tiff-based-io-test.h"
 #include "utils-test.h"
 #include "wsi-anonymizer-test.h"
 
@@ -15,6 +20,11 @@ int main() {
         AddTestsUtils();
         AddTestsIniParser();
         AddTestsWsiAnonymizer();
+        AddTestsFileDelta();
+        AddTestsTiffBasedIo();
+        AddTestsB64();
+        AddTestsIsyntaxIo();
+        AddTestsNativeFile();
         CU_set_output_filename("Test-Wsi-Anon");
         CU_automated_run_tests();
 
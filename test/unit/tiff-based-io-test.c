@@ -0,0 +1,453 @@
+#include "CUnit/Basic.h"
+
+#include "../../src/tiff-based-io.h"
+
+// ####################### functions to test ####################### //
+
+extern const struct tiff_tag_reference *find_tag_references(struct tiff_file *file, uint16_t tag, uint64_t *count);
+
+extern const char *get_tag_value(file_handle *fp, struct tiff_file *file, const struct tiff_tag_reference *reference);
+
+extern void invalidate_tag_values(struct tiff_file *file, uint64_t offset, uint64_t length);
+
+extern int64_t find_entry_by_tag(const struct tiff_directory *dir, uint16_t tag);
+
+extern struct tiff_file *open_tiff_file_with_header(file_handle *fp, bool ndpi);
+
+extern int32_t read_next_tiff_directory(file_handle *fp, struct tiff_file *file);
+
+extern int32_t get_directory_by_tag_and_value(file_handle *fp, struct tiff_file *file, int32_t tag, const char *value);
+
+extern int32_t first_tag_value_contains(file_handle *fp, struct tiff_file *file, int32_t tag,
+                                        const char *contains_value);
+
+extern void fix_byte_order(void *data, int32_t size, int64_t count, bool big_endian);
+
+extern uint64_t decode_uint(const uint8_t *buffer, int32_t size, bool big_endian);
+
+extern struct tiff_directory *read_tiff_directory(file_handle *fp, struct arena *arena, uint64_t *dir_offset,
+                                                  uint64_t *in_pointer_offset, bool big_tiff, bool ndpi,
+                                                  bool big_endian);
+
+// ####################### helper ####################### //
+
+void insert_dir_with_tags(struct tiff_file *file, const uint16_t *tags, uint32_t count) {
+    struct tiff_directory dir = {0};
+    dir.entries = (struct tiff_entry *)arena_alloc(&file->arena, count * sizeof(struct tiff_entry));
+    memset(dir.entries, 0, count * sizeof(struct tiff_entry));
+    dir.count = count;
+    for (uint32_t i = 0; i < count; i++) {
+        dir.entries[i].tag = tags[i];
+    }
+    insert_dir_into_tiff_file(file, &dir);
+}
+
+// layout of a directory built in memory
+struct directory_layout {
+    bool big_tiff;
+    bool ndpi;
+    bool big_endian;
+};
+
+static void put_uint(uint8_t *buffer, int32_t size, uint64_t value, bool big_endian) {
+    for (int32_t i = 0; i < size; i++) {
+        buffer[big_endian ? size - 1 - i : i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_uint(const uint8_t *buffer, int32_t size, bool big_endian) {
+    uint64_t value = 0;
+    for (int32_t i = 0; i < size; i++) {
+        value |= (uint64_t)buffer[big_endian ? size - 1 - i : i] << (8 * i);
+    }
+    return value;
+}
+
+// writes a directory with the given entries at the offset. ndpi files store the high
+// 4 bytes of each value in an extension block behind the 4 low bytes of the successor
+static void build_directory(uint8_t *buffer, uint64_t offset, const struct directory_layout *layout,
+                            const struct tiff_entry *entries, uint64_t count, uint64_t next) {
+    int32_t count_size = layout->big_tiff ? 8 : 2;
+    int32_t field_size = layout->big_tiff ? 8 : 4;
+    int32_t entry_size = layout->big_tiff ? 20 : 12;
+    put_uint(buffer + offset, count_size, count, layout->big_endian);
+    uint8_t *entry = buffer + offset + count_size;
+    for (uint64_t i = 0; i < count; i++, entry += entry_size) {
+        put_uint(entry, 2, entries[i].tag, layout->big_endian);
+        put_uint(entry + 2, 2, entries[i].type, layout->big_endian);
+        put_uint(entry + 4, field_size, entries[i].count, layout->big_endian);
+        put_uint(entry + 4 + field_size, field_size, entries[i].offset, layout->big_endian);
+    }
+    put_uint(entry, field_size, next, layout->big_endian);
+    if (layout->ndpi) {
+        for (uint64_t i = 0; i < count; i++) {
+            put_uint(entry + 4 + 4 * i, 4, entries[i].offset >> 32, layout->big_endian);
+        }
+    }
+}
+
+// reference reader, decodes the entries one by one from the bytes of the file
+static void check_directory(const uint8_t *buffer, uint64_t offset, const struct directory_layout *layout,
+                            const struct tiff_directory *dir, uint64_t next) {
+    int32_t count_size = layout->big_tiff ? 8 : 2;
+    int32_t field_size = layout->big_tiff ? 8 : 4;
+    int32_t entry_size = layout->big_tiff ? 20 : 12;
+    uint64_t count = get_uint(buffer + offset, count_size, layout->big_endian);
+    CU_ASSERT_EQUAL(dir->count, count);
+
+    uint32_t high_bits = 0;
+    bool entries_match = true;
+    for (uint64_t i = 0; i < count && i < dir->count; i++) {
+        uint64_t start = offset + count_size + i * entry_size;
+        const uint8_t *entry = buffer + start;
+        uint16_t type = get_uint(entry + 2, 2, layout->big_endian);
+        uint32_t value_count = get_uint(entry + 4, field_size, layout->big_endian);
+        uint32_t value_size = get_size_of_value(type, &value_count);
+        uint64_t value = get_uint(entry + 4 + field_size, field_size, layout->big_endian);
+        if (layout->ndpi) {
+            const uint8_t *extension = buffer + offset + 12 * count + 4 * i + 6;
+            uint64_t high = get_uint(extension, 4, layout->big_endian);
+            value |= high << 32;
+            if (high != 0 && value_size * get_uint(entry + 4, field_size, layout->big_endian) <= 4) {
+                // the high bits are taken over in the byte order of the system
+                memcpy(&high_bits, extension, sizeof(high_bits));
+            }
+        }
+        entries_match = entries_match && dir->entries[i].start == start &&
+                        dir->entries[i].tag == get_uint(entry, 2, layout->big_endian) &&
+                        dir->entries[i].type == type && dir->entries[i].count == value_count &&
+                        dir->entries[i].offset == value;
+    }
+    CU_ASSERT_TRUE(entries_match);
+    CU_ASSERT_EQUAL(dir->ndpi_high_bits, high_bits);
+    CU_ASSERT_EQUAL(dir->out_pointer_offset, offset + count_size + count * entry_size + (layout->big_tiff ? 8 : 2));
+
+    // the ndpi successor is read with 8 bytes, including the first high bits of the extension
+    uint64_t pointer = offset + count_size + count * entry_size;
+    CU_ASSERT_EQUAL(next, get_uint(buffer + pointer, layout->ndpi ? 8 : field_size, layout->big_endian));
+}
+
+// ####################### test cases ####################### //
+
+void test_find_tag_references() {
+    struct tiff_file *file = (struct tiff_file *)malloc(sizeof(struct tiff_file));
+    init_tiff_file(file, 1);
+    static const uint16_t TAGS_1[] = {TIFFTAG_IMAGEDESCRIPTION, TIFFTAG_STRIPOFFSETS, TIFFTAG_XMP};
+    static const uint16_t TAGS_2[] = {TIFFTAG_SUBFILETYPE, TIFFTAG_IMAGEDESCRIPTION};
+    insert_dir_with_tags(file, TAGS_1, 3);
+    insert_dir_with_tags(file, TAGS_2, 2);
+
+    uint64_t count;
+    const struct tiff_tag_reference *references = find_tag_references(file, TIFFTAG_IMAGEDESCRIPTION, &count);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(references[0].dir, 0);
+    CU_ASSERT_EQUAL(references[0].entry, 0);
+    CU_ASSERT_EQUAL(references[1].dir, 1);
+    CU_ASSERT_EQUAL(references[1].entry, 1);
+
+    find_tag_references(file, TIFFTAG_DATETIME, &count);
+    CU_ASSERT_EQUAL(count, 0);
+
+    // the index is rebuilt after inserting another directory
+    insert_dir_with_tags(file, TAGS_2, 2);
+    references = find_tag_references(file, TIFFTAG_SUBFILETYPE, &count);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(references[1].dir, 2);
+
+    free_tiff_file(file);
+}
+
+void test_get_tag_value_is_cached_until_invalidated() {
+    const char *filename = "tag-value-test.tif";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+    file_write("xxAperio|GT450", 15, 1, fp);
+
+    struct tiff_file *file = (struct tiff_file *)malloc(sizeof(struct tiff_file));
+    init_tiff_file(file, 1);
+    static const uint16_t TAGS[] = {TIFFTAG_IMAGEDESCRIPTION};
+    insert_dir_with_tags(file, TAGS, 1);
+    file->directories[0].entries[0].type = TIFF_ASCII;
+    file->directories[0].entries[0].count = 13;
+    file->directories[0].entries[0].offset = 2;
+
+    uint64_t count;
+    const struct tiff_tag_reference *reference = find_tag_references(file, TIFFTAG_IMAGEDESCRIPTION, &count);
+    CU_ASSERT_STRING_EQUAL(get_tag_value(fp, file, reference), "Aperio|GT450");
+
+    // the cached value is served until the rewritten range is invalidated
+    file_seek(fp, 9, SEEK_SET);
+    file_write("KFBIO", 5, 1, fp);
+    CU_ASSERT_STRING_EQUAL(get_tag_value(fp, file, reference), "Aperio|GT450");
+    invalidate_tag_values(file, 9, 5);
+    CU_ASSERT_STRING_EQUAL(get_tag_value(fp, file, reference), "Aperio|KFBIO");
+
+    free_tiff_file(file);
+    file_close(fp);
+    remove(filename);
+}
+
+void test_find_entry_by_tag() {
+    struct tiff_file *file = (struct tiff_file *)malloc(sizeof(struct tiff_file));
+    init_tiff_file(file, 1);
+    uint16_t tags[19];
+    for (uint16_t i = 0; i < 19; i++) {
+        tags[i] = 256 + i;
+    }
+    tags[17] = NDPI_SOURCELENS;
+    tags[18] = NDPI_SOURCELENS;
+    insert_dir_with_tags(file, tags, 19);
+
+    struct tiff_directory *dir = &file->directories[0];
+    CU_ASSERT_EQUAL(find_entry_by_tag(dir, 256), 0);
+    CU_ASSERT_EQUAL(find_entry_by_tag(dir, 265), 9);
+    CU_ASSERT_EQUAL(find_entry_by_tag(dir, 272), 16);
+    CU_ASSERT_EQUAL(find_entry_by_tag(dir, NDPI_SOURCELENS), 17);
+    CU_ASSERT_EQUAL(find_entry_by_tag(dir, TIFFTAG_XMP), -1);
+
+    free_tiff_file(file);
+}
+
+void test_read_next_tiff_directory() {
+    // little endian classic tiff with a chain of three directories with one entry each
+    static const uint8_t TIFF[] = {0x49, 0x49, 42, 0, 8,  0,  0, 0, 1, 0, 0, 1, 3, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+                                   26,   0,    0,  0, 1,  0,  1, 1, 3, 0, 1, 0, 0, 0, 1, 0, 0, 0, 44, 0, 0, 0,
+                                   1,    0,    2,  1, 3,  0,  1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0};
+    const char *filename = "lazy-read-test.tif";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+    file_write(TIFF, sizeof(TIFF), 1, fp);
+
+    struct tiff_file *file = open_tiff_file_with_header(fp, false);
+    CU_ASSERT_PTR_NOT_NULL(file);
+    if (file == NULL) {
+        file_close(fp);
+        remove(filename);
+        return;
+    }
+    CU_ASSERT_EQUAL(file->used, 0);
+
+    // directories are only read on demand
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 1);
+    CU_ASSERT_EQUAL(file->used, 1);
+    CU_ASSERT_EQUAL(file->directories[0].entries[0].tag, 256);
+    CU_ASSERT_EQUAL(file->directories[0].in_pointer_offset, 4);
+    CU_ASSERT_EQUAL(file->next_dir_offset, 26);
+
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 1);
+    CU_ASSERT_EQUAL(file->directories[1].in_pointer_offset, 22);
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 1);
+    CU_ASSERT_EQUAL(file->directories[2].entries[0].offset, 2);
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 0);
+    CU_ASSERT_EQUAL(file->used, 3);
+
+    free_tiff_file(file);
+    file_close(fp);
+    remove(filename);
+}
+
+void test_get_directory_by_tag_and_value_reads_on_demand() {
+    // little endian classic tiff with a chain of three directories with one entry each, the
+    // values of the entries are read from the file header and hold the bytes "I*"
+    static const uint8_t TIFF[] = {0x49, 0x49, 42, 0, 8,  0,  0, 0, 1, 0, 0, 1, 3, 0, 1, 0, 0, 0, 1, 0, 0, 0,
+                                   26,   0,    0,  0, 1,  0,  1, 1, 3, 0, 1, 0, 0, 0, 1, 0, 0, 0, 44, 0, 0, 0,
+                                   1,    0,    2,  1, 3,  0,  1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0};
+    const char *filename = "lazy-lookup-test.tif";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+    file_write(TIFF, sizeof(TIFF), 1, fp);
+
+    struct tiff_file *file = open_tiff_file_with_header(fp, false);
+    CU_ASSERT_PTR_NOT_NULL(file);
+    if (file == NULL) {
+        file_close(fp);
+        remove(filename);
+        return;
+    }
+
+    // only the first directory with the tag is checked
+    CU_ASSERT_EQUAL(first_tag_value_contains(fp, file, 256, "x"), -1);
+    CU_ASSERT_EQUAL(file->used, 1);
+    CU_ASSERT_EQUAL(first_tag_value_contains(fp, file, 257, "I*"), 1);
+    CU_ASSERT_EQUAL(file->used, 2);
+
+    // directories are read up to the first match
+    CU_ASSERT_EQUAL(get_directory_by_tag_and_value(fp, file, 257, "*"), 1);
+    CU_ASSERT_EQUAL(file->used, 2);
+    CU_ASSERT_EQUAL(get_directory_by_tag_and_value(fp, file, 258, "I"), 2);
+    CU_ASSERT_EQUAL(get_directory_by_tag_and_value(fp, file, 256, "x"), -1);
+    CU_ASSERT_EQUAL(file->used, 3);
+
+    free_tiff_file(file);
+    file_close(fp);
+    remove(filename);
+}
+
+void test_unlink_directory() {
+    // little endian classic tiff with a chain of three directories with one entry each
+    static const uint8_t TIFF[] = {0x49, 0x49, 42, 0, 8,  0,  0, 0, 1, 0, 0, 1, 3, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+                                   26,   0,    0,  0, 1,  0,  1, 1, 3, 0, 1, 0, 0, 0, 1, 0, 0, 0, 44, 0, 0, 0,
+                                   1,    0,    2,  1, 3,  0,  1, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0};
+    const char *filename = "unlink-test.tif";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+    file_write(TIFF, sizeof(TIFF), 1, fp);
+
+    struct tiff_file *file = open_tiff_file_with_header(fp, false);
+    CU_ASSERT_PTR_NOT_NULL(file);
+    if (file == NULL) {
+        file_close(fp);
+        remove(filename);
+        return;
+    }
+
+    // the last directory is read on demand and unlinked by terminating the chain at
+    // its predecessor, only the 4 bytes of the pointer are written
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 1);
+    CU_ASSERT_EQUAL(read_next_tiff_directory(fp, file), 1);
+    CU_ASSERT_EQUAL(unlink_directory(fp, file, 2, false), 0);
+    CU_ASSERT_EQUAL(file->used, 3);
+    uint8_t buffer[sizeof(TIFF)];
+    file_seek(fp, 0, SEEK_SET);
+    CU_ASSERT_EQUAL(file_read(buffer, sizeof(buffer), 1, fp), 1);
+    CU_ASSERT_EQUAL(decode_uint(buffer + 40, 4, false), 0);
+    CU_ASSERT_EQUAL(memcmp(buffer, TIFF, 40), 0);
+
+    // the predecessor takes over the pointer of the unlinked directory
+    CU_ASSERT_EQUAL(unlink_directory(fp, file, 1, false), 0);
+    file_seek(fp, 0, SEEK_SET);
+    CU_ASSERT_EQUAL(file_read(buffer, sizeof(buffer), 1, fp), 1);
+    CU_ASSERT_EQUAL(decode_uint(buffer + 22, 4, false), 0);
+    CU_ASSERT_EQUAL(memcmp(buffer, TIFF, 22), 0);
+    CU_ASSERT_EQUAL(memcmp(buffer + 26, TIFF + 26, 14), 0);
+
+    free_tiff_file(file);
+    file_close(fp);
+    remove(filename);
+}
+
+void test_read_tiff_directory_layouts() {
+    // values beyond 4 GiB are only kept by ndpi and big tiff files
+    static const struct tiff_entry ENTRIES[] = {
+        {TIFFTAG_SUBFILETYPE, TIFF_LONG, 1, 1, 0},
+        {256, TIFF_LONG, 1, 0x00000002000004d2, 0},
+        {TIFFTAG_STRIPOFFSETS, TIFF_LONG, 3, 0x0000000512345678, 0},
+        {282, TIFF_RATIONAL, 1, 0x0000000100000020, 0},
+        {TIFFTAG_IMAGEDESCRIPTION, TIFF_ASCII, 300, 0x00000007abcdef00, 0},
+        {TIFFTAG_XMP, TIFF_UNDEFINED, 2, 0x4142, 0}};
+    static const uint64_t COUNT = sizeof(ENTRIES) / sizeof(ENTRIES[0]);
+    // ndpi files are always little endian
+    static const struct directory_layout LAYOUTS[] = {{false, false, false}, {false, false, true}, {false, true, false},
+                                                      {true, false, false},  {true, false, true}};
+    const char *filename = "directory-layout-test.tif";
+
+    for (size_t i = 0; i < sizeof(LAYOUTS) / sizeof(LAYOUTS[0]); i++) {
+        // the directory is preceded by some bytes and followed by the extension block
+        const struct directory_layout *layout = &LAYOUTS[i];
+        uint8_t buffer[512] = {0};
+        uint64_t offset = 16 + i;
+        uint64_t next = layout->big_tiff ? 0x0000000300000010 : 0x10;
+        build_directory(buffer, offset, layout, ENTRIES, COUNT, next);
+
+        file_handle *fp = file_open(filename, "wb+");
+        CU_ASSERT_PTR_NOT_NULL(fp);
+        if (fp == NULL) {
+            return;
+        }
+        file_write(buffer, sizeof(buffer), 1, fp);
+
+        struct arena arena = {NULL};
+        uint64_t dir_offset = offset;
+        uint64_t in_pointer_offset = 4;
+        struct tiff_directory *dir = read_tiff_directory(fp, &arena, &dir_offset, &in_pointer_offset,
+                                                         layout->big_tiff, layout->ndpi, layout->big_endian);
+        CU_ASSERT_PTR_NOT_NULL(dir);
+        if (dir != NULL) {
+            check_directory(buffer, offset, layout, dir, dir_offset);
+            CU_ASSERT_EQUAL(dir->in_pointer_offset, 4);
+            CU_ASSERT_EQUAL(dir->entries[1].offset, layout->big_tiff || layout->ndpi ? ENTRIES[1].offset : 0x4d2);
+
+            // the stream is left behind the pointer to the successor
+            uint64_t entries_end = offset + (layout->big_tiff ? 8 + 20 * COUNT : 2 + 12 * COUNT);
+            CU_ASSERT_EQUAL(file_tell(fp), entries_end + (layout->big_tiff || layout->ndpi ? 8 : 4));
+        }
+
+        free_arena(&arena);
+        file_close(fp);
+        remove(filename);
+    }
+}
+
+void test_decode_uint() {
+    const uint8_t buffer[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+    CU_ASSERT_EQUAL(decode_uint(buffer, 2, true), 0x0102);
+    CU_ASSERT_EQUAL(decode_uint(buffer, 2, false), 0x0201);
+    CU_ASSERT_EQUAL(decode_uint(buffer, 4, true), 0x01020304);
+    CU_ASSERT_EQUAL(decode_uint(buffer, 4, false), 0x04030201);
+    CU_ASSERT_EQUAL(decode_uint(buffer, 8, true), 0x0102030405060708);
+    CU_ASSERT_EQUAL(decode_uint(buffer, 8, false), 0x0807060504030201);
+}
+
+void test_fix_byte_order() {
+    // big endian arrays with more elements than a vector register holds and a remainder
+    for (int32_t size = 2; size <= 8; size *= 2) {
+        uint8_t data[37 * 8];
+        int32_t count = sizeof(data) / size;
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = (uint8_t)(i * 7);
+        }
+        uint8_t expected[sizeof(data)];
+        memcpy(expected, data, sizeof(data));
+
+        fix_byte_order(data, size, count, true);
+        bool correct = true;
+        for (int32_t i = 0; i < count; i++) {
+            uint64_t value = decode_uint(data + i * size, size, is_system_big_endian());
+            correct = correct && value == decode_uint(expected + i * size, size, true);
+        }
+        CU_ASSERT_TRUE(correct);
+
+        // converting back restores the original bytes
+        fix_byte_order(data, size, count, true);
+        CU_ASSERT_EQUAL(memcmp(data, expected, sizeof(data)), 0);
+    }
+}
+
+// ####################### test case setup ####################### //
+
+CU_TestInfo tiff_based_io_tests[] = {
+    {"Test [find_tag_references]:", test_find_tag_references},
+    {"Test [find_entry_by_tag]:", test_find_entry_by_tag},
+    {"Test [read_next_tiff_directory]:", test_read_next_tiff_directory},
+    {"Test [unlink_directory]:", test_unlink_directory},
+    {"Test [get_directory_by_tag_and_value]:", test_get_directory_by_tag_and_value_reads_on_demand},
+    {"Test [read_tiff_directory]:", test_read_tiff_directory_layouts},
+    {"Test [get_tag_value]:", test_get_tag_value_is_cached_until_invalidated},
+    {"Test [decode_uint]:", test_decode_uint},
+    {"Test [fix_byte_order]:", test_fix_byte_order},
+    CU_TEST_INFO_NULL};
+
+CU_SuiteInfo tiff_based_io_test_suite[] = {{"Testing tiff-based-io.c:", NULL, NULL, NULL, NULL, tiff_based_io_tests},
+                                           CU_SUITE_INFO_NULL};
+
+void AddTestsTiffBasedIo(void) {
+    assert(NULL != CU_get_registry());
+    assert(!CU_is_test_running());
+
+    if (CUE_SUCCESS != CU_register_suites(tiff_based_io_test_suite)) {
+        fprintf(stderr, "Register suites failed - %s ", CU_get_error_msg());
+        exit(1);
+    }
+}
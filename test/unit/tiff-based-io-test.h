@@ -0,0 +1,6 @@
+#ifndef HEADER_TIFF_BASED_IO_TEST_H
+#define HEADER_TIFF_BASED_IO_TEST_H
+
+void AddTestsTiffBasedIo();
+
+#endif
@@ -32,6 +32,27 @@ extern const char *add_equals_sign(const char *str1, const char *str2);
 
 extern bool contains(const char *str1, const char *str2);
 
+extern int32_t merge_ranges(uint64_t *offsets, uint64_t *lengths, int32_t count);
+
+extern void *arena_alloc(struct arena *arena, size_t size);
+
+extern int32_t find_value_in_file(file_handle *fp, const char *value, uint64_t *offset);
+
+extern int32_t copy_file_with_stats(const char *src, const char *dest, struct copy_stats *stats);
+
+extern void free_arena(struct arena *arena);
+
+extern struct pattern_scanner *create_pattern_scanner(const char *const *patterns, size_t num_patterns);
+
+extern size_t find_patterns(const struct pattern_scanner *scanner, const char *buffer, size_t length,
+                            const char **matches);
+
+extern void free_pattern_scanner(struct pattern_scanner *scanner);
+
+extern void seed_random(uint64_t seed);
+
+extern char *create_random_string(uint64_t length);
+
 extern uint16_t _swap_uint16(uint16_t value);
 
 extern uint32_t _swap_uint32(uint32_t value);
@@ -172,6 +193,118 @@ void test_contains2() {
     CU_ASSERT_FALSE(result);
 }
 
+void test_merge_ranges() {
+    uint64_t offsets[] = {300, 0, 100, 150, 500};
+    uint64_t lengths[] = {50, 100, 100, 10, 0};
+    int32_t count = merge_ranges(offsets, lengths, 5);
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_EQUAL(offsets[0], 0);
+    CU_ASSERT_EQUAL(lengths[0], 200);
+    CU_ASSERT_EQUAL(offsets[1], 300);
+    CU_ASSERT_EQUAL(lengths[1], 50);
+}
+
+void test_arena_alloc() {
+    struct arena arena = {NULL};
+    uint8_t *first = (uint8_t *)arena_alloc(&arena, 3);
+    uint8_t *second = (uint8_t *)arena_alloc(&arena, 8);
+    CU_ASSERT_EQUAL((uintptr_t)first % ARENA_ALIGNMENT, 0);
+    CU_ASSERT_PTR_EQUAL(second, first + ARENA_ALIGNMENT);
+
+    // large allocations do not interrupt the current block
+    uint8_t *large = (uint8_t *)arena_alloc(&arena, ARENA_BLOCK_SIZE);
+    memset(large, 0xff, ARENA_BLOCK_SIZE);
+    uint8_t *third = (uint8_t *)arena_alloc(&arena, 1);
+    CU_ASSERT_PTR_EQUAL(third, second + ARENA_ALIGNMENT);
+
+    free_arena(&arena);
+    CU_ASSERT_PTR_NULL(arena.blocks);
+}
+
+void test_find_value_in_file() {
+    const char *filename = "find-value-test.isyntax";
+    file_handle *fp = file_open(filename, "wb+");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+
+    // the value spans the first two chunks of the search
+    char *content = (char *)calloc(SEARCH_CHUNK_SIZE + 16, 1);
+    memcpy(content + SEARCH_CHUNK_SIZE - 1, ISYNTAX_EOT, strlen(ISYNTAX_EOT));
+    file_write(content, SEARCH_CHUNK_SIZE + 16, 1, fp);
+    free(content);
+
+    uint64_t offset = 0;
+    CU_ASSERT_EQUAL(find_value_in_file(fp, ISYNTAX_EOT, &offset), 0);
+    CU_ASSERT_EQUAL(offset, SEARCH_CHUNK_SIZE - 1);
+    CU_ASSERT_EQUAL(find_value_in_file(fp, ISYNTAX_ROOTNODE, &offset), -1);
+
+    file_close(fp);
+    remove(filename);
+}
+
+void test_copy_file_with_stats() {
+    const char *src = "copy-test-src.bin";
+    const char *dest = "copy-test-dest.bin";
+    file_handle *fp = file_open(src, "wb");
+    CU_ASSERT_PTR_NOT_NULL(fp);
+    if (fp == NULL) {
+        return;
+    }
+    char *content = (char *)calloc(COPY_CHUNK_SIZE + 16, 1);
+    file_write(content, COPY_CHUNK_SIZE + 16, 1, fp);
+    free(content);
+    file_close(fp);
+
+    // the copy is counted into the statistics of the anonymization
+    struct anonymization_stats anonymization_stats;
+    struct copy_stats stats;
+    stats_start_recording(&anonymization_stats);
+    CU_ASSERT_EQUAL(copy_file_with_stats(src, dest, &stats), 0);
+    stats_stop_recording();
+    CU_ASSERT_EQUAL(stats.bytes_copied, COPY_CHUNK_SIZE + 16);
+    CU_ASSERT_PTR_NOT_NULL(stats.method);
+    CU_ASSERT_EQUAL(anonymization_stats.bytes_copied, COPY_CHUNK_SIZE + 16);
+    CU_ASSERT_PTR_EQUAL(anonymization_stats.copy_method, stats.method);
+
+    remove(src);
+    remove(dest);
+}
+
+void test_find_patterns() {
+    const char *patterns[] = {"he", "she", "his", "hers"};
+    struct pattern_scanner *scanner = create_pattern_scanner(patterns, 4);
+    CU_ASSERT_PTR_NOT_NULL(scanner);
+    if (scanner == NULL) {
+        return;
+    }
+
+    // overlapping patterns are all found at their first occurrence
+    const char *buffer = "ushers she";
+    const char *matches[4];
+    CU_ASSERT_EQUAL(find_patterns(scanner, buffer, strlen(buffer), matches), 3);
+    CU_ASSERT_PTR_EQUAL(matches[0], buffer + 2);
+    CU_ASSERT_PTR_EQUAL(matches[1], buffer + 1);
+    CU_ASSERT_PTR_NULL(matches[2]);
+    CU_ASSERT_PTR_EQUAL(matches[3], buffer + 2);
+
+    free_pattern_scanner(scanner);
+}
+
+void test_create_random_string() {
+    seed_random(42);
+    char *result1 = create_random_string(16);
+    seed_random(42);
+    char *result2 = create_random_string(16);
+    CU_ASSERT_STRING_EQUAL(result1, result2);
+    for (int32_t i = 0; i < 16; i++) {
+        CU_ASSERT_TRUE(result1[i] >= '0' && result1[i] <= '7');
+    }
+    free(result1);
+    free(result2);
+}
+
 void test_swap_uint16() {
     uint16_t input = 1;
     uint16_t swapped = _swap_uint16(input);
@@ -212,6 +345,12 @@ CU_TestInfo testcases1[] = {{"Test [str_split] 1:", test_str_split1},
                             {"Test [add_equals_sign]:", test_add_equals_sign},
                             {"Test [contains] 1:", test_contains1},
                             {"Test [contains] 2:", test_contains2},
+                            {"Test [merge_ranges]:", test_merge_ranges},
+                            {"Test [arena_alloc]:", test_arena_alloc},
+                            {"Test [find_value_in_file]:", test_find_value_in_file},
+                            {"Test [copy_file_with_stats]:", test_copy_file_with_stats},
+                            {"Test [find_patterns]:", test_find_patterns},
+                            {"Test [create_random_string]:", test_create_random_string},
                             CU_TEST_INFO_NULL};
 
 CU_TestInfo testcases2[] = {{"Test [swap_uint16]:", test_swap_uint16},
@@ -7,6 +7,17 @@
 extern int32_t anonymize_wsi_inplace(const char *filename, const char *new_label_name, bool keep_macro_image,
                                      bool disable_unlinking);
 
+extern int32_t anonymize_wsi_ex(const char *filename, const struct anonymization_context *context,
+                                struct anonymization_stats *stats);
+
+extern int32_t anonymize_wsi_with_context(const char *filename, const struct anonymization_context *context);
+
+extern void *stats_malloc(size_t size);
+
+extern uint64_t get_random_state();
+
+extern void set_random_state(uint64_t state);
+
 // ####################### test cases ####################### //
 
 void test_errors_are_propagated() {
@@ -14,9 +25,41 @@ void test_errors_are_propagated() {
     CU_ASSERT_NOT_EQUAL(result, 0);
 }
 
+void test_stats_are_recorded() {
+    struct anonymization_context context = {"new_label", false, false, true, 0};
+    struct anonymization_stats stats;
+    int32_t result = anonymize_wsi_ex("/non/existing/wsi.svs", &context, &stats);
+    CU_ASSERT_NOT_EQUAL(result, 0);
+
+    // the format is probed, but nothing is read from the file
+    CU_ASSERT_TRUE(stats.allocations > 0);
+    CU_ASSERT_EQUAL(stats.reads, 0);
+    CU_ASSERT_EQUAL(stats.writes, 0);
+    CU_ASSERT_TRUE(stats.phase_seconds[PHASE_PROBE] <= stats.total_seconds);
+    CU_ASSERT_EQUAL(stats.format, INVALID);
+    CU_ASSERT_EQUAL(stats.label_directory, -1);
+    CU_ASSERT_EQUAL(stats.macro_directory, -1);
+    CU_ASSERT_EQUAL(stats.bytes_wiped, 0);
+
+    // allocations of the library are not counted after recording stopped
+    uint64_t allocations = stats.allocations;
+    free(stats_malloc(1));
+    CU_ASSERT_EQUAL(stats.allocations, allocations);
+}
+
+void test_seed_is_not_kept_by_thread() {
+    // the generator of the thread continues after a seeded anonymization
+    set_random_state(12345);
+    struct anonymization_context context = {"new_label", false, false, true, 42};
+    anonymize_wsi_with_context("/non/existing/wsi.svs", &context);
+    CU_ASSERT_EQUAL(get_random_state(), 12345);
+}
+
 // ####################### test case setup ####################### //
 
 CU_TestInfo anonymize_wsi_tests[] = {{"Test [anonymize_wsi_inplace] 1:", test_errors_are_propagated},
+                                     {"Test [anonymize_wsi_ex] 1:", test_stats_are_recorded},
+                                     {"Test [anonymize_wsi_with_context] 1:", test_seed_is_not_kept_by_thread},
                                      CU_TEST_INFO_NULL};
 
 CU_SuiteInfo anonymize_wsi_test_suite[] = {{"Testing wsi-anonymizer.c:", NULL, NULL, NULL, NULL, anonymize_wsi_tests},
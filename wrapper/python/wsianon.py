@@ -1,14 +1,11 @@
 import ctypes
 import os
-import threading
 import platform
 
 try: 
     from model.model import *
 except: 
     from .model.model import *
-    
-lock = threading.Lock()
 
 def _load_library():
     '''
@@ -67,14 +64,13 @@ def anonymize_wsi(filename, new_label_name, keep_macro_image=False, disable_unli
     c_filename = filename.encode('utf-8')
     c_new_label_name = new_label_name.encode('utf-8')
 
-    result = -1
-    with lock:
-        result = _wsi_anonymizer.anonymize_wsi(
-            c_filename, 
-            c_new_label_name,
-            keep_macro_image, 
-            disable_unlinking, 
-            do_inplace
-        )
+    # the library is reentrant, so slides can be anonymized from several threads at once
+    result = _wsi_anonymizer.anonymize_wsi(
+        c_filename, 
+        c_new_label_name,
+        keep_macro_image, 
+        disable_unlinking, 
+        do_inplace
+    )
 
     return result